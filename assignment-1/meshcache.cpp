@@ -0,0 +1,59 @@
+//
+// Cache that loads every mesh file once and hands out shared handles to it.
+//
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include "meshcache.h"
+
+namespace {
+    // 64 bit FNV-1a
+    uint64_t hashContent(const std::string &content)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : content) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+std::shared_ptr<TriangleMesh> MeshCache::load(const std::string &path)
+{
+    const QFileInfo info(QString::fromStdString(path));
+    if (!info.isFile()) {
+        std::cout << "MeshCache: can not find " << path << std::endl;
+        return std::make_shared<TriangleMesh>();
+    }
+    const qint64 size = info.size();
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    auto file = files.find(path);
+    uint64_t hash;
+    if (file != files.end() && file->second.size == size && file->second.modified == modified) {
+        hash = file->second.hash;
+    } else {
+        // new or changed file: reading and hashing it is still much cheaper than parsing it
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            std::cout << "MeshCache: can not read " << path << std::endl;
+            return std::make_shared<TriangleMesh>();
+        }
+        const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        hash = hashContent(content);
+        files[path] = FileEntry{size, modified, hash};
+    }
+    std::weak_ptr<TriangleMesh> &entry = meshes[hash];
+    if (std::shared_ptr<TriangleMesh> mesh = entry.lock()) return mesh;
+
+    auto mesh = std::make_shared<TriangleMesh>();
+    mesh->loadOFF(path.c_str());
+    ++loadCount;
+    entry = mesh;
+    return mesh;
+}
@@ -0,0 +1,44 @@
+//
+// Cache that loads every mesh file once and hands out shared handles to it.
+//
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <QtGlobal>
+
+#include "trianglemesh.h"
+
+// Meshes are keyed by a hash of the file content, so a copy of a file under another name returns the mesh that is
+// already loaded as long as a handle to it is alive. The hash of each path is remembered with the size and
+// modification time of the file, another request for an unchanged path does not read the file at all. The mesh is
+// deleted with its last handle.
+// The same cache lives in assignment-2, the assignments are separate projects; keep both copies in sync.
+class MeshCache
+{
+public:
+    // shared mesh of the OFF file, an empty mesh that is not cached if the file can not be read
+    std::shared_ptr<TriangleMesh> load(const std::string &path);
+
+    // number of files parsed so far
+    unsigned int getLoadCount() const { return loadCount; }
+
+private:
+    // what a path contained when it was last read
+    struct FileEntry
+    {
+        qint64 size;
+        qint64 modified;
+        uint64_t hash;
+    };
+    std::unordered_map<std::string, FileEntry> files;
+    std::unordered_map<uint64_t, std::weak_ptr<TriangleMesh>> meshes;
+    unsigned int loadCount = 0;
+};
+
+#endif
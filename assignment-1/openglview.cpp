@@ -9,6 +9,7 @@
 // Content: Widget for showing OpenGL scene                                  //
 // ========================================================================= //
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <string>
@@ -34,11 +35,9 @@ OpenGLView::OpenGLView(QWidget *parent) : QOpenGLWidget(parent)
 }
 
 void OpenGLView::reInitializeObjects(int objectAmount) {
-    for (int i = 0; i < objectAmount; i++) {
-        TriangleMesh temp;
-        temp.loadOFF("./Modelle/ballon.off");
-        meshes.push_back(temp);
-    }
+    // all copies share one mesh, the file is only parsed if no copy of it is left
+    std::shared_ptr<TriangleMesh> mesh = meshCache.load("./Modelle/ballon.off");
+    meshes.assign(std::max(0, objectAmount), mesh);
 }
 
 void OpenGLView::initializeGL()
@@ -126,8 +125,8 @@ void OpenGLView::paintGL()
     f->glTranslatef(1.0f, 1.0f, 1.0f);
 
     for (int i = 0; i < meshes.size(); i++) {
-        meshes[i].draw(f);
-        meshes[i].drawNormals(f);
+        meshes[i]->draw(f);
+        meshes[i]->drawNormals(f);
     }
 
     sphere.draw(f);
@@ -183,7 +182,7 @@ unsigned int OpenGLView::getTriangleCount() const
 
     int totalCount = sphere.getTriangles().size();
     for (int i = 0; i < meshes.size(); i++) {
-        totalCount += meshes[i].getTriangles().size();
+        totalCount += meshes[i]->getTriangles().size();
     }
     return totalCount;
 }
@@ -207,8 +206,10 @@ void OpenGLView::refreshFpsCounter()
 
 void OpenGLView::recalcNormals(bool weightByAngle)
 {
+    // the copies share their mesh, so the normals of each mesh are calculated once
     for (int i = 0; i < meshes.size(); i++) {
-        meshes[i].calculateNormals(weightByAngle);
+        if (i > 0 && meshes[i] == meshes[i - 1]) continue;
+        meshes[i]->calculateNormals(weightByAngle);
     }
     
     update();
@@ -223,7 +224,6 @@ void OpenGLView::triggerNormalRendering(bool shouldRender) {
 }
 
 void OpenGLView::triggerRenderOverClock() {
-    meshes.clear();
     reInitializeObjects(std::stoi(renderCount));
 }
 
@@ -20,6 +20,7 @@
 #include <QOpenGLWidget>
 
 #include "trianglemesh.h"
+#include "meshcache.h"
 #include "vec3.h"
 
 class OpenGLView : public QOpenGLWidget
@@ -64,7 +65,8 @@ private:
     TriangleMesh ballon;
     TriangleMesh sphere;
     
-    std::vector<TriangleMesh> meshes; // To test how much we can render smoothly :)
+    MeshCache meshCache;
+    std::vector<std::shared_ptr<TriangleMesh>> meshes; // To test how much we can render smoothly :)
 
     // FPS counter, needed for FPS calculation
     unsigned int frameCounter = 0;
@@ -37,28 +37,17 @@ void OpenGLView::setGridSize(int gridSize)
 void OpenGLView::initializeSolarSystem() {
     char const* path = "../uebung-2/Modelle/sphere.off";
 
-    // Setze GLFunctionPtr für SolarObjekte, weil es auch für die anderen Objhekte gemacht wurde.
-    sun.setGLFunctionPtr(f);
-    mercury.setGLFunctionPtr(f);
-    venus.setGLFunctionPtr(f);
-    earth.setGLFunctionPtr(f);
-    mars.setGLFunctionPtr(f);
-    jupiter.setGLFunctionPtr(f);
-    saturn.setGLFunctionPtr(f);
-    uranus.setGLFunctionPtr(f);
-    neptune.setGLFunctionPtr(f);
-    moon.setGLFunctionPtr(f);
-
-    sun.loadOFF(path);
-    mercury.loadOFF(path);
-    venus.loadOFF(path);
-    earth.loadOFF(path);
-    mars.loadOFF(path);
-    jupiter.loadOFF(path);
-    saturn.loadOFF(path);
-    uranus.loadOFF(path);
-    neptune.loadOFF(path);
-    moon.loadOFF(path);
+    // Alle Himmelskörper teilen sich eine Kugel, die Datei wird nur einmal gelesen und hochgeladen.
+    sun = meshCache.load(f, path);
+    mercury = meshCache.load(f, path);
+    venus = meshCache.load(f, path);
+    earth = meshCache.load(f, path);
+    mars = meshCache.load(f, path);
+    jupiter = meshCache.load(f, path);
+    saturn = meshCache.load(f, path);
+    uranus = meshCache.load(f, path);
+    neptune = meshCache.load(f, path);
+    moon = meshCache.load(f, path);
 }
 
 void OpenGLView::initializeGL()
@@ -213,7 +202,7 @@ void OpenGLView::setupSunAndLight() {
     f->glScalef(2.0f, 2.0f, 2.0f);     // Scale up the Sun for visual prominence
     f->glMaterialfv(GL_FRONT, GL_EMISSION, emissiveMaterial);
     f->glColor3f(1.0f, 1.0f, 0.0f);    // Color the Sun yellow
-    sun.drawVBO();        
+    sun->drawVBO();        
     f->glPopMatrix();
 
     GLfloat noEmission[] = { 0.0f, 0.0f, 0.0f, 1.0f };
@@ -227,7 +216,7 @@ void OpenGLView::paintSolarSystem()
 
     // Sonnensystemkonstanten
     const float distances[] = {6.0f, 9.0f, 12.0f, 16.0f, 3.0f, 20.0f, 30.0f, 50.0f, 70.0f }; // Distanzen der Objekte zur Sonne (außer letzter Eintrag. Das ist die Distanz zwischen Mond und Erde)
-    TriangleMesh* planets[] = {&mercury, &venus, &earth, &mars, &jupiter, &saturn, &uranus, &neptune}; // Um die schleife später schöner zu machen speichern wir Referenzen zu den Variablen in eine Liste
+    TriangleMesh* planets[] = {mercury.get(), venus.get(), earth.get(), mars.get(), jupiter.get(), saturn.get(), uranus.get(), neptune.get()}; // Um die schleife später schöner zu machen speichern wir Referenzen zu den Variablen in eine Liste
     const float scaleFactors[] = {0.38f, 0.95f, 1.0f, 0.53f, 0.27f, 3.0f, 2.5f, 1.5f, 1.4f}; // SKalierungswerte der Celestial Objekte
     const float orbitalPeriods[] = { 88.0f, 225.0f, 365.25f, 687.0f, 4333.0f, 10756.0f, 30687.0f, 60190.0f};
     GLfloat colors[][3] = {
@@ -270,7 +259,7 @@ void OpenGLView::paintSolarSystem()
         planets[i]->drawVBO(); // Rendere Planet (VBO Mode wurde gewählt, weil dieser sehr viel schnelelr ist als immediate und Array)
 
         // Male den Mooond!
-        if (planets[i] == &earth) {
+        if (i == 2) { // Erde
 
             float moonAngle = t * timeFactor; // Winkel wird basierend auf Zeit berechnet.
             float moonX = cos(moonAngle) * distances[4];
@@ -292,7 +281,7 @@ void OpenGLView::paintSolarSystem()
             f->glTranslatef(moonX, 0.0f, moonZ);
             f->glScalef(scaleFactors[4], scaleFactors[4], scaleFactors[4]);
             f->glColor3fv(colors[4]);
-            moon.drawVBO();
+            moon->drawVBO();
             f->glPopMatrix();
 
             // Material resetten, sonst werden die OBjekte die danach gemalt werden auch glowen.
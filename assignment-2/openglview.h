@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "trianglemesh.h"
+#include "meshcache.h"
 
 class OpenGLView : public QOpenGLWidget
 {
@@ -76,17 +77,18 @@ private:
     TriangleMesh triMesh;
     TriangleMesh sphereMesh;
 
-    //rendered objects for planetscene
-    TriangleMesh sun;
-    TriangleMesh mercury;
-    TriangleMesh venus;
-    TriangleMesh earth;
-    TriangleMesh mars;
-    TriangleMesh jupiter;
-    TriangleMesh saturn;
-    TriangleMesh uranus;
-    TriangleMesh neptune;
-    TriangleMesh moon;
+    //rendered objects for planetscene, all share one mesh from the cache
+    MeshCache meshCache;
+    std::shared_ptr<TriangleMesh> sun;
+    std::shared_ptr<TriangleMesh> mercury;
+    std::shared_ptr<TriangleMesh> venus;
+    std::shared_ptr<TriangleMesh> earth;
+    std::shared_ptr<TriangleMesh> mars;
+    std::shared_ptr<TriangleMesh> jupiter;
+    std::shared_ptr<TriangleMesh> saturn;
+    std::shared_ptr<TriangleMesh> uranus;
+    std::shared_ptr<TriangleMesh> neptune;
+    std::shared_ptr<TriangleMesh> moon;
 
     // Timer for Task 3
     QElapsedTimer performanceTimer;
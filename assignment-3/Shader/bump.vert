@@ -10,6 +10,10 @@ uniform mat4 modelView;     //ModelView matrix
 uniform mat4 projection;    //Projection matrix
 uniform mat3 normalMatrix;  //The transpose inverse of the ModelView matrix, used for transformation of normals.
 
+uniform bool quantizedPositions; //Flag whether the positions are 16 bit fractions of the bounding box
+uniform vec3 positionOffset;     //Bounding box minimum of quantized positions
+uniform vec3 positionScale;      //Bounding box size of quantized positions
+
 uniform bool useDisplacement;
 
 uniform sampler2D displacementTexture;
@@ -21,7 +25,7 @@ out vec2 vTexCoord; //Texture coordinate of current vertex
 out vec3 vTangent;  //Per-vertex tangent, in view space
 
 void main() {
-	vec3 pos = position;
+	vec3 pos = quantizedPositions ? positionOffset + positionScale * position : position;
 
 	// TODO(3.4): Implement displacement mapping.
 
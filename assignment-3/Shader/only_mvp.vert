@@ -8,10 +8,17 @@ layout(location = 0) in vec3 position; //Vertex position in model coordinates
 layout(location = 1) in vec3 normal;   //Vertex normal
 layout(location = 2) in vec3 color;    //Per-vertex color (for coloring using color array). Note that the vertex array gets disabled when STATIC_COLOR is used. This means that a standard value is inserted here.
 layout(location = 3) in vec2 texCoord; //Texture coordinate (for using textures)
+layout(location = 5) in mat4 instanceModel; //Per-instance model matrix, only read for instanced draws. Occupies locations 5 to 8.
+layout(location = 9) in vec3 instanceColor; //Per-instance color, replaces the per-vertex color for instanced draws with instanceColors
 
 uniform mat4 modelView;     //ModelView matrix
 uniform mat4 projection;    //Projection matrix
 uniform mat3 normalMatrix;  //The transpose inverse of the ModelView matrix, used for transformation of normals.
+uniform bool instanced;     //Flag whether the instance attributes are set. The instance matrices must not scale non-uniformly.
+uniform bool instanceColors; //Flag whether the instance colors replace the coloring of the mesh, only read for instanced draws
+uniform bool quantizedPositions; //Flag whether the positions are 16 bit fractions of the bounding box
+uniform vec3 positionOffset;     //Bounding box minimum of quantized positions
+uniform vec3 positionScale;      //Bounding box size of quantized positions
 
 out vec3 vColor;    //Per-vertex color
 out vec3 vNormal;   //Per-vertex normal, transformed
@@ -19,10 +26,12 @@ out vec3 vPos;      //Position in camera coordinates
 out vec2 vTexCoord; //Texture coordinate of current vertex
 
 void main() {
-    gl_Position = projection * modelView * vec4(position, 1.0);
-    vec4 tempPos = modelView * vec4(position, 1.0);
+    mat4 model = instanced ? instanceModel : mat4(1.0);
+    vec3 objectPosition = quantizedPositions ? positionOffset + positionScale * position : position;
+    gl_Position = projection * modelView * model * vec4(objectPosition, 1.0);
+    vec4 tempPos = modelView * model * vec4(objectPosition, 1.0);
     vPos = tempPos.xyz / tempPos.w; //inhomogenous coordinates
-    vColor = color;
-    vNormal = normalMatrix * normal;
+    vColor = instanced && instanceColors ? instanceColor : color;
+    vNormal = normalMatrix * (mat3(model) * normal);
     vTexCoord = texCoord;
 }
@@ -50,6 +50,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->bumpEnableCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::toggleNormalMapping);
     connect(ui->drawBBCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::toggleBoundingBox);
     connect(ui->drawNormalCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::toggleNormals);
+    connect(ui->quantizedPositionsCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::toggleQuantizedPositions);
     connect(ui->genTerrainButton, &QPushButton::clicked, ui->openGLWidget, &OpenGLView::recreateTerrain);
 
     connect(ui->openGLWidget, &OpenGLView::triangleCountChanged, this, &MainWindow::changeTriangleCount);
@@ -0,0 +1,217 @@
+//
+// Levels of detail by quadric error mesh simplification (Garland and Heckbert 1997).
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+
+#include "meshsimplifier.h"
+
+namespace {
+    // weight of the planes that keep the border of open meshes in place, relative to the planes of the triangles
+    const double BORDER_WEIGHT = 10.0;
+
+    // symmetric 4x4 matrix of the plane equations, sum of squared distances to all planes for a point
+    struct Quadric {
+        double a2{}, ab{}, ac{}, ad{}, b2{}, bc{}, bd{}, c2{}, cd{}, d2{};
+
+        // plane a*x + b*y + c*z + d = 0 with unit normal
+        static Quadric plane(double a, double b, double c, double d, double weight) {
+            Quadric q;
+            q.a2 = weight * a * a; q.ab = weight * a * b; q.ac = weight * a * c; q.ad = weight * a * d;
+            q.b2 = weight * b * b; q.bc = weight * b * c; q.bd = weight * b * d;
+            q.c2 = weight * c * c; q.cd = weight * c * d;
+            q.d2 = weight * d * d;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& o) {
+            a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2; bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+            return *this;
+        }
+
+        double error(const Vec3f& p) const {
+            const double x = p.x(), y = p.y(), z = p.z();
+            return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                 + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                 + c2 * z * z + 2 * cd * z + d2;
+        }
+    };
+
+    // moving vertex "from" onto vertex "to", valid while both have the versions they had when it was queued
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    class Simplifier {
+    public:
+        Simplifier(const std::vector<Vec3f>& vertices, const std::vector<Vec3ui>& triangles)
+            : positions(vertices), faces(triangles), removed(triangles.size(), false), quadrics(vertices.size()),
+              vertexFaces(vertices.size()), versions(vertices.size(), 0), collapsed(vertices.size(), false), liveFaces(triangles.size()) {
+            std::unordered_map<uint64_t, int> edgeFaces;
+            for (unsigned int t = 0; t < faces.size(); ++t) {
+                const Vec3ui& face = faces[t];
+                for (unsigned int k = 0; k < 3; ++k) vertexFaces[face[k]].push_back(t);
+                Vec3f normal = cross(positions[face[1]] - positions[face[0]], positions[face[2]] - positions[face[0]]);
+                if (!normal.normalize()) continue;
+                const Quadric q = Quadric::plane(normal.x(), normal.y(), normal.z(), -(normal * positions[face[0]]), 1.0);
+                for (unsigned int k = 0; k < 3; ++k) {
+                    quadrics[face[k]] += q;
+                    // an edge of only one triangle is on the border, the key marks which one it was
+                    const unsigned int u = face[k], v = face[(k + 1) % 3];
+                    const uint64_t key = static_cast<uint64_t>(std::min(u, v)) << 32 | std::max(u, v);
+                    auto inserted = edgeFaces.emplace(key, static_cast<int>(t));
+                    if (!inserted.second) inserted.first->second = -1;
+                }
+            }
+            // planes through the border edges, perpendicular to their triangle
+            for (const auto& edge : edgeFaces) {
+                if (edge.second < 0) continue;
+                const Vec3ui& face = faces[edge.second];
+                const unsigned int u = static_cast<unsigned int>(edge.first >> 32), v = static_cast<unsigned int>(edge.first & 0xFFFFFFFFu);
+                const Vec3f normal = cross(positions[face[1]] - positions[face[0]], positions[face[2]] - positions[face[0]]);
+                Vec3f borderNormal = cross(positions[v] - positions[u], normal);
+                if (!borderNormal.normalize()) continue;
+                const Quadric q = Quadric::plane(borderNormal.x(), borderNormal.y(), borderNormal.z(), -(borderNormal * positions[u]), BORDER_WEIGHT);
+                quadrics[u] += q;
+                quadrics[v] += q;
+            }
+            for (const Vec3ui& face : faces) {
+                for (unsigned int k = 0; k < 3; ++k) queueCollapse(face[k], face[(k + 1) % 3]);
+            }
+        }
+
+        // collapses edges until at most target triangles are left, returns false if none can be collapsed anymore
+        bool simplifyTo(size_t target) {
+            while (liveFaces > target) {
+                if (queue.empty()) return false;
+                const Collapse collapse = queue.top();
+                queue.pop();
+                if (collapsed[collapse.from] || collapsed[collapse.to]
+                    || versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion) continue;
+                if (!isValid(collapse.from, collapse.to)) continue;
+                apply(collapse.from, collapse.to);
+                maxCost = std::max(maxCost, collapse.cost);
+            }
+            return true;
+        }
+
+        size_t getLiveFaces() const { return liveFaces; }
+        // the quadric error is a sum of squared distances, its root bounds the distance to the original planes
+        float getError() const { return static_cast<float>(std::sqrt(std::max(maxCost, 0.0))); }
+
+        std::vector<Vec3ui> getTriangles() const {
+            std::vector<Vec3ui> result;
+            result.reserve(liveFaces);
+            for (size_t t = 0; t < faces.size(); ++t) {
+                if (!removed[t]) result.push_back(faces[t]);
+            }
+            return result;
+        }
+
+    private:
+        void queueCollapse(unsigned int from, unsigned int to) {
+            Quadric q = quadrics[from];
+            q += quadrics[to];
+            queue.push(Collapse{q.error(positions[to]), from, to, versions[from], versions[to]});
+            q = quadrics[to];
+            q += quadrics[from];
+            queue.push(Collapse{q.error(positions[from]), to, from, versions[to], versions[from]});
+        }
+
+        void collectNeighbours(unsigned int vertex, std::vector<unsigned int>& result) const {
+            result.clear();
+            for (unsigned int t : vertexFaces[vertex]) {
+                if (removed[t]) continue;
+                for (unsigned int k = 0; k < 3; ++k) {
+                    if (faces[t][k] != vertex) result.push_back(faces[t][k]);
+                }
+            }
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+        }
+
+        bool isValid(unsigned int from, unsigned int to) {
+            // More than two shared neighbours means the edge connects two sheets, which would become non-manifold.
+            collectNeighbours(from, fromNeighbours);
+            collectNeighbours(to, toNeighbours);
+            if (!std::binary_search(fromNeighbours.begin(), fromNeighbours.end(), to)) return false;
+            shared.clear();
+            std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(shared));
+            if (shared.size() > 2) return false;
+            // no remaining triangle may turn over
+            for (unsigned int t : vertexFaces[from]) {
+                if (removed[t]) continue;
+                const Vec3ui& face = faces[t];
+                if (face[0] == to || face[1] == to || face[2] == to) continue;
+                Vec3f moved[3];
+                for (unsigned int k = 0; k < 3; ++k) moved[k] = positions[face[k] == from ? to : face[k]];
+                const Vec3f before = cross(positions[face[1]] - positions[face[0]], positions[face[2]] - positions[face[0]]);
+                const Vec3f after = cross(moved[1] - moved[0], moved[2] - moved[0]);
+                if (before * after <= 0.f) return false;
+            }
+            return true;
+        }
+
+        void apply(unsigned int from, unsigned int to) {
+            for (unsigned int t : vertexFaces[from]) {
+                if (removed[t]) continue;
+                Vec3ui& face = faces[t];
+                if (face[0] == to || face[1] == to || face[2] == to) {
+                    removed[t] = true;
+                    liveFaces--;
+                    continue;
+                }
+                for (unsigned int k = 0; k < 3; ++k) {
+                    if (face[k] == from) face[k] = to;
+                }
+                vertexFaces[to].push_back(t);
+            }
+            vertexFaces[from].clear();
+            collapsed[from] = true;
+            quadrics[to] += quadrics[from];
+            versions[to]++;
+            // the edges around the merged vertex have a new cost
+            collectNeighbours(to, toNeighbours);
+            for (unsigned int neighbour : toNeighbours) queueCollapse(to, neighbour);
+        }
+
+        const std::vector<Vec3f>& positions;
+        std::vector<Vec3ui> faces;
+        std::vector<bool> removed;
+        std::vector<Quadric> quadrics;
+        std::vector<std::vector<unsigned int>> vertexFaces;
+        std::vector<unsigned int> versions;
+        std::vector<bool> collapsed;
+        size_t liveFaces;
+        double maxCost{0.0};
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        std::vector<unsigned int> fromNeighbours, toNeighbours, shared;
+    };
+}
+
+std::vector<LevelOfDetail> buildLevelsOfDetail(const std::vector<Vec3f>& vertices, const std::vector<Vec3ui>& triangles, size_t minTriangles, unsigned int maxLevels) {
+    std::vector<LevelOfDetail> levels(1);
+    levels[0].triangles = triangles;
+    for (const Vec3ui& triangle : triangles) {
+        if (triangle[0] >= vertices.size() || triangle[1] >= vertices.size() || triangle[2] >= vertices.size()) return levels;
+    }
+    Simplifier simplifier(vertices, triangles);
+    while (levels.size() < maxLevels) {
+        const size_t target = levels.back().triangles.size() / 2;
+        if (target < minTriangles) break;
+        const bool reached = simplifier.simplifyTo(target);
+        // a level that saves little is not worth its indices
+        if (!reached && 4 * simplifier.getLiveFaces() > 3 * levels.back().triangles.size()) break;
+        levels.push_back(LevelOfDetail{simplifier.getTriangles(), simplifier.getError()});
+        if (!reached) break;
+    }
+    return levels;
+}
@@ -0,0 +1,25 @@
+//
+// Levels of detail by quadric error mesh simplification (Garland and Heckbert 1997).
+//
+
+#ifndef UEBUNG_03_MESHSIMPLIFIER_H
+#define UEBUNG_03_MESHSIMPLIFIER_H
+
+#include <vector>
+
+#include "vec3.h"
+
+struct LevelOfDetail {
+    std::vector<Vec3ui> triangles;
+    // how far the level may deviate from the full mesh, in model units
+    float error{0.f};
+};
+
+// Collapses edges into one of their vertices in the order of the quadric error, so all levels index the vertices of
+// the full mesh. Level 0 is the full mesh, every further level has at most half the triangles of the one before,
+// down to about minTriangles. Collapses that flip a triangle or join two sheets are skipped, the border of open
+// meshes is held in place by extra planes.
+std::vector<LevelOfDetail> buildLevelsOfDetail(const std::vector<Vec3f>& vertices, const std::vector<Vec3ui>& triangles,
+                                               size_t minTriangles = 256, unsigned int maxLevels = 8);
+
+#endif //UEBUNG_03_MESHSIMPLIFIER_H
@@ -9,6 +9,7 @@
 // Content: Widget for showing OpenGL scene, SOLUTION                        //
 // ========================================================================= //
 
+#include <algorithm>
 #include <cmath>
 
 #include <QtDebug>
@@ -34,9 +35,18 @@ OpenGLView::OpenGLView(QWidget* parent) : QOpenGLWidget(parent) {
 void OpenGLView::setGridSize(int gridSize)
 {
     this->gridSize = gridSize;
+    updateGridInstances();
     emit triangleCountChanged(getTriangleCount());
 }
 
+void OpenGLView::updateGridInstances() {
+    gridInstances.resize(std::max(0, gridSize));
+    for (int i = 0; i < gridSize; ++i) {
+        gridInstances[i].model.setToIdentity();
+        gridInstances[i].model.translate(static_cast<float>(i + 1), 0.f);
+    }
+}
+
 void OpenGLView::initializeGL()
 {
     f = QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_3_3_Core>(QOpenGLContext::currentContext());
@@ -117,6 +127,7 @@ void OpenGLView::resizeGL(int width, int height) {
 
     //Resize viewport
     f->glViewport(0, 0, width, height);
+    state.setViewportHeight(height);
 }
 
 void OpenGLView::drawSkybox() {
@@ -224,8 +235,9 @@ void OpenGLView::drawSkybox() {
     QMatrix4x4 view = state.getCurrentModelViewMatrix();
     view.setColumn(3, QVector4D(0, 0, 0, 1));
 
-    GLint viewLoc = f->glGetUniformLocation(skyboxShader, "view");
-    GLint projLoc = f->glGetUniformLocation(skyboxShader, "projection");
+    const ProgramUniforms& skyboxUniforms = getProgramUniforms(f, skyboxShader);
+    GLint viewLoc = skyboxUniforms.location(UNIFORM_VIEW);
+    GLint projLoc = skyboxUniforms.location(UNIFORM_PROJECTION);
     if (viewLoc != -1) {
         f->glUniformMatrix4fv(viewLoc, 1, GL_FALSE, view.constData());
     }
@@ -236,7 +248,7 @@ void OpenGLView::drawSkybox() {
     // Cubemap-Sampler binden
     f->glActiveTexture(GL_TEXTURE0);
     f->glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
-    GLint skyboxLoc = f->glGetUniformLocation(skyboxShader, "skybox");
+    GLint skyboxLoc = skyboxUniforms.location(UNIFORM_SKYBOX);
     if (skyboxLoc != -1) {
         f->glUniform1i(skyboxLoc, 0);
     }
@@ -282,12 +294,7 @@ void OpenGLView::paintGL() {
     state.setLightUniform();
 
     // draw objects. count triangles and objects drawn.
-    state.pushModelViewMatrix();
-    for (int i = 0; i < gridSize; ++i) {
-        state.getCurrentModelViewMatrix().translate(static_cast<float>(1.f), 0.f);
-        trianglesDrawn += meshes[0].draw(state);
-    }
-    state.popModelViewMatrix();
+    trianglesDrawn += meshes[0].drawInstanced(state, gridInstances);
     for (size_t i = 1; i < meshes.size(); ++i) {
         trianglesDrawn += meshes[i].draw(state);
     }
@@ -343,6 +350,7 @@ void OpenGLView::setDefaults() {
     mouseSensitivy = 1.0f;
 
     gridSize = 3;
+    updateGridInstances();
     // last run: 0 objects and 0 triangles
     objectsLastRun = 0;
     trianglesLastRun = 0;
@@ -444,6 +452,22 @@ void OpenGLView::toggleDisplacementMapping(bool enable)
     bumpSphereMesh.toggleDisplacementMapping(enable);
 }
 
+// 16 bit positions halve the position data, at a precision of 1/65535 of the bounding box
+void OpenGLView::toggleQuantizedPositions(bool enable)
+{
+    makeCurrent();
+    auto quantize = [enable](TriangleMesh& mesh) {
+        TriangleMesh::VertexLayout layout = mesh.getVertexLayout();
+        layout.quantizedPositions = enable;
+        mesh.setVertexLayout(layout);
+    };
+    for (auto& mesh: meshes) quantize(mesh);
+    quantize(sphereMesh);
+    quantize(bumpSphereMesh);
+    doneCurrent();
+    update();
+}
+
 void OpenGLView::recreateTerrain()
 {
     makeCurrent();
@@ -46,6 +46,7 @@ public slots:
     void toggleDiffuse(bool enable);
     void toggleNormalMapping(bool enable);
     void toggleDisplacementMapping(bool enable);
+    void toggleQuantizedPositions(bool enable);
     void recreateTerrain();
 
 protected:
@@ -78,6 +79,9 @@ private:
 
     static GLuint csVAO, csVBOs[2];
     int gridSize;
+    // copies of meshes[0], one per grid cell
+    std::vector<TriangleMesh::Instance> gridInstances;
+    void updateGridInstances();
 
     //light information
     float lightMotionSpeed;
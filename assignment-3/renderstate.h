@@ -11,6 +11,7 @@
 #include <QOpenGLFunctions_3_3_Core>
 
 #include "vec3.h"
+#include "shader.h"
 
 class RenderState {
     Vec3f lightPos;
@@ -18,10 +19,13 @@ class RenderState {
     std::stack<QMatrix4x4> modelViewMatrixStack;
     std::stack<QMatrix4x4> projectionMatrixStack;
     QOpenGLFunctions_3_3_Core* f;
-    GLint modelViewMatrixUniformStandard{-1}, projectionMatrixUniformStandard{-1}, normalMatrixUniformStandard{-1}, lightPositionUniformStandard{-1},
-            cameraPositionUniformStandard{-1}, textureUniformStandard{-1}, normalMapUniformStandard{-1}, useTextureUniformStandard{-1};
-    GLint modelViewMatrixUniform{-1}, projectionMatrixUniform{-1}, normalMatrixUniform{-1}, lightPositionUniform{-1},
-        cameraPositionUniform{-1}, textureUniform{-1}, normalMapUniform{-1}, useTextureUniform{-1};
+    // reflection of the active and of the standard program, see getProgramUniforms
+    const ProgramUniforms* uniforms{nullptr};
+    const ProgramUniforms* standardUniforms{nullptr};
+    // height of the viewport in pixels, turns projected lengths into pixels
+    int viewportHeight{1};
+    // largest deviation from the full mesh in pixels that a level of detail may show, 0 draws the full meshes
+    float lodPixelError{1.f};
 
     static void loadIdentity(std::stack<QMatrix4x4>& stack) {
         if (!stack.empty()) {
@@ -82,53 +86,37 @@ public:
     void setCurrentProgram(GLuint nextProgram) {
         f->glUseProgram(nextProgram);
         activeProgram = nextProgram;
-        modelViewMatrixUniform = f->glGetUniformLocation(activeProgram, "modelView");
-        projectionMatrixUniform = f->glGetUniformLocation(activeProgram, "projection");
-        normalMatrixUniform = f->glGetUniformLocation(activeProgram, "normalMatrix");
-        lightPositionUniform = f->glGetUniformLocation(activeProgram, "lightPosition");
-        cameraPositionUniform = f->glGetUniformLocation(activeProgram, "cameraPosition");
-        textureUniform = f->glGetUniformLocation(activeProgram, "diffuseTexture");
-        normalMapUniform = f->glGetUniformLocation(activeProgram, "normalMap");
-        useTextureUniform = f->glGetUniformLocation(activeProgram, "useTexture");
+        uniforms = &getProgramUniforms(f, activeProgram);
     }
 
     void setStandardProgram(GLuint standardProgram) {
         f->glUseProgram(standardProgram);
         activeProgram = standardProgram;
         this->standardProgram = standardProgram;
-
-        modelViewMatrixUniformStandard = f->glGetUniformLocation(activeProgram, "modelView");
-        projectionMatrixUniformStandard = f->glGetUniformLocation(activeProgram, "projection");
-        normalMatrixUniformStandard = f->glGetUniformLocation(activeProgram, "normalMatrix");
-        lightPositionUniformStandard = f->glGetUniformLocation(activeProgram, "lightPosition");
-        cameraPositionUniformStandard = f->glGetUniformLocation(activeProgram, "cameraPosition");
-        textureUniformStandard = f->glGetUniformLocation(activeProgram, "diffuseTexture");
-        normalMapUniformStandard = f->glGetUniformLocation(activeProgram, "normalMap");
-        useTextureUniformStandard = f->glGetUniformLocation(activeProgram, "useTexture");
+        standardUniforms = uniforms = &getProgramUniforms(f, activeProgram);
     }
 
     void switchToStandardProgram() {
         f->glUseProgram(standardProgram);
         activeProgram = standardProgram;
-
-        modelViewMatrixUniform = modelViewMatrixUniformStandard;
-        projectionMatrixUniform = projectionMatrixUniformStandard;
-        normalMatrixUniform = normalMatrixUniformStandard;
-        lightPositionUniform = lightPositionUniformStandard;
-        cameraPositionUniform = cameraPositionUniformStandard;
-        textureUniform = textureUniformStandard;
-        normalMapUniform = normalMapUniformStandard;
-        useTextureUniform = useTextureUniformStandard;
+        uniforms = standardUniforms;
     }
 
-    GLint getModelViewUniform() const { return modelViewMatrixUniform; }
-    GLint getProjectionUniform() const { return projectionMatrixUniform; }
-    GLint getNormalMatrixUniform() const { return normalMatrixUniform; }
-    GLint getLightPositionUniform() const { return lightPositionUniform; }
-    GLint getCameraPositionUniform() const { return cameraPositionUniform; }
-    GLint getTextureUniform() const { return textureUniform; }
-    GLint getNormalMapUniform() const { return normalMapUniform; }
-    GLint getUseTextureUniform() const { return useTextureUniform; }
+    // location in the active program, -1 if it does not use the uniform
+    GLint getUniform(UniformName name) const { return uniforms ? uniforms->location(name) : -1; }
+    GLint getModelViewUniform() const { return getUniform(UNIFORM_MODEL_VIEW); }
+    GLint getProjectionUniform() const { return getUniform(UNIFORM_PROJECTION); }
+    GLint getNormalMatrixUniform() const { return getUniform(UNIFORM_NORMAL_MATRIX); }
+    GLint getLightPositionUniform() const { return getUniform(UNIFORM_LIGHT_POSITION); }
+    GLint getCameraPositionUniform() const { return getUniform(UNIFORM_CAMERA_POSITION); }
+    GLint getTextureUniform() const { return getUniform(UNIFORM_DIFFUSE_TEXTURE); }
+    GLint getNormalMapUniform() const { return getUniform(UNIFORM_NORMAL_MAP); }
+    GLint getUseTextureUniform() const { return getUniform(UNIFORM_USE_TEXTURE); }
+
+    int getViewportHeight() const { return viewportHeight; }
+    void setViewportHeight(int height) { viewportHeight = height > 0 ? height : 1; }
+    float getLodPixelError() const { return lodPixelError; }
+    void setLodPixelError(float pixels) { lodPixelError = pixels > 0.f ? pixels : 0.f; }
 
     Vec3f& getLightPos() {
         return lightPos;
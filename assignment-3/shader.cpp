@@ -1,5 +1,54 @@
+#include <algorithm>
+#include <iterator>
+
 #include "shader.h"
 
+namespace {
+    // in the order of UniformName
+    const char* const UNIFORM_NAMES[UNIFORM_NAME_COUNT] = {
+        "modelView", "projection", "normalMatrix", "lightPosition", "cameraPosition",
+        "diffuseTexture", "normalMap", "useTexture", "useDiffuse", "useNormal",
+        "useDisplacement", "normalTexture", "displacementTexture", "view", "skybox",
+        "instanced", "quantizedPositions", "positionOffset", "positionScale", "instanceColors"
+    };
+
+    std::unordered_map<GLuint, ProgramUniforms> programUniforms;
+
+    ProgramUniforms reflectProgram(QOpenGLFunctions_3_3_Core* f, GLuint program) {
+        ProgramUniforms result;
+        std::fill(std::begin(result.locations), std::end(result.locations), -1);
+        if (program == 0) return result;
+        GLint count = 0, maxLength = 0;
+        f->glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        f->glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            UniformInfo info{};
+            f->glGetActiveUniform(program, i, buffer.size(), &length, &info.size, &info.type, buffer.data());
+            std::string name(buffer.data(), length);
+            // arrays are reported as name[0], the location of the first element is the one of the array
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) name.resize(name.size() - 3);
+            // uniforms in uniform blocks have no location
+            info.location = f->glGetUniformLocation(program, name.c_str());
+            if (info.location != -1) result.byName[name] = info;
+        }
+        for (unsigned int i = 0; i < UNIFORM_NAME_COUNT; ++i) result.locations[i] = result.location(UNIFORM_NAMES[i]);
+        return result;
+    }
+}
+
+GLint ProgramUniforms::location(const std::string& name) const {
+    auto it = byName.find(name);
+    return it == byName.end() ? -1 : it->second.location;
+}
+
+const ProgramUniforms& getProgramUniforms(QOpenGLFunctions_3_3_Core* f, GLuint program) {
+    auto it = programUniforms.find(program);
+    if (it == programUniforms.end()) it = programUniforms.emplace(program, reflectProgram(f, program)).first;
+    return it->second;
+}
+
 GLint getProgramLogLength(QOpenGLFunctions_3_3_Core* f, GLuint obj) {
     GLint infologLength = 0;
     f->glGetProgramiv(obj, GL_INFO_LOG_LENGTH, &infologLength);
@@ -115,6 +164,9 @@ GLuint compileShaders(QOpenGLFunctions_3_3_Core* f, const char* vertexShaderSrc,
         
         f->glDeleteProgram(program);
         program = 0;
+    } else {
+        // program names can be reused after a program was deleted
+        programUniforms[program] = reflectProgram(f, program);
     }
     return program;
 }
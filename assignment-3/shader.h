@@ -14,6 +14,7 @@
 
 #include <iostream>      // cout
 #include <string>
+#include <unordered_map>
 
 #include <QDebug>
 #include <QtGlobal>
@@ -29,6 +30,38 @@ const GLuint NORMAL_LOCATION = 1;
 const GLuint COLOR_LOCATION = 2;
 const GLuint TEXCOORD_LOCATION = 3;
 const GLuint TANGENT_LOCATION = 4;
+// per instance attributes of instanced draws, the model matrix takes one location per column
+const GLuint INSTANCE_MODEL_LOCATION = 5;
+const GLuint INSTANCE_COLOR_LOCATION = 9;
+
+// Uniforms the renderer sets every frame. The reflection of every program stores their locations in this order, so
+// the render loop looks them up by index instead of asking OpenGL by name.
+enum UniformName : unsigned int {
+    UNIFORM_MODEL_VIEW, UNIFORM_PROJECTION, UNIFORM_NORMAL_MATRIX, UNIFORM_LIGHT_POSITION, UNIFORM_CAMERA_POSITION,
+    UNIFORM_DIFFUSE_TEXTURE, UNIFORM_NORMAL_MAP, UNIFORM_USE_TEXTURE, UNIFORM_USE_DIFFUSE, UNIFORM_USE_NORMAL,
+    UNIFORM_USE_DISPLACEMENT, UNIFORM_NORMAL_TEXTURE, UNIFORM_DISPLACEMENT_TEXTURE, UNIFORM_VIEW, UNIFORM_SKYBOX,
+    UNIFORM_INSTANCED, UNIFORM_QUANTIZED_POSITIONS, UNIFORM_POSITION_OFFSET, UNIFORM_POSITION_SCALE, UNIFORM_INSTANCE_COLORS, UNIFORM_NAME_COUNT
+};
+
+struct UniformInfo {
+    GLint location;
+    GLenum type;  // e.g. GL_FLOAT_VEC3 or GL_SAMPLER_2D
+    GLint size;   // number of elements for arrays, 1 otherwise
+};
+
+// Active uniforms of a linked program
+struct ProgramUniforms {
+    GLint locations[UNIFORM_NAME_COUNT]; // -1 where the program does not use the uniform
+    std::unordered_map<std::string, UniformInfo> byName; // all active uniforms, arrays without the [0]
+
+    GLint location(UniformName name) const { return locations[name]; }
+    // for uniforms that are not in UniformName, -1 if the program does not use it
+    GLint location(const std::string& name) const;
+};
+
+// Reflection of a program, read once after linking in compileShaders. Programs created elsewhere are read on their
+// first use. The reference stays valid for the lifetime of the application.
+const ProgramUniforms& getProgramUniforms(QOpenGLFunctions_3_3_Core* f, GLuint program);
 
 GLint getProgramLogLength(QOpenGLFunctions_3_3_Core* f, GLuint obj);
 GLint getShaderLogLength(QOpenGLFunctions_3_3_Core* f, GLuint obj);
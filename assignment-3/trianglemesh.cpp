@@ -15,8 +15,12 @@
 #include <cmath>
 #include <array>
 #include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <random>
+#include <type_traits>
 #include <array>
 
 #include <fstream>
@@ -35,6 +39,47 @@
 using glVertexAttrib3fvPtr = void (*)(GLuint index, const GLfloat* v);
 using glVertexAttrib3fPtr = void (*)(GLuint index, GLfloat v1, GLfloat v2, GLfloat v3);
 
+namespace {
+    float clampUnit(float value, float low) {
+        return std::max(low, std::min(1.f, value));
+    }
+
+    // direction as three signed normalized 10 bit integers of GL_INT_2_10_10_10_REV, w = 0
+    GLuint packDirection(Vec3f direction) {
+        const float length = direction.length();
+        if (length > 0.f) direction /= length;
+        GLuint packed = 0;
+        for (unsigned int i = 0; i < 3; ++i) {
+            const GLint component = static_cast<GLint>(std::lround(clampUnit(direction[i], -1.f) * 511.f));
+            packed |= (static_cast<GLuint>(component) & 0x3FFu) << (10 * i);
+        }
+        return packed;
+    }
+
+    // IEEE half float, rounded to nearest. Values too small for a normal half become 0, too large ones infinity.
+    GLushort packHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000u;
+        const int exponent = static_cast<int>((bits >> 23) & 0xFFu) - 127 + 15;
+        const uint32_t mantissa = bits & 0x7FFFFFu;
+        if (exponent <= 0) return static_cast<GLushort>(sign);
+        if (exponent >= 31) return static_cast<GLushort>(sign | 0x7C00u);
+        // a carry out of the mantissa correctly increments the exponent
+        uint32_t half = sign | static_cast<uint32_t>(exponent) << 10 | mantissa >> 13;
+        if (mantissa & 0x1000u) half++;
+        return static_cast<GLushort>(half);
+    }
+
+    struct VertexAttribute {
+        GLuint location;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    };
+}
+
 TriangleMesh::TriangleMesh(QOpenGLFunctions_3_3_Core* f)
     : staticColor(1.f, 1.f, 1.f), f(f)
 {
@@ -53,6 +98,9 @@ void TriangleMesh::clear() {
     normals.clear();
     colors.clear();
     texCoords.clear();
+    coarseLevels.clear();
+    currentLevel = 0;
+    instanceLevels.clear();
     // clear bounding box data
     boundingBoxMin = Vec3f(FLT_MAX, FLT_MAX, FLT_MAX);
     boundingBoxMax = Vec3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
@@ -77,7 +125,9 @@ void TriangleMesh::coutData() {
     std::cout << "BB: (" << boundingBoxMin << ") - (" << boundingBoxMax << ")" << std::endl;
     std::cout << "  BBMid: (" << boundingBoxMid << ")" << std::endl;
     std::cout << "  BBSize: (" << boundingBoxSize << ")" << std::endl;
-    std::cout << "  VAO ID: " << VAO() << ", VBO IDs: f=" << VBOf() << ", v=" << VBOv() << ", n=" << VBOn() << ", c=" << VBOc() << ", t=" << VBOt() << std::endl;
+    std::cout << "  VAO ID: " << VAO() << ", VBO IDs: f=" << VBOf() << ", v=" << VBOv() << std::endl;
+    std::cout << "  vertex size: " << vertexStride << " bytes, indices: " << (indexType == GL_UNSIGNED_SHORT ? 16 : 32) << " bit" << std::endl;
+    std::cout << "  levels of detail: " << getNumLevelsOfDetail() << std::endl;
     std::cout << "coloring using: ";
     switch (coloringType) {
         case ColoringType::STATIC_COLOR:
@@ -102,12 +152,18 @@ void TriangleMesh::coutData() {
 
 void TriangleMesh::flipNormals(bool createVBOs) {
     for (auto& n : normals) n *= -1.0f;
-    //correct VBO
-    if (createVBOs && VBOn() != 0) {
-        if (!f) return;
-        f->glBindBuffer(GL_ARRAY_BUFFER, VBOn());
-        f->glBufferSubData(GL_ARRAY_BUFFER, 0, normals.size() * sizeof(Normal), normals.data());
-        f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // the normals are interleaved with the other attributes => upload the mesh again
+    if (createVBOs && VAO() != 0) {
+        cleanupVBO();
+        createAllVBOs();
+    }
+}
+
+void TriangleMesh::setVertexLayout(const VertexLayout& layout) {
+    vertexLayout = layout;
+    if (VAO.val != 0) {
+        cleanupVBO();
+        createAllVBOs();
     }
 }
 
@@ -132,6 +188,8 @@ void TriangleMesh::scaleToLength(const float newLength, bool createVBOs) {
     boundingBoxMax *= scale;
     boundingBoxMid *= scale;
     boundingBoxSize *= scale;
+    // the errors are distances in model units
+    for (auto& level : coarseLevels) level.error *= scale;
     // data changed => delete VBOs and create new ones (not efficient but easy)
     if (createVBOs) {
         cleanupVBO();
@@ -139,6 +197,18 @@ void TriangleMesh::scaleToLength(const float newLength, bool createVBOs) {
     }
 }
 
+void TriangleMesh::generateLevelsOfDetail(bool createVBOs) {
+    coarseLevels = buildLevelsOfDetail(vertices, triangles);
+    // level 0 is the mesh itself
+    coarseLevels.erase(coarseLevels.begin());
+    currentLevel = 0;
+    instanceLevels.clear();
+    if (createVBOs) {
+        cleanupVBO();
+        createAllVBOs();
+    }
+}
+
 // =================
 // === LOAD MESH ===
 // =================
@@ -204,6 +274,7 @@ void TriangleMesh::loadOFF(const char* filename, bool createVBOs) {
     if (!noff) calculateNormalsByArea();
     // calculate texture coordinates
     calculateTexCoordsSphereMapping();
+    generateLevelsOfDetail(false);
     // createVBO
     if (createVBOs) {
         createAllVBOs();
@@ -331,53 +402,133 @@ void TriangleMesh::createNormalVAO(QOpenGLFunctions_3_3_Core* f) {
 
 void TriangleMesh::createAllVBOs() {
     if (!f) return;
+    const bool compressed = vertexLayout.compressedAttributes;
+    const bool hasColors = colors.size() == vertices.size();
+    const bool hasTexCoords = texCoords.size() == vertices.size();
+    const bool hasTangents = tangents.size() == vertices.size();
+    const bool hasNormals = normals.size() == vertices.size();
+
+    // byte offsets of the attributes in one vertex, every attribute starts at a multiple of 4
+    std::vector<VertexAttribute> attributes;
+    size_t stride = 0;
+    auto addAttribute = [&](GLuint location, GLint size, GLenum type, GLboolean normalized, size_t bytes) {
+        attributes.push_back(VertexAttribute{location, size, type, normalized, stride});
+        stride += bytes;
+        return attributes.back().offset;
+    };
+    const size_t positionOffsetInVertex = vertexLayout.quantizedPositions
+        ? addAttribute(POSITION_LOCATION, 3, GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(GLushort))
+        : addAttribute(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex));
+    size_t normalOffset = 0, colorOffset = 0, texCoordOffset = 0, tangentOffset = 0;
+    if (hasNormals) normalOffset = compressed ? addAttribute(NORMAL_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(GLuint))
+                                               : addAttribute(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Normal));
+    if (hasColors) colorOffset = compressed ? addAttribute(COLOR_LOCATION, 3, GL_UNSIGNED_BYTE, GL_TRUE, 4 * sizeof(GLubyte))
+                                             : addAttribute(COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Color));
+    if (hasTexCoords) texCoordOffset = compressed ? addAttribute(TEXCOORD_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, 2 * sizeof(GLushort))
+                                                   : addAttribute(TEXCOORD_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(TexCoord));
+    if (hasTangents) tangentOffset = compressed ? addAttribute(TANGENT_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(GLuint))
+                                                 : addAttribute(TANGENT_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Tangent));
+
+    // the quantized positions are fractions of the bounding box, a flat side keeps scale 1 to avoid dividing by 0
+    positionOffset = boundingBoxMin;
+    for (unsigned int i = 0; i < 3; ++i) positionScale[i] = boundingBoxSize[i] > 0.f ? boundingBoxSize[i] : 1.f;
+
+    std::vector<unsigned char> data(stride * vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        unsigned char* vertex = data.data() + v * stride;
+        if (vertexLayout.quantizedPositions) {
+            GLushort position[4] = {0, 0, 0, 0};
+            for (unsigned int i = 0; i < 3; ++i) {
+                position[i] = static_cast<GLushort>(std::lround(clampUnit((vertices[v][i] - positionOffset[i]) / positionScale[i], 0.f) * 65535.f));
+            }
+            std::memcpy(vertex + positionOffsetInVertex, position, sizeof(position));
+        } else {
+            std::memcpy(vertex + positionOffsetInVertex, &vertices[v], sizeof(Vertex));
+        }
+        if (hasNormals) {
+            if (compressed) {
+                const GLuint normal = packDirection(normals[v]);
+                std::memcpy(vertex + normalOffset, &normal, sizeof(normal));
+            } else {
+                std::memcpy(vertex + normalOffset, &normals[v], sizeof(Normal));
+            }
+        }
+        if (hasColors) {
+            if (compressed) {
+                GLubyte color[4] = {0, 0, 0, 0};
+                for (unsigned int i = 0; i < 3; ++i) color[i] = static_cast<GLubyte>(std::lround(clampUnit(colors[v][i], 0.f) * 255.f));
+                std::memcpy(vertex + colorOffset, color, sizeof(color));
+            } else {
+                std::memcpy(vertex + colorOffset, &colors[v], sizeof(Color));
+            }
+        }
+        if (hasTexCoords) {
+            if (compressed) {
+                const GLushort texCoord[2] = {packHalf(texCoords[v].u), packHalf(texCoords[v].v)};
+                std::memcpy(vertex + texCoordOffset, texCoord, sizeof(texCoord));
+            } else {
+                std::memcpy(vertex + texCoordOffset, &texCoords[v], sizeof(TexCoord));
+            }
+        }
+        if (hasTangents) {
+            if (compressed) {
+                const GLuint tangent = packDirection(tangents[v]);
+                std::memcpy(vertex + tangentOffset, &tangent, sizeof(tangent));
+            } else {
+                std::memcpy(vertex + tangentOffset, &tangents[v], sizeof(Tangent));
+            }
+        }
+    }
+    vertexStride = static_cast<GLsizei>(stride);
+    hasColorAttribute = hasColors;
+
     // create VAOs
     f->glGenVertexArrays(1, &VAO.val);
 
-    // create VBOs
-    VBOf.val = createVBO(f, triangles.data(), triangles.size() * sizeof(Triangle), GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
-    VBOv.val = createVBO(f, vertices.data(), vertices.size() * sizeof(Vertex), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    VBOn.val = createVBO(f, normals.data(), normals.size() * sizeof(Normal), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    if (colors.size() == vertices.size()) {
-        VBOc.val = createVBO(f, colors.data(), colors.size() * sizeof(Color), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-        f->glEnableVertexAttribArray(COLOR_LOCATION);
-    }
-    if (texCoords.size() == vertices.size()) {
-        VBOt.val = createVBO(f, texCoords.data(), texCoords.size() * sizeof(TexCoord), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-        f->glEnableVertexAttribArray(TEXCOORD_LOCATION);
+    // all levels of detail one after another in VBOf, the full mesh first
+    levelRanges.clear();
+    levelRanges.push_back(LevelRange{0, static_cast<GLsizei>(3 * triangles.size()), 0.f});
+    for (const LevelOfDetail& level : coarseLevels) {
+        const LevelRange& previous = levelRanges.back();
+        levelRanges.push_back(LevelRange{previous.firstIndex + previous.indexCount, static_cast<GLsizei>(3 * level.triangles.size()), level.error});
     }
-    if (tangents.size() == vertices.size()) {
-        VBOtan.val = createVBO(f, tangents.data(), tangents.size() * sizeof(Tangent), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-        f->glEnableVertexAttribArray(TANGENT_LOCATION);   
+    auto appendIndices = [&](auto& indices) {
+        using Index = typename std::decay<decltype(indices)>::type::value_type;
+        indices.reserve(levelRanges.back().firstIndex + levelRanges.back().indexCount);
+        auto append = [&](const Triangles& levelTriangles) {
+            for (const auto& triangle : levelTriangles) {
+                for (unsigned int i = 0; i < 3; ++i) indices.push_back(static_cast<Index>(triangle[i]));
+            }
+        };
+        append(triangles);
+        for (const LevelOfDetail& level : coarseLevels) append(level.triangles);
+    };
+
+    // create VBOs, indices with 16 bit if every vertex can be addressed with them
+    if (vertices.size() < 65536) {
+        std::vector<GLushort> indices;
+        appendIndices(indices);
+        VBOf.val = createVBO(f, indices.data(), indices.size() * sizeof(GLushort), GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_SHORT;
+    } else {
+        std::vector<GLuint> indices;
+        appendIndices(indices);
+        VBOf.val = createVBO(f, indices.data(), indices.size() * sizeof(GLuint), GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_INT;
     }
+    VBOv.val = createVBO(f, data.data(), data.size(), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
 
     // bind VBOs to VAO object
     f->glBindVertexArray(VAO.val);
     f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBOf.val);
     f->glBindBuffer(GL_ARRAY_BUFFER, VBOv.val);
-    f->glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-    f->glEnableVertexAttribArray(POSITION_LOCATION);
-    f->glBindBuffer(GL_ARRAY_BUFFER, VBOn.val);
-    f->glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-    f->glEnableVertexAttribArray(NORMAL_LOCATION);
-    if (VBOc.val) {
-        f->glBindBuffer(GL_ARRAY_BUFFER, VBOc.val);
-        f->glVertexAttribPointer(COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        f->glEnableVertexAttribArray(COLOR_LOCATION);
-    }
-
-    if (VBOt.val) {
-        f->glBindBuffer(GL_ARRAY_BUFFER, VBOt.val);
-        f->glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-        f->glEnableVertexAttribArray(TEXCOORD_LOCATION);
-    }
-    if (VBOtan.val) {
-        f->glBindBuffer(GL_ARRAY_BUFFER, VBOtan.val);
-        f->glVertexAttribPointer(TANGENT_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        f->glEnableVertexAttribArray(TANGENT_LOCATION);   
+    for (const VertexAttribute& attribute : attributes) {
+        f->glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, vertexStride, reinterpret_cast<const void*>(attribute.offset));
+        f->glEnableVertexAttribArray(attribute.location);
     }
 
     f->glBindVertexArray(0);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     createBBVAO(f);
 
@@ -394,31 +545,31 @@ void TriangleMesh::cleanupVBO(QOpenGLFunctions_3_3_Core* f) {
     if (VAO.val != 0) f->glDeleteVertexArrays(1, &VAO.val);
     // delete VBO
     if (VBOv.val != 0) f->glDeleteBuffers(1, &VBOv.val);
-    if (VBOn.val != 0) f->glDeleteBuffers(1, &VBOn.val);
     if (VBOf.val != 0) f->glDeleteBuffers(1, &VBOf.val);
-    if (VBOc.val != 0) f->glDeleteBuffers(1, &VBOc.val);
-    if (VBOt.val != 0) f->glDeleteBuffers(1, &VBOt.val);
-    if (VBOtan.val != 0) f->glDeleteBuffers(1, &VBOtan.val);
     if (VAObb.val != 0) f->glDeleteVertexArrays(1, &VAObb.val);
     if (VBOvbb.val != 0) f->glDeleteBuffers(1, &VBOvbb.val);
     if (VBOfbb.val != 0) f->glDeleteBuffers(1, &VBOfbb.val);
     if (VAOn.val != 0) f->glDeleteVertexArrays(1, &VAOn.val);
+    if (VBOinst.val != 0) f->glDeleteBuffers(1, &VBOinst.val);
     if (VBOvn.val != 0) f->glDeleteBuffers(1, &VBOvn.val);
     VBOv.val = 0;
-    VBOn.val = 0;
     VBOf.val = 0;
-    VBOc.val = 0;
-    VBOt.val = 0;
-    VBOtan.val = 0;
+    levelRanges.clear();
+    hasColorAttribute = false;
     VAO.val = 0;
     VAObb.val = 0;
     VBOfbb.val = 0;
     VBOvbb.val = 0;
     VAOn.val = 0;
     VBOvn.val = 0;
+    VBOinst.val = 0;
 }
 
 unsigned int TriangleMesh::draw(RenderState& state) {
+    return drawLevelOfDetail(state, currentLevel);
+}
+
+unsigned int TriangleMesh::drawLevelOfDetail(RenderState& state, unsigned int& level) {
     if (!boundingBoxIsVisible(state)) return 0;
     if (VAO.val == 0) return 0;
     if (withBB || withNormals) {
@@ -428,12 +579,148 @@ unsigned int TriangleMesh::draw(RenderState& state) {
         if (withNormals) drawNormals(state);
         state.setCurrentProgram(formerProgram);
     }
-    drawVBO(state);
+    level = selectLevelOfDetail(state, level);
+    drawVBO(state, 0, level);
 
-    return triangles.size();
+    return levelRanges[level].indexCount / 3;
 }
 
-void TriangleMesh::drawVBO(RenderState& state) {
+unsigned int TriangleMesh::drawInstanced(RenderState& state, const std::vector<Instance>& instances, bool instanceColors) {
+    if (VAO.val == 0) return 0;
+    // the levels belong to the copies by their position in instances
+    if (instanceLevels.size() != instances.size()) instanceLevels.assign(instances.size(), 0);
+    if (state.getUniform(UNIFORM_INSTANCED) == -1) {
+        unsigned int result = 0;
+        for (size_t i = 0; i < instances.size(); ++i) {
+            state.pushModelViewMatrix();
+            state.getCurrentModelViewMatrix() *= instances[i].model;
+            result += drawLevelOfDetail(state, instanceLevels[i]);
+            state.popModelViewMatrix();
+        }
+        return result;
+    }
+
+    // cull every copy, choose its level and compact the visible ones for the upload
+    visibleInstances.clear();
+    visibleInstanceSources.clear();
+    visibleInstanceLevels.clear();
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const Instance& instance = instances[i];
+        state.pushModelViewMatrix();
+        state.getCurrentModelViewMatrix() *= instance.model;
+        if (boundingBoxIsVisible(state)) {
+            InstanceData data;
+            std::copy(instance.model.constData(), instance.model.constData() + 16, data.model);
+            for (unsigned int k = 0; k < 3; ++k) data.color[k] = instance.color[k];
+            visibleInstances.push_back(data);
+            visibleInstanceSources.push_back(&instance);
+            instanceLevels[i] = selectLevelOfDetail(state, instanceLevels[i]);
+            visibleInstanceLevels.push_back(instanceLevels[i]);
+        }
+        state.popModelViewMatrix();
+    }
+    if (visibleInstances.empty()) return 0;
+
+    // copies of the same level next to each other, so that every level is one range of VBOinst
+    std::vector<GLsizei> levelStarts(levelRanges.size() + 1, 0);
+    for (unsigned int level : visibleInstanceLevels) levelStarts[level + 1]++;
+    for (size_t level = 1; level < levelStarts.size(); ++level) levelStarts[level] += levelStarts[level - 1];
+    sortedInstances.resize(visibleInstances.size());
+    {
+        std::vector<GLsizei> next(levelStarts.begin(), levelStarts.end() - 1);
+        for (size_t i = 0; i < visibleInstances.size(); ++i) sortedInstances[next[visibleInstanceLevels[i]]++] = visibleInstances[i];
+    }
+
+    auto* f = state.getOpenGLFunctions();
+    if (VBOinst.val == 0) createInstanceVBO(f);
+    // orphan the buffer of the last frame instead of waiting until it is no longer used
+    f->glBindBuffer(GL_ARRAY_BUFFER, VBOinst.val);
+    f->glBufferData(GL_ARRAY_BUFFER, sortedInstances.size() * sizeof(InstanceData), sortedInstances.data(), GL_STREAM_DRAW);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (withBB || withNormals) {
+        GLuint formerProgram = state.getCurrentProgram();
+        state.switchToStandardProgram();
+        for (const Instance* instance : visibleInstanceSources) {
+            state.pushModelViewMatrix();
+            state.getCurrentModelViewMatrix() *= instance->model;
+            if (withBB) drawBB(state);
+            if (withNormals) drawNormals(state);
+            state.popModelViewMatrix();
+        }
+        state.setCurrentProgram(formerProgram);
+    }
+    unsigned int result = 0;
+    // like the instance flag, the color flag is only on during these draws
+    if (instanceColors) f->glUniform1ui(state.getUniform(UNIFORM_INSTANCE_COLORS), GL_TRUE);
+    for (unsigned int level = 0; level < levelRanges.size(); ++level) {
+        const GLsizei count = levelStarts[level + 1] - levelStarts[level];
+        if (count == 0) continue;
+        // OpenGL 3.3 has no base instance, the attributes start at the first copy of the level instead
+        bindInstanceAttributes(f, levelStarts[level]);
+        drawVBO(state, count, level);
+        result += levelRanges[level].indexCount / 3 * count;
+    }
+    if (instanceColors) f->glUniform1ui(state.getUniform(UNIFORM_INSTANCE_COLORS), GL_FALSE);
+
+    return result;
+}
+
+void TriangleMesh::createInstanceVBO(QOpenGLFunctions_3_3_Core* f) {
+    f->glGenBuffers(1, &VBOinst.val);
+    bindInstanceAttributes(f, 0);
+    f->glBindVertexArray(VAO.val);
+    for (GLuint column = 0; column < 4; ++column) {
+        f->glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+        f->glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+    }
+    f->glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+    f->glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+    f->glBindVertexArray(0);
+}
+
+void TriangleMesh::bindInstanceAttributes(QOpenGLFunctions_3_3_Core* f, GLsizei firstInstance) {
+    const size_t first = firstInstance * sizeof(InstanceData);
+    f->glBindVertexArray(VAO.val);
+    f->glBindBuffer(GL_ARRAY_BUFFER, VBOinst.val);
+    for (GLuint column = 0; column < 4; ++column) {
+        f->glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                 reinterpret_cast<const void*>(first + offsetof(InstanceData, model) + column * 4 * sizeof(GLfloat)));
+    }
+    f->glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                             reinterpret_cast<const void*>(first + offsetof(InstanceData, color)));
+    f->glBindVertexArray(0);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+unsigned int TriangleMesh::selectLevelOfDetail(const RenderState& state, unsigned int current) const {
+    const float threshold = state.getLodPixelError();
+    if (levelRanges.size() < 2 || threshold <= 0.f) return 0;
+    const QMatrix4x4& modelView = state.getCurrentModelViewMatrix();
+    const QMatrix4x4& projection = state.getCurrentProjectionMatrix();
+    // the errors grow with the largest scale of the model matrix
+    float scale = 0.f;
+    for (int column = 0; column < 3; ++column) scale = std::max(scale, modelView.column(column).toVector3D().length());
+    const float radius = 0.5f * boundingBoxSize.length() * scale;
+
+    // pixels per model unit at the point of the bounding sphere closest to the camera
+    float pixelsPerUnit = 0.5f * projection(1, 1) * state.getViewportHeight() * scale;
+    if (projection(3, 3) == 0.f) {
+        const float distance = -modelView.map(QVector3D(boundingBoxMid.x(), boundingBoxMid.y(), boundingBoxMid.z())).z() - radius;
+        // the camera is inside the sphere
+        if (distance <= 0.f) return 0;
+        pixelsPerUnit /= distance;
+    }
+
+    const float hysteresis = 0.75f;
+    for (unsigned int level = levelRanges.size() - 1; level > 0; --level) {
+        const float allowed = level > current ? hysteresis * threshold : threshold;
+        if (levelRanges[level].error * pixelsPerUnit <= allowed) return level;
+    }
+    return 0;
+}
+
+void TriangleMesh::drawVBO(RenderState& state, GLsizei instanceCount, unsigned int level) {
     auto* f = state.getOpenGLFunctions();
 
     //Bug in Qt: They flagged glVertexAttrib3f as deprecated in modern OpenGL, which is not true.
@@ -456,7 +743,7 @@ void TriangleMesh::drawVBO(RenderState& state) {
             //[[fallthrough]];
 
         case ColoringType::COLOR_ARRAY:
-            if (VBOc.val != 0) {
+            if (hasColorAttribute) {
                 f->glUniform1ui(state.getUseTextureUniform(), GL_FALSE);
                 f->glEnableVertexAttribArray(COLOR_LOCATION);
                 break;
@@ -474,35 +761,40 @@ void TriangleMesh::drawVBO(RenderState& state) {
             f->glDisableVertexAttribArray(COLOR_LOCATION);
             glVertexAttrib3fv(2, reinterpret_cast<const GLfloat*>(&staticColor));
 
-            GLint location;
-            auto program = state.getCurrentProgram();
+            f->glUniform1ui(state.getUniform(UNIFORM_USE_DIFFUSE), enableDiffuseTexture);
+            f->glUniform1ui(state.getUniform(UNIFORM_USE_NORMAL), enableNormalMapping);
+            f->glUniform1ui(state.getUniform(UNIFORM_USE_DISPLACEMENT), enableDisplacementMapping);
 
-            location = f->glGetUniformLocation(program, "useDiffuse");
-            f->glUniform1ui(location, enableDiffuseTexture);
-
-            location = f->glGetUniformLocation(program, "useNormal");
-            f->glUniform1ui(location, enableNormalMapping);
-
-            location = f->glGetUniformLocation(program, "useDisplacement");
-            f->glUniform1ui(location, enableDisplacementMapping);
-
-            location = f->glGetUniformLocation(program, "diffuseTexture");
-            f->glUniform1i(location, 0);
+            f->glUniform1i(state.getUniform(UNIFORM_DIFFUSE_TEXTURE), 0);
             f->glActiveTexture(GL_TEXTURE0);
             f->glBindTexture(GL_TEXTURE_2D, textureID.val);
 
-            location = f->glGetUniformLocation(program, "normalTexture");
-            f->glUniform1i(location, 1);
+            f->glUniform1i(state.getUniform(UNIFORM_NORMAL_TEXTURE), 1);
             f->glActiveTexture(GL_TEXTURE1);
             f->glBindTexture(GL_TEXTURE_2D, normalMapID.val);
 
-            location = f->glGetUniformLocation(program, "displacementTexture");
-            f->glUniform1i(location, 3);
+            f->glUniform1i(state.getUniform(UNIFORM_DISPLACEMENT_TEXTURE), 3);
             f->glActiveTexture(GL_TEXTURE3);
             f->glBindTexture(GL_TEXTURE_2D, displacementMapID.val);
             break;
     }
-    f->glDrawElements(GL_TRIANGLES, 3*triangles.size(), GL_UNSIGNED_INT, nullptr);
+    // like the instance flag, the flag for quantized positions is only on during the draw of such a mesh
+    if (vertexLayout.quantizedPositions) {
+        f->glUniform1ui(state.getUniform(UNIFORM_QUANTIZED_POSITIONS), GL_TRUE);
+        f->glUniform3fv(state.getUniform(UNIFORM_POSITION_OFFSET), 1, reinterpret_cast<const GLfloat*>(&positionOffset));
+        f->glUniform3fv(state.getUniform(UNIFORM_POSITION_SCALE), 1, reinterpret_cast<const GLfloat*>(&positionScale));
+    }
+    const LevelRange& range = levelRanges[std::min<size_t>(level, levelRanges.size() - 1)];
+    const void* firstIndex = reinterpret_cast<const void*>(range.firstIndex * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+    if (instanceCount > 0) {
+        // the flag stays off between instanced draws, so that other draws with the program ignore the attributes
+        f->glUniform1ui(state.getUniform(UNIFORM_INSTANCED), GL_TRUE);
+        f->glDrawElementsInstanced(GL_TRIANGLES, range.indexCount, indexType, firstIndex, instanceCount);
+        f->glUniform1ui(state.getUniform(UNIFORM_INSTANCED), GL_FALSE);
+    } else {
+        f->glDrawElements(GL_TRIANGLES, range.indexCount, indexType, firstIndex);
+    }
+    if (vertexLayout.quantizedPositions) f->glUniform1ui(state.getUniform(UNIFORM_QUANTIZED_POSITIONS), GL_FALSE);
 }
 
 // ===========
@@ -689,6 +981,7 @@ void TriangleMesh::generateTerrain(unsigned int h, unsigned int w, unsigned int
 
     vertices.clear();   // Entfernt alle vorhandenen Vertices
     triangles.clear();  // Entfernt alle vorhandenen Dreiecke
+    coarseLevels.clear();
     colors.clear();     // Entfernt alle vorhandenen Farben
 
     vertices.reserve((h + 1) * (w + 1)); // Reserviert Speicherplatz für die Vertices
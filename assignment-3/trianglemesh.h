@@ -5,11 +5,13 @@
 #ifndef TRIANGLEMESH_H
 #define TRIANGLEMESH_H
 
+#include <QMatrix4x4>
 #include <QOpenGLContext>
 
 #include <vector>
 
 #include "vec3.h"
+#include "meshsimplifier.h"
 #include "utilities.h"
 
 //Forward declaration, avoids being forced to include header
@@ -24,6 +26,13 @@ public:
         TEXTURE,
         BUMP_MAPPING,
     };
+    // Layout of the interleaved vertex buffer. Compressed attributes store normals and tangents as 10 bit integers,
+    // colors as bytes and texture coordinates as half floats. Quantized positions are 16 bit fractions of the
+    // bounding box, which the vertex shader scales back (see only_mvp.vert).
+    struct VertexLayout {
+        bool compressedAttributes{true};
+        bool quantizedPositions{false};
+    };
 private:
     // typedefs for data
     typedef Vec3ui Triangle;
@@ -51,12 +60,33 @@ private:
     Vec3f staticColor;
     ColoringType coloringType{ColoringType::STATIC_COLOR};
 
-    // VAO and VBO ids for vertices, normals, faces, colors, texCoords, tangents
-    autoMoved<GLuint> VAO{}, VBOv{}, VBOn{}, VBOf{}, VBOc{}, VBOt{}, VBOtan{};
+    // VAO and VBO ids for the interleaved vertex attributes and the faces
+    autoMoved<GLuint> VAO{}, VBOv{}, VBOf{};
+    // format of the uploaded data
+    VertexLayout vertexLayout;
+    GLsizei vertexStride{0};
+    GLenum indexType{GL_UNSIGNED_INT};
+    bool hasColorAttribute{false};
+    // bounding box the quantized positions were computed for
+    Vec3f positionOffset;
+    Vec3f positionScale;
+    // coarser versions of triangles for distant copies, levels 1, 2, ... of buildLevelsOfDetail
+    std::vector<LevelOfDetail> coarseLevels;
+    // where every level including the full mesh is in VBOf
+    struct LevelRange {
+        GLsizei firstIndex;
+        GLsizei indexCount;
+        float error;
+    };
+    std::vector<LevelRange> levelRanges;
+    // level chosen in the last draw, kept for the hysteresis
+    unsigned int currentLevel{0};
     // VBO for bounding box
     autoMoved<GLuint> VAObb{}, VBOvbb{}, VBOfbb{};
     //VBO for normal lines
     autoMoved<GLuint> VAOn{}, VBOvn{};
+    //VBO for per instance data, attached to VAO on the first instanced draw
+    autoMoved<GLuint> VBOinst{};
     // texture
     autoMoved<GLuint> textureID{};
     autoMoved<GLuint> normalMapID{};
@@ -125,6 +155,9 @@ public:
     void setDisplacementTexture(GLuint texID) { displacementMapID.val = texID; };
     //set default color
     void setStaticColor(Vec3f color);
+    // changes the layout of the vertex buffer, uploads the mesh again if it already was
+    void setVertexLayout(const VertexLayout& layout);
+    const VertexLayout& getVertexLayout() const { return vertexLayout; }
     // translates vertices so that the bounding box center is at newBBmid
     void translateToCenter(const Vec3f& newBBmid, bool createVBOs = true);
     //enable or disable BB and normal drawing
@@ -134,6 +167,10 @@ public:
     void toggleNormalMapping(bool enable) { enableNormalMapping = enable; }
     void toggleDisplacementMapping(bool enable) { enableDisplacementMapping = enable; }
 
+    // simplifies the mesh down to a few hundred triangles, draw picks the coarsest level that looks like the full one
+    void generateLevelsOfDetail(bool createVBOs = true);
+    unsigned int getNumLevelsOfDetail() const { return 1 + coarseLevels.size(); }
+
     // scales vertices so that the largest bounding box size has length newLength
     void scaleToLength(float newLength, bool createVBOs = true);
 
@@ -141,7 +178,7 @@ public:
     // === LOAD MESH ===
     // =================
 
-    // read from an OFF file. also calculates normals if not given in the file.
+    // read from an OFF file. also calculates normals if not given in the file and the levels of detail.
     void loadOFF(const char* filename, bool createVBOs = true);
 
     // read from an OFF file. also calculates normals if not given in the file.
@@ -162,7 +199,7 @@ private:
     // calculates axis aligned bounding box data
     void calculateBB();
 
-    // create VBOs for vertices, faces, normals, colors, textureCoords
+    // create the interleaved VBO for vertices, normals, colors, textureCoords, tangents and the VBO for faces
     void createAllVBOs();
     // create VBOs for normals
     void createNormalVAO(QOpenGLFunctions_3_3_Core* f);
@@ -180,17 +217,49 @@ private:
     // ==============
 
 public:
+    // one copy of the mesh for drawInstanced. The color is only used by a draw with instanceColors, where it replaces
+    // the static or vertex colors, not the texture.
+    struct Instance {
+        QMatrix4x4 model;
+        Vec3f color;
+    };
 
     // set coloring type
     void setColoringMode(ColoringType type) { coloringType = type; };
 
     // draw mesh with current drawing mode settings. returns the number of triangles drawn.
+    // The level of detail is the coarsest one whose error covers at most RenderState::getLodPixelError pixels.
     unsigned int draw(RenderState& state);
 
+    // Draws all copies in the view frustum with one draw call per level of detail. Only the visible ones are
+    // uploaded. Programs without the instance attributes (see only_mvp.vert) get one draw per copy. Without
+    // instanceColors the copies keep the coloring of the mesh. Returns the number of triangles drawn.
+    unsigned int drawInstanced(RenderState& state, const std::vector<Instance>& instances, bool instanceColors = false);
+
 private:
+    // layout of VBOinst
+    struct InstanceData {
+        GLfloat model[16];
+        GLfloat color[3];
+    };
+    std::vector<InstanceData> visibleInstances, sortedInstances;
+    std::vector<const Instance*> visibleInstanceSources;
+    // level of detail of every copy of the last drawInstanced and of the visible ones
+    std::vector<unsigned int> instanceLevels, visibleInstanceLevels;
+
+    void createInstanceVBO(QOpenGLFunctions_3_3_Core* f);
+    // points the instance attributes of VAO at VBOinst, starting with copy firstInstance
+    void bindInstanceAttributes(QOpenGLFunctions_3_3_Core* f, GLsizei firstInstance);
+
+    // Level of detail for the current model view matrix. Coarser levels than the current one must stay below a
+    // smaller error, so that a copy near the threshold does not switch every frame.
+    unsigned int selectLevelOfDetail(const RenderState& state, unsigned int current) const;
+
+    // culls, updates level and draws, returns the number of triangles drawn
+    unsigned int drawLevelOfDetail(RenderState& state, unsigned int& level);
 
-    // draw VBO
-    void drawVBO(RenderState& state);
+    // draw VBO at the level of detail, instanceCount copies from VBOinst if not 0
+    void drawVBO(RenderState& state, GLsizei instanceCount = 0, unsigned int level = 0);
 
     // draw the bounding box (wired, immediate mode) (withBB)
     void drawBB(RenderState& state);
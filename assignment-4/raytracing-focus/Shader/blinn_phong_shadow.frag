@@ -3,26 +3,47 @@
 in vec3 vNormal;   //Per-vertex normal, transformed
 in vec3 vPos;      //Position in camera coordinates
 in vec2 vTexCoord; //Texture coordinate of current vertex
+in float vOcclusion; //Baked ambient occlusion, 1 = open
 in vec4 lightProjectedPosition;
 
 uniform sampler2DShadow depthMap;   //Depth map
+uniform sampler2D shadowMask;       //Ray traced shadows in screen space, 1 = lit
+uniform bool useShadowMask;
+uniform vec2 viewportSize;
 
 //Material parameters
-uniform vec3 ambientColor;
-uniform vec3 diffuseColor;
-uniform vec3 specularColor;
-uniform float shininess;
+layout(std140) uniform Material {
+    vec3 ambientColor;
+    float shininess;
+    vec3 diffuseColor;
+    vec3 specularColor;
+};
 
 //Light parameters
-uniform vec3 lightPosition;         //Position of the light in camera coordinates
-uniform float ambientIntensity;
-uniform float lightIntensity;
+layout(std140) uniform Light {
+    vec3 lightPosition;   //Position of the light in camera coordinates
+    float lightIntensity;
+    float ambientIntensity;
+};
 
 out vec4 color;
 
 const float bias = 0.01;
 
 void main() {
-    // TODO: Ex 4.2b Implement Blinn-Phong lighting calculation and check against shadow map
-    color = vec4(1.0);
+    // TODO: Ex 4.2b Check against shadow map
+    vec3 norm = normalize(vNormal);
+    vec3 lightDir = normalize(lightPosition - vPos);
+    vec3 viewDir = normalize(-vPos); //camera is at the origin
+    vec3 halfway = normalize(lightDir + viewDir);
+
+    vec3 ambient = ambientColor * ambientIntensity * vOcclusion;
+    vec3 diffuse = diffuseColor * max(dot(norm, lightDir), 0.0) * lightIntensity;
+    vec3 specular = specularColor * pow(max(dot(norm, halfway), 0.0), shininess) * lightIntensity;
+
+    //the mask has the resolution of the ray tracing pass, it is looked up per screen position
+    float lit = 1.0;
+    if (useShadowMask) lit = texture(shadowMask, gl_FragCoord.xy / viewportSize).r;
+
+    color = vec4(ambient + lit * (diffuse + specular), 1.0);
 }
@@ -7,17 +7,24 @@ This vertex shader calculates a simple modelView and projection transformation a
 layout(location = 0) in vec3 position; //Vertex position in model coordinates
 layout(location = 1) in vec3 normal;   //Vertex normal
 layout(location = 3) in vec2 texCoord; //Texture coordinate (for using textures)
+layout(location = 5) in float occlusion; //Baked ambient occlusion, 1 if there is none
 
 uniform mat4 model;         //Model matrix
 uniform mat4 modelView;     //ModelView matrix
-uniform mat4 projection;    //Projection matrix
 uniform mat3 normalMatrix;  //The transpose inverse of the ModelView matrix, used for transformation of normals.
 uniform mat4 lightMatrix;   //ModelViewProjection Matrix of light
 
+layout(std140) uniform Frame {
+    mat4 view;            //Camera matrix of the frame
+    mat4 projection;      //Projection matrix
+    vec4 cameraPosition;  //Camera position in world coordinates
+};
+
 out vec3 vNormal;   //Per-vertex normal, transformed
 out vec3 vPos;      //Position in camera coordinates
 out vec4 lightProjectedPosition;
 out vec2 vTexCoord; //Texture coordinate of current vertex
+out float vOcclusion; //Baked ambient occlusion
 
 void main() {
     lightProjectedPosition = lightMatrix * vec4(position, 1.0);
@@ -26,4 +33,5 @@ void main() {
     vPos = tempPos.xyz / tempPos.w; //inhomogenous coordinates
     vNormal = normalMatrix * normal;
     vTexCoord = texCoord;
+    vOcclusion = occlusion;
 }
@@ -3,17 +3,22 @@
 in vec3 vNormal;   //Per-vertex normal, transformed
 in vec3 vPos;      //Position in camera coordinates
 in vec2 vTexCoord; //Texture coordinate of current vertex
+in float vOcclusion; //Baked ambient occlusion, 1 = open
 
 //Material parameters
-uniform vec3 ambientColor;
-uniform vec3 diffuseColor;
-uniform vec3 specularColor;
-uniform float shininess;
+layout(std140) uniform Material {
+    vec3 ambientColor;
+    float shininess;
+    vec3 diffuseColor;
+    vec3 specularColor;
+};
 
 //Light parameters
-uniform vec3 lightPosition;         //Position of the light in camera coordinates
-uniform float ambientIntensity;
-uniform float lightIntensity;
+layout(std140) uniform Light {
+    vec3 lightPosition;   //Position of the light in camera coordinates
+    float lightIntensity;
+    float ambientIntensity;
+};
 
 uniform vec3 viewPos;
 
@@ -28,7 +33,7 @@ void main() {
     vec3 lightDir = normalize(lightPosition - vPos);
 
     // Compute ambient component
-    vec3 ambient = ambientColor * ambientIntensity;
+    vec3 ambient = ambientColor * ambientIntensity * vOcclusion;
 
     // Compute diffuse component
     float diff = max(dot(norm, lightDir), 0.0);
@@ -3,19 +3,27 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoord;
+layout(location = 5) in float occlusion;
 
 uniform mat4 modelView;
-uniform mat4 projection;
 uniform mat3 normalMatrix;
 
+layout(std140) uniform Frame {
+    mat4 view;            //Camera matrix of the frame
+    mat4 projection;      //Projection matrix
+    vec4 cameraPosition;  //Camera position in world coordinates
+};
+
 out vec3 vNormal;
 out vec3 vPos;
 out vec2 vTexCoord;
+out float vOcclusion;
 
 void main() {
     vPos = vec3(modelView * vec4(position, 1.0));
     vNormal = normalize(normalMatrix * normal);
     vTexCoord = texCoord;
+    vOcclusion = occlusion;
 
     gl_Position = projection * modelView * vec4(position, 1.0);
 }
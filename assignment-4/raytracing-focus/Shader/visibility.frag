@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 vBarycentric;
+
+uniform uint objectID; //index of the object + 1, 0 is left for the background
+
+layout(location = 0) out uvec2 visibility;  //object ID and triangle index within the object
+layout(location = 1) out vec2 barycentric;  //weights of the second and third vertex
+
+void main() {
+    visibility = uvec2(objectID, uint(gl_PrimitiveID));
+    barycentric = vBarycentric;
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+/*
+Vertex shader of the visibility buffer pass. Only the position is needed, everything else is looked up by the ray tracer.
+*/
+
+layout(location = 0) in vec3 position; //Vertex position in model coordinates
+
+uniform mat4 modelView;     //ModelView matrix
+
+layout(std140) uniform Frame {
+    mat4 view;            //Camera matrix of the frame
+    mat4 projection;      //Projection matrix
+    vec4 cameraPosition;  //Camera position in world coordinates
+};
+
+void main() {
+    gl_Position = projection * modelView * vec4(position, 1.0);
+}
@@ -0,0 +1,43 @@
+//
+// Ambient occlusion per mesh vertex, baked with the ray tracer and drawn as vertex attribute by the raster pass.
+//
+
+#include "aobaker.h"
+#include "sampling.h"
+#include "utilities.h"
+
+std::vector<float> bakeAmbientOcclusion(const RayScene& scene, const SceneObject& object, unsigned int samples, float maxDistance) {
+    TriangleMesh& mesh = object.mesh;
+    const std::vector<Vec3f>& vertices = mesh.getVertices();
+    const std::vector<Vec3f>& normals = mesh.getNormals();
+    std::vector<float> occlusion(vertices.size(), 1.f);
+    if (normals.size() != vertices.size() || samples == 0) return occlusion;
+
+    const QMatrix4x4& model = object.getModelMatrix();
+    // normals transform with the transposed inverse
+    const QMatrix4x4 inverse = model.inverted();
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < static_cast<int>(vertices.size()); i++) {
+        const Vec3f& n = normals[i];
+        Vec3f normal(inverse(0, 0) * n.x() + inverse(1, 0) * n.y() + inverse(2, 0) * n.z(),
+                     inverse(0, 1) * n.x() + inverse(1, 1) * n.y() + inverse(2, 1) * n.z(),
+                     inverse(0, 2) * n.x() + inverse(1, 2) * n.y() + inverse(2, 2) * n.z());
+        if (normal.length() == 0.f) continue;
+        normal.normalize();
+        const Vec3f position = QVector3DToVec3f(model.map(QVector3D(vertices[i].x(), vertices[i].y(), vertices[i].z())));
+        // offset against hitting the faces around the vertex
+        const Vec3f origin = position + 1e-3f * (1.f + position.length()) * normal;
+
+        // one sequence per vertex, so the result does not depend on the thread that bakes it
+        Random random(0, i);
+        RayCost cost; // per vertex, a shared counter would have to be updated atomically for every ray
+        unsigned int open = 0;
+        for (unsigned int sample = 0; sample < samples; ++sample) {
+            // stratified in the first dimension against clumping of the few samples
+            Vec3f direction = sampleCosineHemisphere(normal, (sample + random.nextFloat()) / samples, random.nextFloat());
+            if (!scene.occluded(Ray<float>::withDirection(origin, direction), maxDistance, cost)) open++;
+        }
+        occlusion[i] = static_cast<float>(open) / samples;
+    }
+    return occlusion;
+}
@@ -0,0 +1,18 @@
+//
+// Ambient occlusion per mesh vertex, baked with the ray tracer and drawn as vertex attribute by the raster pass.
+//
+
+#ifndef UEBUNG_04_AOBAKER_H
+#define UEBUNG_04_AOBAKER_H
+
+#include <vector>
+
+#include "rayscene.h"
+#include "sceneobject.h"
+
+// Casts cosine weighted rays from every vertex of the object's mesh, placed with its model matrix. Returns per vertex
+// the fraction of rays that hit nothing closer than maxDistance, 1 for a fully open vertex. The vertices are
+// distributed over all cores. Meshes are shared between objects, so the result belongs to the object.
+std::vector<float> bakeAmbientOcclusion(const RayScene& scene, const SceneObject& object, unsigned int samples = 64, float maxDistance = 4.f);
+
+#endif //UEBUNG_04_AOBAKER_H
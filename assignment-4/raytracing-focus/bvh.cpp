@@ -0,0 +1,112 @@
+//
+// Bounding volume hierarchy for the ray tracer.
+//
+
+#include "bvh.h"
+
+namespace {
+    const unsigned int BIN_COUNT = 16;
+    const unsigned int MAX_LEAF_SIZE = 4;
+    // the traversal stack in traverseBVH has 64 entries, at most one per level is pushed
+    const unsigned int MAX_DEPTH = 60;
+
+    struct BuildContext {
+        const std::vector<AABB>& primBounds;
+        std::vector<Vec3f> centroids;
+        std::vector<BVHNode>& nodes;
+        std::vector<unsigned int>& primIndices;
+    };
+
+    void setBounds(BVHNode& node, const AABB& box) {
+        for (unsigned int i = 0; i < 3; ++i) {
+            node.boundsMin[i] = box.min[i];
+            node.boundsMax[i] = box.max[i];
+        }
+    }
+
+    void subdivide(BuildContext& ctx, unsigned int nodeIndex, unsigned int first, unsigned int count, unsigned int depth) {
+        AABB bounds, centroidBounds;
+        for (unsigned int i = first; i < first + count; ++i) {
+            bounds.grow(ctx.primBounds[ctx.primIndices[i]]);
+            centroidBounds.grow(ctx.centroids[ctx.primIndices[i]]);
+        }
+        setBounds(ctx.nodes[nodeIndex], bounds);
+        ctx.nodes[nodeIndex].leftFirst = first;
+        ctx.nodes[nodeIndex].count = count;
+        if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH) return;
+
+        // find the cheapest split over all axes with binned SAH
+        float bestCost = count * bounds.area();
+        int bestAxis = -1;
+        unsigned int bestSplit = 0;
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+            if (extent <= 0.f) continue;
+            AABB binBounds[BIN_COUNT];
+            unsigned int binCounts[BIN_COUNT] = {};
+            float scale = BIN_COUNT / extent;
+            for (unsigned int i = first; i < first + count; ++i) {
+                unsigned int prim = ctx.primIndices[i];
+                unsigned int bin = std::min(BIN_COUNT - 1, static_cast<unsigned int>((ctx.centroids[prim][axis] - centroidBounds.min[axis]) * scale));
+                binBounds[bin].grow(ctx.primBounds[prim]);
+                binCounts[bin]++;
+            }
+            // sweep from the right to get the cost of every right side, then from the left
+            float rightArea[BIN_COUNT - 1];
+            unsigned int rightCount[BIN_COUNT - 1];
+            AABB box;
+            unsigned int sum = 0;
+            for (unsigned int i = BIN_COUNT - 1; i > 0; --i) {
+                box.grow(binBounds[i]);
+                sum += binCounts[i];
+                rightArea[i - 1] = box.area();
+                rightCount[i - 1] = sum;
+            }
+            box = AABB();
+            sum = 0;
+            for (unsigned int i = 0; i < BIN_COUNT - 1; ++i) {
+                box.grow(binBounds[i]);
+                sum += binCounts[i];
+                if (sum == 0 || rightCount[i] == 0) continue;
+                float cost = sum * box.area() + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i + 1;
+                }
+            }
+        }
+        if (bestAxis < 0) return; // splitting does not pay off
+
+        // partition primitives by bin
+        float scale = BIN_COUNT / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+        auto middle = std::partition(ctx.primIndices.begin() + first, ctx.primIndices.begin() + first + count, [&](unsigned int prim) {
+            unsigned int bin = std::min(BIN_COUNT - 1, static_cast<unsigned int>((ctx.centroids[prim][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+            return bin < bestSplit;
+        });
+        unsigned int leftCount = middle - (ctx.primIndices.begin() + first);
+        if (leftCount == 0 || leftCount == count) return;
+
+        unsigned int left = ctx.nodes.size();
+        ctx.nodes.emplace_back();
+        ctx.nodes.emplace_back();
+        ctx.nodes[nodeIndex].leftFirst = left;
+        ctx.nodes[nodeIndex].count = 0;
+        subdivide(ctx, left, first, leftCount, depth + 1);
+        subdivide(ctx, left + 1, first + leftCount, count - leftCount, depth + 1);
+    }
+}
+
+void buildBVH(const std::vector<AABB>& primBounds, std::vector<BVHNode>& nodes, std::vector<unsigned int>& primIndices) {
+    nodes.clear();
+    primIndices.resize(primBounds.size());
+    for (unsigned int i = 0; i < primIndices.size(); ++i) primIndices[i] = i;
+
+    BuildContext ctx{primBounds, {}, nodes, primIndices};
+    ctx.centroids.reserve(primBounds.size());
+    for (const AABB& box : primBounds) ctx.centroids.push_back(box.center());
+
+    nodes.reserve(2 * primBounds.size() + 1);
+    nodes.emplace_back();
+    subdivide(ctx, 0, 0, primBounds.size(), 0);
+}
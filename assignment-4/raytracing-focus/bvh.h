@@ -0,0 +1,116 @@
+//
+// Bounding volume hierarchy for the ray tracer.
+//
+
+#ifndef UEBUNG_04_BVH_H
+#define UEBUNG_04_BVH_H
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "vec3.h"
+#include "ray.h"
+
+struct AABB {
+    Vec3f min{std::numeric_limits<float>::max()};
+    Vec3f max{-std::numeric_limits<float>::max()};
+
+    void grow(const Vec3f& p) {
+        for (unsigned int i = 0; i < 3; ++i) {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        }
+    }
+    void grow(const AABB& box) {
+        for (unsigned int i = 0; i < 3; ++i) {
+            min[i] = std::min(min[i], box.min[i]);
+            max[i] = std::max(max[i], box.max[i]);
+        }
+    }
+    Vec3f center() const { return 0.5f * (min + max); }
+    float area() const {
+        Vec3f e = max - min;
+        if (e.x() < 0.f) return 0.f;
+        return 2.f * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+    }
+};
+
+// Node of a flat BVH. Children are stored next to each other, so a node only needs the index of the left one.
+// Contains no pointers, the node array can be written to disk and used directly after mapping it back.
+struct BVHNode {
+    float boundsMin[3];
+    unsigned int leftFirst; // inner node: index of left child (right child is leftFirst + 1), leaf: first entry in primIndices
+    float boundsMax[3];
+    unsigned int count;     // number of primitives in a leaf, 0 for inner nodes
+
+    bool isLeaf() const { return count > 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode is part of the snapshot format");
+
+// Builds a BVH with binned SAH over the given primitive bounds. primIndices maps leaf entries to primitive indices.
+void buildBVH(const std::vector<AABB>& primBounds, std::vector<BVHNode>& nodes, std::vector<unsigned int>& primIndices);
+
+// Slab test against the bounds of a node. Returns the entry distance, or infinity if the ray misses or enters after tMax.
+inline float intersectNode(const BVHNode& node, const Vec3f& origin, const Vec3f& invDir, float tMax) {
+    float tNear = 0.f, tFar = tMax;
+    for (unsigned int i = 0; i < 3; ++i) {
+        float t0 = (node.boundsMin[i] - origin[i]) * invDir[i];
+        float t1 = (node.boundsMax[i] - origin[i]) * invDir[i];
+        if (t0 > t1) std::swap(t0, t1);
+        tNear = t0 > tNear ? t0 : tNear;
+        tFar = t1 < tFar ? t1 : tFar;
+    }
+    return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+}
+
+// Walks the BVH front to back. intersectPrim(primIndex, tMax) tests one primitive and shrinks tMax on a hit.
+// With anyHit the traversal stops at the first hit (shadow rays). Returns true if something was hit.
+template<typename IntersectPrim>
+bool traverseBVH(const BVHNode* nodes, const unsigned int* primIndices, const Ray<float>& ray, float& tMax,
+                 bool anyHit, IntersectPrim intersectPrim, unsigned int* nodeVisits = nullptr) {
+    const Vec3f invDir(1.f / ray.d.x(), 1.f / ray.d.y(), 1.f / ray.d.z());
+    unsigned int stack[64];
+    unsigned int stackSize = 0;
+    unsigned int current = 0;
+    bool hit = false;
+    if (intersectNode(nodes[0], ray.o, invDir, tMax) == std::numeric_limits<float>::infinity()) return false;
+    while (true) {
+        const BVHNode& node = nodes[current];
+        if (nodeVisits) ++*nodeVisits;
+        if (node.isLeaf()) {
+            for (unsigned int i = 0; i < node.count; ++i) {
+                if (intersectPrim(primIndices[node.leftFirst + i], tMax)) {
+                    hit = true;
+                    if (anyHit) return true;
+                }
+            }
+        } else {
+            // visit the nearer child first, remember the other one
+            unsigned int left = node.leftFirst, right = node.leftFirst + 1;
+            float tLeft = intersectNode(nodes[left], ray.o, invDir, tMax);
+            float tRight = intersectNode(nodes[right], ray.o, invDir, tMax);
+            if (tLeft > tRight) {
+                std::swap(tLeft, tRight);
+                std::swap(left, right);
+            }
+            if (tLeft != std::numeric_limits<float>::infinity()) {
+                if (tRight != std::numeric_limits<float>::infinity()) stack[stackSize++] = right;
+                current = left;
+                continue;
+            }
+        }
+        // pop until a node is found that is still in front of the closest hit
+        bool found = false;
+        while (stackSize > 0) {
+            current = stack[--stackSize];
+            if (intersectNode(nodes[current], ray.o, invDir, tMax) != std::numeric_limits<float>::infinity()) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return hit;
+    }
+}
+
+#endif //UEBUNG_04_BVH_H
@@ -23,6 +23,8 @@ class ClipPlane {
 
 public:
 
+  ClipPlane() : planeNormal(0.f, 0.f, 0.f), planeDistance(0.f) {}
+
   // constructor which normalizes the plane = ax + by + cz + d = 0
   ClipPlane(float a, float b, float c, float d) {
     planeNormal = Vec3f(a,b,c);
@@ -31,10 +33,13 @@ public:
     planeDistance = d / l;
   }
 
-  float evaluatePoint(Vec3f p) {
+  float evaluatePoint(Vec3f p) const {
     return planeNormal*p + planeDistance;
   }
 
+  const Vec3f& getNormal() const { return planeNormal; }
+  float getDistance() const { return planeDistance; }
+
 };
 
 #endif
@@ -0,0 +1,84 @@
+//
+// Scene shown by the OpenGL view, also rendered by the headless ray tracer.
+//
+
+#include "defaultscene.h"
+
+void loadDefaultScene(QOpenGLFunctions_3_3_Core* f, std::vector<TriangleMesh>& meshes, std::vector<MipMappedTexture>& textures, std::vector<SceneObject>& objects) {
+    //load meshes
+    meshes.emplace_back(f);
+    meshes[0].loadOFF("../uebung-4/Models/doppeldecker.off", f != nullptr);
+    meshes.emplace_back(f);
+    meshes[1].loadOFF("../uebung-4/Models/cube.off", f != nullptr);
+
+    //load textures for the ray tracer. Pointers into the vector are handed out, so it must not grow afterwards.
+    textures.resize(2);
+    textures[0].load("../uebung-4/Textures/rough_block_wall_diff_1k.jpg");
+    textures[1].load("../uebung-4/Textures/TEST_GRID.bmp");
+
+    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f), 
+        Vec3f(0.6f, 0.3f, 0.3f), 
+        Vec3f(0.4f, 0.4f, 0.4f), 
+        100.0f, 0.2f, 
+        meshes[0],
+        Vec3f(-4.0f, 0.0f, 0.0f),
+        Vec3f(1.0f, 1.0f, 1.0f), 
+        0.0f, 1.5f);
+
+    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
+        Vec3f(0.6f, 0.3f, 0.3f),
+        Vec3f(0.4f, 0.4f, 0.4f),
+        100.f, 0.2f,
+        meshes[0]);
+
+    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
+        Vec3f(0.6f, 0.3f, 0.3f),
+        Vec3f(0.4f, 0.4f, 0.4f),
+        100.f, 0.1f,
+        meshes[0],
+        Vec3f(2.0f, 0.0f, 0.0f));
+    objects.back().diffuseTexture = &textures[0];
+
+    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
+        Vec3f(0.6f, 0.3f, 0.3f),
+        Vec3f(0.4f, 0.4f, 0.4f),
+        100.f, 0.4f,
+        meshes[0],
+        Vec3f(-2.0f, 0.0f, 0.0f));
+    objects.back().diffuseTexture = &textures[1];
+
+    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
+        Vec3f(0.6f, 0.3f, 0.3f),
+        Vec3f(0.4f, 0.4f, 0.4f),
+        100.f, 0.3f,
+        meshes[1],
+        Vec3f(0.0f, -5.0f, 0.0f),
+        Vec3f(10.f, 0.2f, 10.f));
+    objects.back().shape = SceneObject::Shape::Box;
+
+    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
+        Vec3f(0.6f, 0.3f, 0.3f),
+        Vec3f(0.4f, 0.4f, 0.4f),
+        100.f, 0.f,
+        meshes[1],
+        Vec3f(0.0f, 0.0f, 10.0f),
+        Vec3f(10.f, 10.0f, 0.2f));
+    objects.back().shape = SceneObject::Shape::Box;
+
+    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
+        Vec3f(0.6f, 0.3f, 0.3f),
+        Vec3f(0.4f, 0.4f, 0.4f),
+        100.f, 0.1f,
+        meshes[1],
+        Vec3f(0.0f, -4.0f, 2.0f));
+    objects.back().shape = SceneObject::Shape::Box;
+}
+
+Light createDefaultLight() {
+    Light defaultLight;
+    defaultLight.position = Vec3f(0.0f, 5.0f, 7.0f);
+    defaultLight.lightIntensity = 1.f;
+    defaultLight.ambientIntensity = 0.4f;
+    defaultLight.radius = 1.f; // same as the sphere drawn by OpenGLView::drawLight
+    return defaultLight;
+}
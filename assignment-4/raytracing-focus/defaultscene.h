@@ -0,0 +1,21 @@
+//
+// Scene shown by the OpenGL view, also rendered by the headless ray tracer.
+//
+
+#ifndef UEBUNG_04_DEFAULTSCENE_H
+#define UEBUNG_04_DEFAULTSCENE_H
+
+#include <vector>
+
+#include "light.h"
+#include "texture.h"
+#include "trianglemesh.h"
+#include "sceneobject.h"
+
+// Loads meshes and textures and creates the scene objects. Objects keep references into meshes and textures,
+// so neither vector may grow afterwards. Without OpenGL functions (f == nullptr) no VBOs are created.
+void loadDefaultScene(QOpenGLFunctions_3_3_Core* f, std::vector<TriangleMesh>& meshes, std::vector<MipMappedTexture>& textures, std::vector<SceneObject>& objects);
+
+Light createDefaultLight();
+
+#endif //UEBUNG_04_DEFAULTSCENE_H
@@ -0,0 +1,119 @@
+//
+// Edge-avoiding à-trous wavelet filter for noisy path traced images, guided by the features of the primary hits.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "denoiser.h"
+
+namespace {
+    // below this reflectance a channel is filtered as it is, dividing by it would only amplify the noise
+    const float MIN_ALBEDO = 0.01f;
+    const float KERNEL[5] = {1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+
+    // (1 + x/16)^-16, close to exp(-x) for x >= 0. std::exp would keep the filter loop from being vectorized unless
+    // the whole program is compiled with -ffast-math.
+    inline float falloff(float x) {
+        float t = 1.f + x * (1.f / 16.f);
+        t *= t;
+        t *= t;
+        t *= t;
+        t *= t;
+        return 1.f / t;
+    }
+}
+
+void GuideBuffers::reset(unsigned int width, unsigned int height) {
+    normals.assign(width * height, Vec3f(0.f));
+    albedo.assign(width * height, Vec3f(0.f));
+    depth.assign(width * height, 0.f);
+}
+
+// All buffers are split into one array per channel, so the loop over a row runs over plain floats and the compiler
+// can vectorize it. The rows are distributed over the threads.
+std::vector<Vec3f> Denoiser::denoise(const std::vector<Vec3f>& color, const GuideBuffers& guides, unsigned int width, unsigned int height) const {
+    const size_t size = width * height;
+    std::vector<float> channels[3], filtered[3], albedo[3], normal[3];
+    for (unsigned int c = 0; c < 3; ++c) {
+        channels[c].resize(size);
+        filtered[c].resize(size);
+        albedo[c].resize(size);
+        normal[c].resize(size);
+    }
+    std::vector<float> valid(size);
+    const std::vector<float>& depth = guides.depth;
+    for (size_t i = 0; i < size; ++i) {
+        valid[i] = depth[i] > 0.f ? 1.f : 0.f;
+        for (unsigned int c = 0; c < 3; ++c) {
+            albedo[c][i] = guides.albedo[i][c] >= MIN_ALBEDO ? guides.albedo[i][c] : 1.f;
+            channels[c][i] = color[i][c] / albedo[c][i];
+            normal[c][i] = guides.normals[i][c];
+        }
+    }
+
+    const float invNormal = 1.f / (normalSigma * normalSigma);
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        const int step = 1 << iteration;
+        const float sigma = colorSigma / static_cast<float>(step);
+        const float invColor = 1.f / (sigma * sigma);
+        #pragma omp parallel
+        {
+            std::vector<float> sum[3], weightSum(width), invDepth(width);
+            for (unsigned int c = 0; c < 3; ++c) sum[c].resize(width);
+            #pragma omp for schedule(static)
+            for (int y = 0; y < static_cast<int>(height); y++) {
+                const size_t row = static_cast<size_t>(y) * width;
+                for (unsigned int x = 0; x < width; ++x) {
+                    invDepth[x] = 1.f / (depthSigma * step * std::max(depth[row + x], 1e-3f));
+                    weightSum[x] = sum[0][x] = sum[1][x] = sum[2][x] = 0.f;
+                }
+                for (int j = -2; j <= 2; ++j) {
+                    const int qy = y + j * step;
+                    if (qy < 0 || qy >= static_cast<int>(height)) continue;
+                    for (int i = -2; i <= 2; ++i) {
+                        const int dx = i * step;
+                        const int begin = std::max(0, -dx), end = std::min(static_cast<int>(width), static_cast<int>(width) - dx);
+                        const float k = KERNEL[i + 2] * KERNEL[j + 2];
+                        const float* r = channels[0].data() + row, *g = channels[1].data() + row, *b = channels[2].data() + row;
+                        const float* nx = normal[0].data() + row, *ny = normal[1].data() + row, *nz = normal[2].data() + row;
+                        const float* z = depth.data() + row;
+                        const size_t tapRow = static_cast<size_t>(qy) * width + dx;
+                        const float* qr = channels[0].data() + tapRow, *qg = channels[1].data() + tapRow, *qb = channels[2].data() + tapRow;
+                        const float* qnx = normal[0].data() + tapRow, *qny = normal[1].data() + tapRow, *qnz = normal[2].data() + tapRow;
+                        const float* qz = depth.data() + tapRow, *qValid = valid.data() + tapRow;
+                        const float* inv = invDepth.data();
+                        float* sr = sum[0].data(), *sg = sum[1].data(), *sb = sum[2].data(), *ws = weightSum.data();
+                        #pragma omp simd
+                        for (int x = begin; x < end; ++x) {
+                            const float dr = r[x] - qr[x], dg = g[x] - qg[x], db = b[x] - qb[x];
+                            const float dnx = nx[x] - qnx[x], dny = ny[x] - qny[x], dnz = nz[x] - qnz[x];
+                            const float exponent = (dr * dr + dg * dg + db * db) * invColor
+                                                   + (dnx * dnx + dny * dny + dnz * dnz) * invNormal
+                                                   + std::abs(z[x] - qz[x]) * inv[x];
+                            const float weight = k * qValid[x] * falloff(exponent);
+                            ws[x] += weight;
+                            sr[x] += weight * qr[x];
+                            sg[x] += weight * qg[x];
+                            sb[x] += weight * qb[x];
+                        }
+                    }
+                }
+                for (unsigned int x = 0; x < width; ++x) {
+                    // the background and the light are not filtered, the center tap always has weight > 0 otherwise
+                    const bool keep = valid[row + x] == 0.f;
+                    for (unsigned int c = 0; c < 3; ++c) {
+                        filtered[c][row + x] = keep ? channels[c][row + x] : sum[c][x] / weightSum[x];
+                    }
+                }
+            }
+        }
+        for (unsigned int c = 0; c < 3; ++c) channels[c].swap(filtered[c]);
+    }
+
+    std::vector<Vec3f> result(size);
+    for (size_t i = 0; i < size; ++i) {
+        result[i] = Vec3f(channels[0][i] * albedo[0][i], channels[1][i] * albedo[1][i], channels[2][i] * albedo[2][i]);
+    }
+    return result;
+}
@@ -0,0 +1,36 @@
+//
+// Edge-avoiding à-trous wavelet filter for noisy path traced images, guided by the features of the primary hits.
+//
+
+#ifndef UEBUNG_04_DENOISER_H
+#define UEBUNG_04_DENOISER_H
+
+#include <vector>
+
+#include "vec3.h"
+
+// Features of the surface seen through the center of each pixel. They are free of noise, so they tell the filter
+// where the edges of the image are.
+struct GuideBuffers {
+    std::vector<Vec3f> normals; // shading normal, zero where nothing was hit
+    std::vector<Vec3f> albedo;  // reflectance, divided out before filtering so textures stay sharp
+    std::vector<float> depth;   // distance along the camera ray, 0 where nothing was hit
+
+    void reset(unsigned int width, unsigned int height);
+};
+
+// Dammertz et al. 2010: a 5x5 B3 spline kernel is applied several times with growing gaps between its taps. Each
+// tap is weighted by how much its color, normal and depth differ from the center pixel.
+class Denoiser {
+public:
+    std::vector<Vec3f> denoise(const std::vector<Vec3f>& color, const GuideBuffers& guides, unsigned int width, unsigned int height) const;
+
+    int iterations = 5;
+    // the color tolerance halves with every iteration, the filtered image gets smoother with each one
+    float colorSigma = 2.f;
+    float normalSigma = 0.3f;
+    // relative to the depth of the center pixel and to the distance of the tap
+    float depthSigma = 0.02f;
+};
+
+#endif //UEBUNG_04_DENOISER_H
@@ -0,0 +1,67 @@
+//
+// View frustum as six planes, extracted once per frame and tested against boxes by center and extent.
+//
+
+#ifndef UEBUNG_04_FRUSTUM_H
+#define UEBUNG_04_FRUSTUM_H
+
+#include <cmath>
+
+#include <QMatrix4x4>
+
+#include "vec3.h"
+#include "clipplane.h"
+
+class Frustum {
+public:
+    static const unsigned int PLANE_COUNT = 6;
+    // a bit per plane that still has to be tested
+    static const unsigned int ALL_PLANES = (1u << PLANE_COUNT) - 1;
+
+    enum class Result { Outside, Intersecting, Inside };
+
+    Frustum() = default;
+
+    // Planes of the clip volume of a view projection matrix (Gribb and Hartmann), in the space the matrix maps from:
+    // with the projection times the camera matrix in world space, with a model view projection in model space.
+    // The normals point inside.
+    explicit Frustum(const QMatrix4x4& matrix) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            planes[2 * axis] = ClipPlane(matrix(3, 0) + matrix(axis, 0), matrix(3, 1) + matrix(axis, 1),
+                                         matrix(3, 2) + matrix(axis, 2), matrix(3, 3) + matrix(axis, 3));
+            planes[2 * axis + 1] = ClipPlane(matrix(3, 0) - matrix(axis, 0), matrix(3, 1) - matrix(axis, 1),
+                                             matrix(3, 2) - matrix(axis, 2), matrix(3, 3) - matrix(axis, 3));
+        }
+    }
+
+    // Tests the box against the planes in mask and removes those the box is completely inside of, so the children
+    // of the box skip them. firstPlane is tested first, a rejecting plane becomes the next firstPlane: a box that was
+    // outside in the last frame is most likely outside of the same plane again.
+    Result testBox(const Vec3f& center, const Vec3f& extent, unsigned int& mask, unsigned int& firstPlane) const {
+        for (unsigned int k = 0; k < PLANE_COUNT; ++k) {
+            const unsigned int plane = (firstPlane + k) % PLANE_COUNT;
+            if (!(mask & (1u << plane))) continue;
+            const Vec3f& normal = planes[plane].getNormal();
+            // distance of the center and half the extent of the box along the normal
+            const float distance = normal * center + planes[plane].getDistance();
+            const float radius = std::abs(normal.x()) * extent.x() + std::abs(normal.y()) * extent.y() + std::abs(normal.z()) * extent.z();
+            if (distance + radius < 0.f) {
+                firstPlane = plane;
+                return Result::Outside;
+            }
+            if (distance - radius >= 0.f) mask &= ~(1u << plane);
+        }
+        return mask == 0 ? Result::Inside : Result::Intersecting;
+    }
+
+    bool isBoxVisible(const Vec3f& center, const Vec3f& extent) const {
+        unsigned int mask = ALL_PLANES, firstPlane = 0;
+        return testBox(center, extent, mask, firstPlane) != Result::Outside;
+    }
+
+private:
+    // left, right, bottom, top, near, far
+    ClipPlane planes[PLANE_COUNT];
+};
+
+#endif //UEBUNG_04_FRUSTUM_H
@@ -0,0 +1,127 @@
+//
+// Vertex and index megabuffer: all meshes of one vertex format share a vertex buffer, an index buffer and the vertex
+// array that binds them, every mesh is a range in these buffers.
+//
+
+#include <algorithm>
+#include <iterator>
+
+#include "geometrybuffer.h"
+#include "shader.h"
+
+namespace {
+    // first size of a buffer, afterwards it doubles so that loading many meshes copies little
+    const size_t MIN_CAPACITY = 1 << 16;
+}
+
+GeometryBuffer::GeometryBuffer(GLsizei stride, const std::vector<VertexAttribute>& attributes)
+    : stride(stride), attributes(attributes), vertices(stride), indices(sizeof(GLuint)) {
+}
+
+GeometryBuffer& GeometryBuffer::meshes() {
+    static GeometryBuffer buffer(sizeof(MeshVertex), {
+        {POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, position)},
+        {NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, normal)},
+        {TEXCOORD_LOCATION, 2, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, texCoord)},
+        {OCCLUSION_LOCATION, 1, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, occlusion)},
+    });
+    return buffer;
+}
+
+size_t GeometryBuffer::Arena::take(size_t count) {
+    used += count;
+    for (auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block) {
+        if (block->second < count) continue;
+        const size_t first = block->first, rest = block->second - count;
+        freeBlocks.erase(block);
+        if (rest > 0) freeBlocks[first + count] = rest;
+        return first;
+    }
+    end += count;
+    return end - count;
+}
+
+void GeometryBuffer::Arena::give(size_t first, size_t count) {
+    used -= count;
+    auto next = freeBlocks.lower_bound(first);
+    if (next != freeBlocks.end() && first + count == next->first) {
+        count += next->second;
+        next = freeBlocks.erase(next);
+    }
+    if (next != freeBlocks.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == first) {
+            first = previous->first;
+            count += previous->second;
+            freeBlocks.erase(previous);
+        }
+    }
+    // a block at the end only shortens the used part
+    if (first + count == end) end = first;
+    else freeBlocks[first] = count;
+}
+
+bool GeometryBuffer::reserve(QOpenGLFunctions_3_3_Core* f, Arena& arena) {
+    if (arena.end <= arena.capacity) return false;
+    const size_t capacity = std::max(arena.end, std::max(2 * arena.capacity, MIN_CAPACITY));
+    GLuint buffer = 0;
+    f->glGenBuffers(1, &buffer);
+    f->glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    f->glBufferData(GL_COPY_WRITE_BUFFER, capacity * arena.elementSize, nullptr, GL_STATIC_DRAW);
+    // the ranges keep their positions, so the old content moves to the start of the new buffer
+    if (arena.buffer != 0) {
+        f->glBindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+        f->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, arena.capacity * arena.elementSize);
+        f->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        f->glDeleteBuffers(1, &arena.buffer);
+    }
+    f->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    arena.buffer = buffer;
+    arena.capacity = capacity;
+    return true;
+}
+
+void GeometryBuffer::upload(QOpenGLFunctions_3_3_Core* f, const Arena& arena, size_t first, const void* data, size_t count) {
+    f->glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+    f->glBufferSubData(GL_COPY_WRITE_BUFFER, first * arena.elementSize, count * arena.elementSize, data);
+    f->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryBuffer::bindBuffers(QOpenGLFunctions_3_3_Core* f) {
+    f->glBindVertexArray(VAO);
+    f->glBindBuffer(GL_ARRAY_BUFFER, vertices.buffer);
+    for (const VertexAttribute& attribute : attributes) {
+        f->glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, stride, reinterpret_cast<const void*>(attribute.offset));
+        f->glEnableVertexAttribArray(attribute.location);
+    }
+    // the element buffer binding is part of the vertex array
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer);
+    f->glBindVertexArray(0);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GeometryRange GeometryBuffer::allocate(QOpenGLFunctions_3_3_Core* f, const void* vertexData, GLsizei vertexCount, const GLuint* indexData, GLsizei indexCount) {
+    if (!f || vertexCount <= 0 || indexCount <= 0) return GeometryRange();
+    if (VAO == 0) f->glGenVertexArrays(1, &VAO);
+
+    const size_t firstVertex = vertices.take(vertexCount), firstIndex = indices.take(indexCount);
+    const bool verticesMoved = reserve(f, vertices);
+    const bool indicesMoved = reserve(f, indices);
+    if (verticesMoved || indicesMoved) bindBuffers(f);
+    upload(f, vertices, firstVertex, vertexData, vertexCount);
+    upload(f, indices, firstIndex, indexData, indexCount);
+
+    GeometryRange range;
+    range.vertexArray = VAO;
+    range.baseVertex = static_cast<GLint>(firstVertex);
+    range.vertexCount = vertexCount;
+    range.firstIndex = static_cast<GLuint>(firstIndex);
+    range.indexCount = indexCount;
+    return range;
+}
+
+void GeometryBuffer::free(const GeometryRange& range) {
+    if (!range.isValid() || range.vertexArray != VAO) return;
+    vertices.give(range.baseVertex, range.vertexCount);
+    indices.give(range.firstIndex, range.indexCount);
+}
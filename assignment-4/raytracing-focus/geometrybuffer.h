@@ -0,0 +1,93 @@
+//
+// Vertex and index megabuffer: all meshes of one vertex format share a vertex buffer, an index buffer and the vertex
+// array that binds them, every mesh is a range in these buffers.
+//
+
+#ifndef UEBUNG_04_GEOMETRYBUFFER_H
+#define UEBUNG_04_GEOMETRYBUFFER_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include <QOpenGLFunctions_3_3_Core>
+
+// Interleaved vertex of the triangle meshes. The occlusion is 1 in a mesh and the baked ambient occlusion in the
+// copies that scene objects keep of their mesh.
+struct MeshVertex {
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLfloat texCoord[2];
+    GLfloat occlusion;
+};
+
+struct VertexAttribute {
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+// Part of a GeometryBuffer. The indices count from the first vertex of the range, draws pass baseVertex.
+struct GeometryRange {
+    GLuint vertexArray{0}; // 0 while nothing is allocated
+    GLint baseVertex{0};
+    GLsizei vertexCount{0};
+    GLuint firstIndex{0};
+    GLsizei indexCount{0};
+
+    bool isValid() const { return vertexArray != 0; }
+    // position of the first index in the element buffer, as glDrawElements expects it
+    const void* indexOffset() const { return reinterpret_cast<const void*>(static_cast<size_t>(firstIndex) * sizeof(GLuint)); }
+};
+
+class GeometryBuffer {
+public:
+    GeometryBuffer(GLsizei stride, const std::vector<VertexAttribute>& attributes);
+    GeometryBuffer(const GeometryBuffer& other) = delete;
+    GeometryBuffer& operator= (const GeometryBuffer& other) = delete;
+
+    // the buffer of all meshes with MeshVertex data
+    static GeometryBuffer& meshes();
+
+    // Copies vertices (stride bytes each) and indices into free space of the buffers, which grow if there is none.
+    // The range is invalid if there was no data.
+    GeometryRange allocate(QOpenGLFunctions_3_3_Core* f, const void* vertexData, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount);
+    // gives the space of the range back, later allocations overwrite it
+    void free(const GeometryRange& range);
+
+    GLuint getVAO() const { return VAO; }
+    // bytes occupied by ranges and bytes reserved on the GPU
+    size_t getUsedBytes() const { return vertices.used * vertices.elementSize + indices.used * indices.elementSize; }
+    size_t getCapacityBytes() const { return vertices.capacity * vertices.elementSize + indices.capacity * indices.elementSize; }
+
+private:
+    // first fit allocator over the elements of one buffer, neighbouring free blocks are merged
+    struct Arena {
+        GLuint buffer{0};
+        size_t elementSize;
+        size_t capacity{0}; // elements the buffer can hold
+        size_t end{0};      // elements up to the last allocated one
+        size_t used{0};
+        std::map<size_t, size_t> freeBlocks; // first element -> number of elements, all below end
+
+        explicit Arena(size_t elementSize) : elementSize(elementSize) {}
+        // first element of the new block, which may reach beyond the capacity
+        size_t take(size_t count);
+        void give(size_t first, size_t count);
+    };
+
+    // grows the buffer of the arena to at least its end, returns whether it was replaced
+    bool reserve(QOpenGLFunctions_3_3_Core* f, Arena& arena);
+    void upload(QOpenGLFunctions_3_3_Core* f, const Arena& arena, size_t first, const void* data, size_t count);
+    // points the vertex array to the current buffers
+    void bindBuffers(QOpenGLFunctions_3_3_Core* f);
+
+    GLsizei stride;
+    std::vector<VertexAttribute> attributes;
+    GLuint VAO{0};
+    Arena vertices, indices;
+};
+
+#endif //UEBUNG_04_GEOMETRYBUFFER_H
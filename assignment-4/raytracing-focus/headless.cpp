@@ -0,0 +1,235 @@
+// ========================================================================= //
+// Content: Ray tracer without window. Renders the default scene or a scene  //
+//          snapshot into a PPM image and can write scene snapshots. The     //
+//          path tracer can be benchmarked against a reference image, the    //
+//          work of the ray tracer per pixel can be written as well. Meshes  //
+//          can be stored in an order optimized for the vertex cache.        //
+// ========================================================================= //
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QStringList>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "defaultscene.h"
+#include "pathtracer.h"
+#include "pvs.h"
+#include "rayscene.h"
+#include "raytracer.h"
+#include "utilities.h"
+
+// parses "x,y,z", returns false if the string has another format
+static bool parseVector(const QString& text, QVector3D& result) {
+    const QStringList parts = text.split(',');
+    if (parts.size() != 3) return false;
+    bool ok[3];
+    result = QVector3D(parts[0].toFloat(&ok[0]), parts[1].toFloat(&ok[1]), parts[2].toFloat(&ok[2]));
+    return ok[0] && ok[1] && ok[2];
+}
+
+// writes a binary PPM. The image rows are stored bottom to top, PPM expects top to bottom.
+static bool writePPM(const QString& fileName, const std::vector<Vec3f>& image, unsigned int width, unsigned int height) {
+    std::ofstream file(fileName.toStdString(), std::ios::binary);
+    if (!file) return false;
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (unsigned int y = height; y-- > 0;) {
+        for (unsigned int x = 0; x < width; ++x) {
+            const Vec3f& color = image[y * width + x];
+            for (unsigned int c = 0; c < 3; ++c) {
+                file.put(static_cast<char>(std::max(0, std::min(static_cast<int>(255.f * color[c]), 255))));
+            }
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+// one line per pixel, rows from top to bottom like in the image
+static bool writeCostCSV(const QString& fileName, const std::vector<PixelCost>& costs, unsigned int width, unsigned int height) {
+    std::ofstream file(fileName.toStdString());
+    if (!file) return false;
+    file << "x,y,rays,node_visits,intersection_tests,cycles\n";
+    for (unsigned int y = height; y-- > 0;) {
+        for (unsigned int x = 0; x < width; ++x) {
+            const PixelCost& cost = costs[y * width + x];
+            file << x << "," << height - 1 - y << "," << cost.traversal.rays << "," << cost.traversal.nodeVisits << ","
+                 << cost.traversal.intersectionTests << "," << cost.cycles << "\n";
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+// root mean square error over all pixels and color channels
+static float rootMeanSquareError(const std::vector<Vec3f>& image, const std::vector<Vec3f>& reference) {
+    double sum = 0.0;
+    for (size_t i = 0; i < image.size(); ++i) {
+        Vec3f difference = image[i] - reference[i];
+        sum += difference * difference;
+    }
+    return static_cast<float>(std::sqrt(sum / (3.0 * image.size())));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders the scene with the ray tracer without opening a window.");
+    parser.addHelpOption();
+    QCommandLineOption snapshotOption({"s", "snapshot"}, "Render the scene snapshot <file> instead of the default scene.", "file");
+    QCommandLineOption verifySnapshotOption("verify-snapshot", "Check every index of the snapshot when opening it, which reads the whole file.");
+    QCommandLineOption writeSnapshotOption({"w", "write-snapshot"}, "Write the scene as snapshot to <file>.", "file");
+    QCommandLineOption outputOption({"o", "output"}, "Write the image to <file>.", "file", "raytraced.ppm");
+    QCommandLineOption noRenderOption("no-render", "Only convert the scene, do not render an image.");
+    QCommandLineOption sizeOption("size", "Image size as <width>x<height>.", "size", "640x480");
+    QCommandLineOption cameraOption("camera", "Camera position as <x,y,z>.", "position", "0,0,-10");
+    QCommandLineOption directionOption("direction", "View direction as <x,y,z>.", "direction", "0,0,1");
+    QCommandLineOption pathTraceOption("path-trace", "Render with the path tracer instead of the Whitted ray tracer.");
+    QCommandLineOption samplesOption("spp", "Samples per pixel of the path tracer.", "samples", "64");
+    QCommandLineOption benchmarkOption("benchmark", "Report the error of the path tracer against a reference image over time.");
+    QCommandLineOption referenceSamplesOption("reference-spp", "Samples per pixel of the benchmark reference.", "samples", "1024");
+    QCommandLineOption heatmapOption("heatmap", "Write a heatmap of <metric> (rays, nodes, tests or cycles) instead of the image.", "metric");
+    QCommandLineOption costOption("cost", "Write the work per pixel of the ray tracer as CSV to <file>.", "file");
+    QCommandLineOption writePVSOption("write-pvs", "Bake the potentially visible set of the scene and write it to <file>.", "file");
+    QCommandLineOption pvsCellsOption("pvs-cells", "Cells along the longest axis of the potentially visible set.", "cells", "16");
+    QCommandLineOption denoiseOption("denoise", "Denoise the path traced image, the benchmark reports both errors.");
+    QCommandLineOption optimizeMeshOption("optimize-mesh", "Reorder the OFF mesh <file> for the vertex cache and against overdraw, then exit.", "file");
+    QCommandLineOption meshOutputOption("mesh-output", "Write the optimized mesh to <file>.", "file", "optimized.off");
+    parser.addOptions({snapshotOption, verifySnapshotOption, writeSnapshotOption, outputOption, noRenderOption, sizeOption, cameraOption, directionOption,
+                       pathTraceOption, samplesOption, benchmarkOption, referenceSamplesOption, denoiseOption, heatmapOption, costOption,
+                       writePVSOption, pvsCellsOption, optimizeMeshOption, meshOutputOption});
+    parser.process(a);
+
+    // loadOFF optimizes the order and reports the ACMR, the file keeps it so that loading it again finds little to do
+    if (parser.isSet(optimizeMeshOption)) {
+        TriangleMesh mesh;
+        mesh.loadOFF(parser.value(optimizeMeshOption).toStdString().c_str(), false);
+        if (mesh.getNumTriangles() == 0 || !mesh.saveOFF(parser.value(meshOutputOption).toStdString().c_str())) return 1;
+        std::cout << "wrote " << parser.value(meshOutputOption).toStdString() << std::endl;
+        return 0;
+    }
+
+    const QStringList size = parser.value(sizeOption).split('x');
+    unsigned int width = size.size() == 2 ? size[0].toUInt() : 0, height = size.size() == 2 ? size[1].toUInt() : 0;
+    QVector3D cameraPos, cameraDir;
+    if (width == 0 || height == 0 || !parseVector(parser.value(cameraOption), cameraPos) || !parseVector(parser.value(directionOption), cameraDir)) {
+        std::cout << "Invalid size, camera position or direction." << std::endl;
+        return 1;
+    }
+    // only the Whitted ray tracer records the cost per pixel
+    if ((parser.isSet(pathTraceOption) || parser.isSet(benchmarkOption)) && (parser.isSet(heatmapOption) || parser.isSet(costOption))) {
+        std::cout << "--heatmap and --cost need the Whitted ray tracer, they can not be combined with --path-trace or --benchmark." << std::endl;
+        return 1;
+    }
+
+    // the scene objects reference meshes and textures, so these have to outlive the RayScene build
+    std::vector<TriangleMesh> meshes;
+    std::vector<MipMappedTexture> textures;
+    std::vector<SceneObject> objects;
+    RayScene scene;
+    QElapsedTimer timer;
+    timer.start();
+    if (parser.isSet(snapshotOption)) {
+        if (!scene.open(parser.value(snapshotOption), parser.isSet(verifySnapshotOption))) return 1;
+        std::cout << "opened snapshot in " << timer.elapsed() << " ms" << std::endl;
+    } else {
+        loadDefaultScene(nullptr, meshes, textures, objects);
+        scene.build(objects);
+        std::cout << "loaded scene and built BVH in " << timer.elapsed() << " ms" << std::endl;
+    }
+    std::cout << scene.getNumObjects() << " objects, " << scene.getNumTriangles() << " triangles, " << scene.getNumPrimitives() << " analytic shapes, "
+              << scene.getNumBVHNodes() << " BVH nodes" << std::endl;
+
+    if (parser.isSet(writeSnapshotOption)) {
+        if (!scene.save(parser.value(writeSnapshotOption))) return 1;
+        std::cout << "wrote snapshot " << parser.value(writeSnapshotOption).toStdString() << std::endl;
+    }
+    if (parser.isSet(writePVSOption)) {
+        PotentiallyVisibleSet pvs;
+        timer.restart();
+        pvs.bake(scene, PotentiallyVisibleSet::defaultBounds(scene), std::max(1u, parser.value(pvsCellsOption).toUInt()));
+        std::cout << "baked PVS with " << pvs.getNumCells() << " cells in " << timer.elapsed() << " ms, "
+                  << pvs.averageVisible() << " of " << pvs.getNumObjects() << " objects visible per cell" << std::endl;
+        if (!pvs.save(parser.value(writePVSOption))) return 1;
+        std::cout << "wrote PVS " << parser.value(writePVSOption).toStdString() << std::endl;
+    }
+    if (parser.isSet(noRenderOption)) return 0;
+
+    // same camera model as the OpenGL view
+    QMatrix4x4 projection, modelView;
+    projection.perspective(65.f, static_cast<float>(width) / static_cast<float>(height), 0.5f, 10000.f);
+    modelView.lookAt(cameraPos, cameraPos + cameraDir, QVector3D(0.f, 1.f, 0.f));
+
+    std::vector<Vec3f> image;
+    if (parser.isSet(benchmarkOption)) {
+        PathTracer pathTracer(scene, createDefaultLight());
+        AccumulationBuffer buffer;
+        buffer.reset(width, height);
+        // the reference uses other random numbers, otherwise its noise would correlate with the measured images
+        pathTracer.seed = 1;
+        timer.restart();
+        pathTracer.render(buffer, projection, modelView, std::max(1u, parser.value(referenceSamplesOption).toUInt()));
+        const std::vector<Vec3f> reference = buffer.average();
+        std::cout << "reference with " << buffer.samples << " samples per pixel in " << timer.elapsed() << " ms" << std::endl;
+
+        // progressive rendering like in the window, the error is measured whenever the sample count doubles
+        const unsigned int samples = std::max(1u, parser.value(samplesOption).toUInt());
+        pathTracer.seed = 0;
+        buffer.reset(width, height);
+        qint64 time = 0;
+        const bool denoise = parser.isSet(denoiseOption);
+        Denoiser denoiser;
+        std::cout << "samples\ttime [ms]\tRMSE" << (denoise ? "\tdenoise [ms]\tRMSE denoised" : "") << std::endl;
+        for (unsigned int next = 1; buffer.samples < samples; next *= 2) {
+            timer.restart();
+            while (buffer.samples < std::min(next, samples)) pathTracer.render(buffer, projection, modelView, 1);
+            time += timer.elapsed();
+            image = buffer.average();
+            std::cout << buffer.samples << "\t" << time << "\t" << rootMeanSquareError(image, reference);
+            if (denoise) {
+                timer.restart();
+                image = denoiser.denoise(image, buffer.guides, width, height);
+                std::cout << "\t" << timer.elapsed() << "\t" << rootMeanSquareError(image, reference);
+            }
+            std::cout << std::endl;
+        }
+    } else if (parser.isSet(pathTraceOption)) {
+        PathTracer pathTracer(scene, createDefaultLight());
+        AccumulationBuffer buffer;
+        buffer.reset(width, height);
+        timer.restart();
+        pathTracer.render(buffer, projection, modelView, std::max(1u, parser.value(samplesOption).toUInt()));
+        std::cout << "path traced " << buffer.samples << " samples per pixel in " << timer.elapsed() << " ms" << std::endl;
+        image = buffer.average();
+        if (parser.isSet(denoiseOption)) image = Denoiser().denoise(image, buffer.guides, width, height);
+    } else {
+        const QStringList metrics = {"rays", "nodes", "tests", "cycles"};
+        const int metric = parser.isSet(heatmapOption) ? metrics.indexOf(parser.value(heatmapOption)) : -1;
+        if (parser.isSet(heatmapOption) && metric < 0) {
+            std::cout << "Unknown heatmap metric " << parser.value(heatmapOption).toStdString() << std::endl;
+            return 1;
+        }
+        RayTracer tracer(scene, createDefaultLight());
+        tracer.recordCost = parser.isSet(heatmapOption) || parser.isSet(costOption);
+        image = tracer.render(width, height, projection, modelView);
+        if (parser.isSet(costOption)) {
+            if (!writeCostCSV(parser.value(costOption), tracer.pixelCosts, width, height)) {
+                std::cout << "Could not write " << parser.value(costOption).toStdString() << std::endl;
+                return 1;
+            }
+            std::cout << "wrote cost per pixel to " << parser.value(costOption).toStdString() << std::endl;
+        }
+        if (metric >= 0) image = RayTracer::costHeatmap(tracer.pixelCosts, static_cast<CostMetric>(metric));
+    }
+    if (!writePPM(parser.value(outputOption), image, width, height)) {
+        std::cout << "Could not write " << parser.value(outputOption).toStdString() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -11,6 +11,7 @@ struct Light {
     Vec3f position;
     float ambientIntensity;
     float lightIntensity;
+    float radius; // only the path tracer treats the light as sphere, everything else as point
 };
 
 #endif //UEBUNG_04_LIGHT_H
@@ -11,6 +11,7 @@
 
 #include <functional>
 
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QMouseEvent>
 
@@ -18,7 +19,11 @@
 #include "./ui_mainwindow.h"
 
 void MainWindow::refreshStatusBarMessage() const {
-    statusBar()->showMessage(tr("FPS: %1, Triangles: %2").arg(fpsCount).arg(triangleCount));
+    QString message = tr("FPS: %1, Triangles: %2, GL-Zustand: %3 gesetzt, %4 übersprungen").arg(fpsCount).arg(triangleCount)
+            .arg(stateChanges).arg(skippedStateChanges);
+    if (occludedCount > 0) message += tr(", verdeckt: %1").arg(occludedCount);
+    if (!pickMessage.isEmpty()) message += tr(", %1").arg(pickMessage);
+    statusBar()->showMessage(message);
 }
 
 void MainWindow::changeTriangleCount(unsigned int triangles)
@@ -33,6 +38,19 @@ void MainWindow::changeFpsCount(unsigned int fps)
     refreshStatusBarMessage();
 }
 
+void MainWindow::changeStateChangeCount(unsigned int issued, unsigned int skipped)
+{
+    stateChanges = issued;
+    skippedStateChanges = skipped;
+    refreshStatusBarMessage();
+}
+
+void MainWindow::changeOccludedCount(unsigned int occluded)
+{
+    occludedCount = occluded;
+    refreshStatusBarMessage();
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -44,9 +62,23 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->shaderComboBox, &QComboBox::currentIndexChanged, ui->openGLWidget, &OpenGLView::changeShader);
     connect(ui->loadNewShaderButton, &QPushButton::clicked, this, &MainWindow::openShaderLoadingDialog);
     connect(ui->raytraceCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerRaytracing);
+    connect(ui->hybridRaytraceCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerHybridRaytracing);
+    connect(ui->interactiveRaytraceCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerInteractiveRaytracing);
+    connect(ui->pathTraceCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerPathTracing);
+    connect(ui->denoiseCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerDenoising);
+    connect(ui->heatmapComboBox, &QComboBox::currentIndexChanged, ui->openGLWidget, &OpenGLView::changeHeatmap);
+    connect(ui->raytracedShadowsCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerRaytracedShadows);
+    connect(ui->occlusionCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerAmbientOcclusion);
+    connect(ui->pvsCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerPVSCulling);
+    connect(ui->occlusionCullingCheckBox, &QCheckBox::clicked, ui->openGLWidget, &OpenGLView::triggerOcclusionCulling);
+    connect(ui->openSnapshotButton, &QPushButton::clicked, this, &MainWindow::openSnapshotDialog);
+    connect(ui->saveSnapshotButton, &QPushButton::clicked, this, &MainWindow::saveSnapshotDialog);
+    connect(ui->openPVSButton, &QPushButton::clicked, this, &MainWindow::openPVSDialog);
 
     connect(ui->openGLWidget, &OpenGLView::triangleCountChanged, this, &MainWindow::changeTriangleCount);
     connect(ui->openGLWidget, &OpenGLView::fpsCountChanged, this, &MainWindow::changeFpsCount);
+    connect(ui->openGLWidget, &OpenGLView::stateChangesCounted, this, &MainWindow::changeStateChangeCount);
+    connect(ui->openGLWidget, &OpenGLView::occludedObjectsChanged, this, &MainWindow::changeOccludedCount);
     connect(ui->openGLWidget, &OpenGLView::shaderCompiled, this, &MainWindow::addShaderToList, Qt::QueuedConnection);
 
     statusBar()->showMessage(tr("OpenGL-Fenster geöffnet."));
@@ -60,6 +92,28 @@ MainWindow::~MainWindow()
 void MainWindow::mousePressEvent(QMouseEvent *ev)
 {
     mousePos = ev->pos();
+    if (ev->button() == Qt::RightButton) pickObject(ui->openGLWidget->mapFrom(this, ev->pos()));
+}
+
+void MainWindow::pickObject(const QPoint& pixel)
+{
+    QElapsedTimer timer;
+    timer.start();
+    PickResult result;
+    const PickStatus status = ui->openGLWidget->pick(pixel, result);
+    const double microseconds = timer.nsecsElapsed() / 1000.0;
+    if (status == PickStatus::NotReady) {
+        pickMessage = tr("Szene für die Auswahl noch nicht bereit");
+    } else if (status == PickStatus::Miss) {
+        pickMessage = tr("kein Objekt getroffen (%1 µs)").arg(microseconds, 0, 'f', 1);
+    } else {
+        const QString triangle = result.triangle == RayHit::NO_HIT ? tr("Grundform") : tr("Dreieck %1").arg(result.triangle);
+        const QString object = result.snapshotObject ? tr("Snapshot-Objekt %1") : tr("Objekt %1");
+        pickMessage = tr("%1, %2, Punkt (%3, %4, %5) (%6 µs)").arg(object.arg(result.object)).arg(triangle)
+                          .arg(result.position.x(), 0, 'f', 2).arg(result.position.y(), 0, 'f', 2).arg(result.position.z(), 0, 'f', 2)
+                          .arg(microseconds, 0, 'f', 1);
+    }
+    refreshStatusBarMessage();
 }
 
 void MainWindow::mouseMoveEvent(QMouseEvent *ev)
@@ -109,3 +163,24 @@ void MainWindow::openShaderLoadingDialog() {
 void MainWindow::addShaderToList(unsigned int index) {
     ui->shaderComboBox->addItem(QStringLiteral("Shader %1").arg(index));
 }
+
+void MainWindow::openSnapshotDialog() {
+    const auto fileName = QFileDialog::getOpenFileName(this, QStringLiteral("Snapshot auswählen"), QString(), QStringLiteral("Scene Snapshot (*.rtsnap)"), nullptr, QFileDialog::DontUseNativeDialog);
+    if (fileName.isEmpty()) return;
+
+    if (ui->openGLWidget->openSnapshot(fileName)) statusBar()->showMessage(tr("Snapshot %1 geladen.").arg(fileName));
+}
+
+void MainWindow::saveSnapshotDialog() {
+    const auto fileName = QFileDialog::getSaveFileName(this, QStringLiteral("Snapshot speichern"), QString(), QStringLiteral("Scene Snapshot (*.rtsnap)"), nullptr, QFileDialog::DontUseNativeDialog);
+    if (fileName.isEmpty()) return;
+
+    if (ui->openGLWidget->saveSnapshot(fileName)) statusBar()->showMessage(tr("Snapshot %1 gespeichert.").arg(fileName));
+}
+
+void MainWindow::openPVSDialog() {
+    const auto fileName = QFileDialog::getOpenFileName(this, QStringLiteral("PVS auswählen"), QString(), QStringLiteral("Potentially Visible Set (*.pvs)"), nullptr, QFileDialog::DontUseNativeDialog);
+    if (fileName.isEmpty()) return;
+
+    if (ui->openGLWidget->openPVS(fileName)) statusBar()->showMessage(tr("PVS %1 geladen.").arg(fileName));
+}
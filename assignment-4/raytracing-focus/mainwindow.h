@@ -13,6 +13,7 @@
 #define MAINWINDOW_H
 
 #include <QPoint>
+#include <QString>
 #include <QMainWindow>
 
 QT_BEGIN_NAMESPACE
@@ -26,10 +27,15 @@ class MainWindow : public QMainWindow
 private slots:
     void openShaderLoadingDialog();
     void addShaderToList(unsigned int index);
+    void openSnapshotDialog();
+    void saveSnapshotDialog();
+    void openPVSDialog();
 
 public slots:
     void changeTriangleCount(unsigned int triangles);
     void changeFpsCount(unsigned int fps);
+    void changeStateChangeCount(unsigned int issued, unsigned int skipped);
+    void changeOccludedCount(unsigned int occluded);
 
 public:
     MainWindow(QWidget *parent = nullptr);
@@ -44,8 +50,14 @@ private:
     Ui::MainWindow *ui;
     unsigned int fpsCount = 0;
     unsigned int triangleCount = 0;
+    unsigned int stateChanges = 0, skippedStateChanges = 0;
+    unsigned int occludedCount = 0;
     void refreshStatusBarMessage() const;
 
+    // object under the widget pixel, shown in the status bar next to the FPS
+    QString pickMessage;
+    void pickObject(const QPoint& pixel);
+
     // mouse information
     QPoint mousePos;
     float mouseSensitivy = 1.0f;
@@ -0,0 +1,138 @@
+//
+// Occlusion culling of scene objects with hardware occlusion queries on their bounding boxes, with the temporal
+// coherence of CHC++ (Mattausch et al. 2008): the CPU never waits for a query result.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "occlusionculler.h"
+#include "renderstate.h"
+#include "sceneobject.h"
+
+namespace {
+    // a visible object is queried again every few frames, the objects take turns so the queries are spread out
+    const unsigned int VISIBLE_QUERY_INTERVAL = 8;
+    // the boxes are grown a little, so that they do not fight with the faces of the objects in the depth buffer
+    const float BOX_MARGIN = 0.01f;
+
+    bool isInsideBox(SceneObject& object, const QVector3D& cameraPosition) {
+        const QVector3D p = object.getModelMatrix().inverted().map(cameraPosition);
+        const Vec3f mid = object.mesh.getBoundingBoxMid();
+        const Vec3f halfSize = 0.5f * (1.f + BOX_MARGIN) * object.mesh.getBoundingBoxSize();
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            if (std::abs(p[axis] - mid[axis]) > halfSize[axis]) return false;
+        }
+        return true;
+    }
+}
+
+void OcclusionCuller::classify(QOpenGLFunctions_3_3_Core* f, const std::vector<SceneObject>& objects, const std::vector<unsigned int>& inFrustum,
+                               std::vector<unsigned int>& drawn) {
+    if (states.size() != objects.size()) {
+        cleanup(f);
+        states.assign(objects.size(), ObjectState());
+    }
+    frame++;
+    // results that are not there yet keep the last visibility
+    for (ObjectState& state : states) {
+        if (!state.pending) continue;
+        GLuint available = 0;
+        f->glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint samples = 0;
+        f->glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &samples);
+        state.visible = samples > 0;
+        state.hasResult = true;
+        state.pending = false;
+    }
+
+    drawn.clear();
+    occluded.clear();
+    rechecked.clear();
+    occludedObjects = 0;
+    for (unsigned int i : inFrustum) {
+        ObjectState& state = states[i];
+        const bool coherent = state.lastFrame + 1 == frame;
+        state.lastFrame = frame;
+        if (state.hasResult && !state.visible) occludedObjects++;
+        if (state.visible && coherent) {
+            drawn.push_back(i);
+            if (!state.pending && (frame + i) % VISIBLE_QUERY_INTERVAL == 0) rechecked.push_back(i);
+        } else {
+            occluded.push_back(i);
+        }
+    }
+}
+
+unsigned int OcclusionCuller::drawOccluded(RenderState& state, std::vector<SceneObject>& objects, const QVector3D& cameraPosition, GLuint program) {
+    if (occluded.empty() && rechecked.empty()) return 0;
+    auto* f = state.getOpenGLFunctions();
+
+    // front to back, so that the objects drawn first can hide the ones behind them
+    occludedOrder.clear();
+    for (unsigned int i : occluded) {
+        const Vec3f mid = objects[i].mesh.getBoundingBoxMid();
+        const QVector3D center = objects[i].getModelMatrix().map(QVector3D(mid.x(), mid.y(), mid.z()));
+        occludedOrder.emplace_back((center - cameraPosition).lengthSquared(), i);
+    }
+    std::sort(occludedOrder.begin(), occludedOrder.end());
+
+    // The boxes only touch the depth buffer. A box the camera is in would be cut away by the near plane, its object
+    // counts as visible without a query. An object with a pending query keeps it and is drawn by its last result.
+    state.switchToStandardProgram();
+    f->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    f->glDepthMask(GL_FALSE);
+    f->glDepthFunc(GL_LEQUAL);
+    auto query = [&](unsigned int i) {
+        ObjectState& object = states[i];
+        if (object.pending) return;
+        if (isInsideBox(objects[i], cameraPosition)) {
+            object.visible = true;
+            object.hasResult = false;
+            return;
+        }
+        if (object.query == 0) f->glGenQueries(1, &object.query);
+        f->glBeginQuery(GL_ANY_SAMPLES_PASSED, object.query);
+        state.pushModelViewMatrix();
+        state.getCurrentModelViewMatrix() *= objects[i].getModelMatrix();
+        objects[i].mesh.drawSolidBB(state, BOX_MARGIN);
+        state.popModelViewMatrix();
+        f->glEndQuery(GL_ANY_SAMPLES_PASSED);
+        object.pending = true;
+    };
+    for (const auto& entry : occludedOrder) query(entry.second);
+    for (unsigned int i : rechecked) query(i);
+    f->glDepthFunc(GL_LESS);
+    f->glDepthMask(GL_TRUE);
+    f->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // All queries are issued before the first conditional draw, which gives the GPU time for the results. Without
+    // waiting a draw whose result is not there yet is done anyway; the next frame decides by the result.
+    state.setCurrentProgram(program);
+    unsigned int triangles = 0;
+    for (const auto& entry : occludedOrder) {
+        const ObjectState& object = states[entry.second];
+        // objects without a query have the camera in their box
+        const bool conditional = object.pending;
+        if (conditional) f->glBeginConditionalRender(object.query, GL_QUERY_NO_WAIT);
+        triangles += objects[entry.second].drawStatic(state);
+        if (conditional) f->glEndConditionalRender();
+    }
+    return triangles;
+}
+
+void OcclusionCuller::cleanup(QOpenGLFunctions_3_3_Core* f) {
+    for (ObjectState& state : states) {
+        if (state.query != 0) f->glDeleteQueries(1, &state.query);
+    }
+    states.clear();
+}
+
+void OcclusionCuller::reset() {
+    for (ObjectState& state : states) {
+        state.visible = false;
+        state.hasResult = false;
+        state.lastFrame = 0;
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Occlusion culling of scene objects with hardware occlusion queries on their bounding boxes, with the temporal
+// coherence of CHC++ (Mattausch et al. 2008): the CPU never waits for a query result.
+//
+
+#ifndef UEBUNG_04_OCCLUSIONCULLER_H
+#define UEBUNG_04_OCCLUSIONCULLER_H
+
+#include <vector>
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector3D>
+
+class RenderState;
+struct SceneObject;
+
+class OcclusionCuller {
+public:
+    // Picks up the query results that have arrived and splits the objects in the frustum. Objects that were visible
+    // in the last result go to drawn, for the render queue. The others were occluded or have just entered the
+    // frustum, they are queried and drawn conditionally by drawOccluded.
+    void classify(QOpenGLFunctions_3_3_Core* f, const std::vector<SceneObject>& objects, const std::vector<unsigned int>& inFrustum,
+                  std::vector<unsigned int>& drawn);
+    // After the render queue, when the depth buffer holds the visible objects: queries the boxes of the occluded
+    // objects front to back and of the visible ones that are due, then draws the static geometry of the occluded
+    // objects with conditional rendering. Leaves program with the current program. Returns the number of triangles
+    // submitted, the GPU discards those of the objects that are still occluded.
+    unsigned int drawOccluded(RenderState& state, std::vector<SceneObject>& objects, const QVector3D& cameraPosition, GLuint program);
+    // forgets all results, every object is queried again
+    void reset();
+    // deletes the query objects, needs the context they were created in to be current
+    void cleanup(QOpenGLFunctions_3_3_Core* f);
+
+    // objects in the frustum whose last query result had no samples
+    unsigned int getOccludedObjects() const { return occludedObjects; }
+
+private:
+    struct ObjectState {
+        GLuint query{0};
+        // a query was issued and its result has not been read yet
+        bool pending{false};
+        bool visible{false};
+        // visible was set by a query result, not only assumed
+        bool hasResult{false};
+        // last frame the object was in the frustum, the result is stale if it was not in the last one
+        unsigned int lastFrame{0};
+    };
+
+    std::vector<ObjectState> states;
+    unsigned int frame{0};
+    unsigned int occludedObjects{0};
+    // objects of this frame that were occluded and visible ones whose query is due
+    std::vector<unsigned int> occluded, rechecked;
+    // occluded objects with the distance of their box from the camera
+    std::vector<std::pair<float, unsigned int>> occludedOrder;
+};
+
+#endif //UEBUNG_04_OCCLUSIONCULLER_H
@@ -9,7 +9,11 @@
 // Content: Widget for showing OpenGL scene, SOLUTION                        //
 // ========================================================================= //
 
+#include <algorithm>
 #include <cmath>
+#include <chrono>
+#include <cstring>
+#include <limits>
 
 #include <QtDebug>
 #include <QMatrix4x4>
@@ -17,6 +21,10 @@
 
 #include "shader.h"
 #include "openglview.h"
+#include "raytracer.h"
+#include "defaultscene.h"
+#include "aobaker.h"
+#include "utilities.h"
 
 // These variables are missing on MacOS -> This should fix them.
 #ifndef GL_MAX_FRAMEBUFFER_WIDTH
@@ -28,6 +36,10 @@
 #endif
 
 const unsigned int SHADOW_MAP_SIZE = 2048;
+// ray traced shadow masks are traced at this fraction of the window resolution
+const float SHADOW_MASK_SCALE = 0.5f;
+// frame time the interactive ray tracer aims for
+const float INTERACTIVE_FRAME_BUDGET_MS = 50.f;
 
 GLuint OpenGLView::csVAO = 0;
 GLuint OpenGLView::csVBOs[2] = {0, 0};
@@ -44,6 +56,14 @@ OpenGLView::OpenGLView(QWidget* parent) : QOpenGLWidget(parent) {
     fpsCounterTimer.start();
 }
 
+OpenGLView::~OpenGLView() {
+    // the queries belong to the context of the widget
+    if (!f) return;
+    makeCurrent();
+    occlusionCuller.cleanup(f);
+    doneCurrent();
+}
+
 void OpenGLView::setGridSize(int gridSize)
 {
     this->gridSize = gridSize;
@@ -59,7 +79,7 @@ void OpenGLView::initializeGL()
 
     //black screen
     f->glClearColor(0.f, 0.f, 0.f, 1.f);
-    f->glEnable(GL_DEPTH_TEST);
+    state.setDepthTest(true);
     GLint result;
     f->glGetIntegerv(GL_MAX_FRAMEBUFFER_HEIGHT, &result);
     std::cout << "Maximal Framebuffer Height: "<< result << std::endl;
@@ -70,63 +90,27 @@ void OpenGLView::initializeGL()
     sphereMesh.setGLFunctionPtr(f);
     sphereMesh.loadOFF("../uebung-4/Models/sphere.off");
 
-    //load meshes
-    meshes.emplace_back(f);
-    meshes[0].loadOFF("../uebung-4/Models/doppeldecker.off");
-    meshes.emplace_back(f);
-    meshes[1].loadOFF("../uebung-4/Models/cube.off");
-
-    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f), 
-        Vec3f(0.6f, 0.3f, 0.3f), 
-        Vec3f(0.4f, 0.4f, 0.4f), 
-        100.0f, 0.2f, 
-        meshes[0],
-        Vec3f(-4.0f, 0.0f, 0.0f),
-        Vec3(1.0f, 1.0f, 1.0f), 
-        0.0f, 1.5f);
-
-    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
-        Vec3f(0.6f, 0.3f, 0.3f),
-        Vec3f(0.4f, 0.4f, 0.4f),
-        100.f, 0.2f,
-        meshes[0]);
-
-    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
-        Vec3f(0.6f, 0.3f, 0.3f),
-        Vec3f(0.4f, 0.4f, 0.4f),
-        100.f, 0.1f,
-        meshes[0],
-        Vec3f(2.0f, 0.0f, 0.0f));
-
-    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
-        Vec3f(0.6f, 0.3f, 0.3f),
-        Vec3f(0.4f, 0.4f, 0.4f),
-        100.f, 0.4f,
-        meshes[0],
-        Vec3f(-2.0f, 0.0f, 0.0f));
-
-    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
-        Vec3f(0.6f, 0.3f, 0.3f),
-        Vec3f(0.4f, 0.4f, 0.4f),
-        100.f, 0.3f,
-        meshes[1],
-        Vec3f(0.0f, -5.0f, 0.0f),
-        Vec3f(10.f, 0.2f, 10.f));
-
-    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
-        Vec3f(0.6f, 0.3f, 0.3f),
-        Vec3f(0.4f, 0.4f, 0.4f),
-        100.f, 0.f,
-        meshes[1],
-        Vec3f(0.0f, 0.0f, 10.0f),
-        Vec3f(10.f, 10.0f, 0.2f));
-
-    objects.emplace_back(Vec3f(0.2f, 0.1f, 0.1f),
-        Vec3f(0.6f, 0.3f, 0.3f),
-        Vec3f(0.4f, 0.4f, 0.4f),
-        100.f, 0.1f,
-        meshes[1],
-        Vec3f(0.0f, -4.0f, 2.0f));
+    //load meshes, textures and objects
+    loadDefaultScene(f, meshes, rayTracingTextures, objects);
+    state.createUniformBuffers();
+    // objects with equal materials share one entry, so the render queue can draw them together
+    std::vector<MaterialBlock> materials;
+    for (SceneObject& object : objects) {
+        const MaterialBlock material = object.getMaterialBlock();
+        auto equal = std::find_if(materials.begin(), materials.end(), [&](const MaterialBlock& other) {
+            return std::memcmp(&other, &material, sizeof(MaterialBlock)) == 0;
+        });
+        object.materialIndex = equal - materials.begin();
+        if (equal == materials.end()) materials.push_back(material);
+        object.createStaticGeometry(f, false);
+    }
+    state.setMaterials(materials);
+    sceneCuller.build(objects);
+    // the ray tracing scene is built with the scene, so that the first pick does not have to
+    QElapsedTimer buildTimer;
+    buildTimer.start();
+    rayScene.build(objects);
+    std::cout << "built ray tracing scene with " << rayScene.getNumTriangles() << " triangles in " << buildTimer.elapsed() << " ms" << std::endl;
 
     //load coordinate system
     csVAO = genCSVAO();
@@ -161,6 +145,13 @@ void OpenGLView::initializeGL()
         if (shaderID != 0) programIDs.push_back(shaderID);
     }
 
+    //shader for showing the ray traced image
+    rayTracingProgramID = readShaders(f, "../uebung-4/Shader/noop.vert", "../uebung-4/Shader/from_texture.frag");
+
+    //shader for the visibility buffer of hybrid ray tracing
+    visibilityProgramID = readShaders(f, "../uebung-4/Shader/visibility.vert", "../uebung-4/Shader/visibility.geom", "../uebung-4/Shader/visibility.frag");
+    if (visibilityProgramID != 0) objectIDUniform = getProgramUniforms(f, visibilityProgramID).location(UNIFORM_OBJECT_ID);
+
     // TODO: Ex 4.2a Implement shader for calculation of shadow map
 
     // TODO: Ex 4.2a Generate shadow map texture and framebuffer, generate light projection matrix
@@ -176,13 +167,7 @@ void OpenGLView::resizeGL(int width, int height) {
     state.loadIdentityProjectionMatrix();
     state.getCurrentProjectionMatrix().perspective(65.f, aspectRatio, 0.5f, 10000.f);
 
-    //set projection matrix in OpenGL shader
-    state.switchToStandardProgram();
-    f->glUniformMatrix4fv(state.getProjectionUniform(), 1, GL_FALSE, state.getCurrentProjectionMatrix().constData());
-    for (GLuint progID : programIDs) {
-        state.setCurrentProgram(progID);
-        f->glUniformMatrix4fv(state.getProjectionUniform(), 1, GL_FALSE, state.getCurrentProjectionMatrix().constData());
-    }
+    //the projection matrix reaches the shaders with the frame uniforms in paintGL
 
     //Resize viewport
     f->glViewport(0, 0, width, height);
@@ -191,17 +176,26 @@ void OpenGLView::resizeGL(int width, int height) {
 void OpenGLView::paintGL() {
     f->glClearDepth(1.0f);
     f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    state.beginFrame();
     state.loadIdentityModelViewMatrix();
+    // trace as soon as the visibility buffer has arrived, without waiting for the GPU
+    if (visibilityPending) {
+        std::vector<RayHit> primaryHits;
+        if (readVisibilityBuffer(primaryHits)) {
+            visibilityPending = false;
+            raytrace(visibilityWidth, visibilityHeight, visibilityProjection, visibilityModelView, &primaryHits);
+            showRayTracing = true;
+        }
+    }
     if (showRayTracing) {
+        if (pathTracing) pathTraceProgressive();
+        else if (interactiveRayTracing) raytraceInteractive();
         state.setCurrentProgram(rayTracingProgramID);
-        f->glBindVertexArray(rayTraceVAO);
-        f->glActiveTexture(GL_TEXTURE0);
-        f->glBindTexture(GL_TEXTURE_2D, raytracedTextureID);
+        state.bindVertexArray(rayTraceVAO);
+        state.bindTexture(0, raytracedTextureID);
         f->glUniform1i(state.getTextureUniform(), 0);
 
         f->glDrawArrays(GL_TRIANGLE_FAN, 0, 5);
-        f->glBindVertexArray(0);
-        f->glBindTexture(GL_TEXTURE_2D, 0);
     } else {
         static const QVector3D upVector(0.0f, 1.0f, 0.0f);
         if (lightMoves) moveLight();
@@ -212,9 +206,16 @@ void OpenGLView::paintGL() {
         QVector3D cameraLookAt = cameraPos + cameraDir;
 
         state.getCurrentModelViewMatrix().lookAt(cameraPos, cameraLookAt, upVector);
+        state.setFrameUniforms(cameraPos);
+        if (visibilityRequested) {
+            visibilityRequested = false;
+            renderVisibilityBuffer();
+        }
+        if (rayTracedShadows) updateShadowMask();
         state.switchToStandardProgram();
         drawCS();
 
+        renderQueue.clear();
         drawLight();
 
         state.setCurrentProgram(currentProgramID);
@@ -222,10 +223,48 @@ void OpenGLView::paintGL() {
 
         //TODO: Ex 4.2b Bind depth map texture
 
-        // draw objects. count triangles and objects drawn.
-        unsigned int triangles, trianglesDrawn = 0, objectsDrawn = 0;
-        for (auto& object : objects) {
-            trianglesDrawn += object.draw(state);
+        // the ray traced mask is only used by shaders that know it
+        GLint shadowMaskUniform = state.getUniform(UNIFORM_SHADOW_MASK);
+        if (shadowMaskUniform != -1) {
+            bool useMask = rayTracedShadows && shadowMaskValid;
+            f->glUniform1i(state.getUniform(UNIFORM_USE_SHADOW_MASK), useMask);
+            if (useMask) {
+                GLint viewport[4];
+                f->glGetIntegerv(GL_VIEWPORT, viewport);
+                f->glUniform2f(state.getUniform(UNIFORM_VIEWPORT_SIZE), viewport[2], viewport[3]);
+                state.bindTexture(1, shadowMaskTexture);
+                f->glUniform1i(shadowMaskUniform, 1);
+            }
+        }
+
+        // queue objects, then draw them sorted by program, material and mesh. count triangles drawn.
+        // the frustum planes are extracted once in world space, where the hierarchy of the objects is
+        if (sceneCuller.getNumObjects() != objects.size()) sceneCuller.build(objects);
+        visibleObjectIndices.clear();
+        sceneCuller.cull(Frustum(state.getCurrentProjectionMatrix() * state.getCurrentModelViewMatrix()), visibleObjectIndices);
+        // outside of the grid of the PVS everything in the frustum is drawn
+        const int cell = pvsCulling && pvs.getNumObjects() == objects.size() ? pvs.cellAt(QVector3DToVec3f(cameraPos)) : -1;
+        const uint64_t* visibleObjects = cell >= 0 ? pvs.getCell(cell) : nullptr;
+        if (visibleObjects) {
+            visibleObjectIndices.erase(std::remove_if(visibleObjectIndices.begin(), visibleObjectIndices.end(), [&](unsigned int i) {
+                return !PotentiallyVisibleSet::isSet(visibleObjects, i);
+            }), visibleObjectIndices.end());
+        }
+        // with occlusion culling the queue only gets what was visible in the last query results
+        const std::vector<unsigned int>* queuedObjects = &visibleObjectIndices;
+        if (occlusionCulling) {
+            occlusionCuller.classify(f, objects, visibleObjectIndices, unoccludedObjectIndices);
+            queuedObjects = &unoccludedObjectIndices;
+        }
+        for (unsigned int i : *queuedObjects) objects[i].submit(renderQueue, state, currentProgramID);
+        renderQueue.sort();
+        const unsigned int trianglesDrawn = renderQueue.execute(state);
+        // whether the conditional draws pass is only known to the GPU, they are not counted
+        if (occlusionCulling) occlusionCuller.drawOccluded(state, objects, cameraPos, currentProgramID);
+        const unsigned int occluded = occlusionCulling ? occlusionCuller.getOccludedObjects() : 0;
+        if (occluded != occludedLastRun) {
+            occludedLastRun = occluded;
+            emit occludedObjectsChanged(occluded);
         }
         // cout number of objects and triangles if different from last run
         if (trianglesDrawn != trianglesLastRun) {
@@ -233,7 +272,6 @@ void OpenGLView::paintGL() {
             emit triangleCountChanged(trianglesDrawn);
         }
         frameCounter++;
-        f->glBindTexture(GL_TEXTURE_2D, GL_NONE);
     }
     GLenum error;
     while ((error = f->glGetError()) != GL_NO_ERROR) {
@@ -243,10 +281,9 @@ void OpenGLView::paintGL() {
 }
 
 void OpenGLView::drawCS() {
-    f->glUniformMatrix4fv(state.getModelViewUniform(), 1, GL_FALSE, state.getCurrentModelViewMatrix().constData());
-    f->glBindVertexArray(csVAO);
+    state.setMatrices();
+    state.bindVertexArray(csVAO);
     f->glDrawArrays(GL_LINES, 0, 6);
-    f->glBindVertexArray(GL_NONE);
 }
 
 void OpenGLView::drawLight() {
@@ -254,7 +291,7 @@ void OpenGLView::drawLight() {
     state.pushModelViewMatrix();
     Vec3f& lp = state.getLight().position;
     state.getCurrentModelViewMatrix().translate(lp.x(), lp.y(), lp.z());
-    sphereMesh.draw(state);
+    sphereMesh.submit(renderQueue, state, state.getStandardProgram());
     state.popModelViewMatrix();
 }
 
@@ -278,11 +315,7 @@ void OpenGLView::setDefaults() {
     angleX = 0.0f;
     angleY = 0.0f;
     // light information
-    Light defaultLight;
-    defaultLight.position = Vec3f(0.0f, 5.0f, 7.0f);
-    defaultLight.lightIntensity = 1.f;
-    defaultLight.ambientIntensity = 0.4f;
-    state.getLight() = defaultLight;
+    state.getLight() = createDefaultLight();
     lightMotionSpeed = 10.f;
     // mouse information
     mouseSensitivy = 1.0f;
@@ -296,6 +329,8 @@ void OpenGLView::setDefaults() {
 void OpenGLView::refreshFpsCounter()
 {
     emit fpsCountChanged(frameCounter);
+    if (frameCounter > 0) emit stateChangesCounted(state.getIssuedCalls() / frameCounter, state.getSkippedCalls() / frameCounter);
+    state.resetCallCounters();
     frameCounter = 0;
 }
 
@@ -349,6 +384,21 @@ void OpenGLView::changeShader(unsigned int index) {
     doneCurrent();
 }
 
+void OpenGLView::changeHeatmap(int index) {
+    heatmapIndex = index;
+    // the interactive modes upload a new image every frame, they have no heatmap
+    if (!showRayTracing || interactiveRayTracing || pathTracing) return;
+    makeCurrent();
+    // the image was traced without counting the work, trace it again with the same camera
+    if (heatmapIndex > 0 && rayTracedCosts.empty() && !rayTracedImage.empty()) {
+        raytrace(rayTracedWidth, rayTracedHeight, rayTracedProjection, rayTracedModelView);
+    } else {
+        showRayTracedImageOrHeatmap();
+    }
+    doneCurrent();
+    update();
+}
+
 void OpenGLView::compileShader(const QString& vertexShaderPath, const QString& fragmentShaderPath) {
     GLuint programHandle = readShaders(f, vertexShaderPath, fragmentShaderPath);
     if (programHandle) {
@@ -361,12 +411,145 @@ void OpenGLView::triggerRaytracing(bool shouldRaytrace)
 {
     if (!shouldRaytrace) {
         showRayTracing = false;
+        visibilityRequested = false;
+        visibilityPending = false;
+    } else if (pathTracing) {
+        // paintGL adds samples to the image every time
+        pathTraceBuffer.reset(0, 0);
+        showRayTracing = true;
+    } else if (interactiveRayTracing) {
+        // paintGL traces a new frame every time
+        temporalAccumulator.reset();
+        showRayTracing = true;
+    } else if (hybridRayTracing && visibilityProgramID != 0) {
+        // paintGL renders the visibility buffer, the image is traced when its read back has finished
+        visibilityRequested = true;
     } else {
-        raytrace();
+        raytrace(width() * 0.75, height() * 0.75, state.getCurrentProjectionMatrix(), state.getCurrentModelViewMatrix());
         showRayTracing = true;
     }
 }
 
+void OpenGLView::triggerInteractiveRaytracing(bool interactive)
+{
+    interactiveRayTracing = interactive;
+    temporalAccumulator.reset();
+}
+
+void OpenGLView::triggerPathTracing(bool pathTrace)
+{
+    pathTracing = pathTrace;
+    pathTraceBuffer.reset(0, 0);
+}
+
+void OpenGLView::triggerDenoising(bool denoise)
+{
+    denoising = denoise;
+}
+
+// The occlusion is baked once per object when it is first switched on and kept in memory afterwards, switching it
+// off only replaces the static geometry of the objects by one without it.
+void OpenGLView::triggerAmbientOcclusion(bool bake)
+{
+    makeCurrent();
+    if (bake) {
+        if (rayScene.isEmpty()) rayScene.build(objects);
+        QElapsedTimer timer;
+        timer.start();
+        for (SceneObject& object : objects) {
+            if (object.occlusion.empty()) object.occlusion = bakeAmbientOcclusion(rayScene, object);
+            object.createStaticGeometry(f, true);
+        }
+        std::cout << "ambient occlusion ready after " << timer.elapsed() << " ms" << std::endl;
+    } else {
+        for (SceneObject& object : objects) object.createStaticGeometry(f, false);
+    }
+    doneCurrent();
+    update();
+}
+
+// Without a loaded PVS one is baked for the current scene on the first use
+void OpenGLView::triggerPVSCulling(bool cull)
+{
+    pvsCulling = cull;
+    if (!cull || !pvs.isEmpty()) return;
+    if (rayScene.isEmpty()) rayScene.build(objects);
+    QElapsedTimer timer;
+    timer.start();
+    pvs.bake(rayScene, PotentiallyVisibleSet::defaultBounds(rayScene));
+    std::cout << "baked PVS with " << pvs.getNumCells() << " cells in " << timer.elapsed() << " ms, "
+              << pvs.averageVisible() << " of " << pvs.getNumObjects() << " objects visible per cell" << std::endl;
+}
+
+void OpenGLView::triggerOcclusionCulling(bool cull)
+{
+    occlusionCulling = cull;
+    // results from before are stale, everything starts as just entered the frustum
+    if (cull) occlusionCuller.reset();
+}
+
+void OpenGLView::triggerHybridRaytracing(bool hybrid)
+{
+    hybridRayTracing = hybrid;
+}
+
+void OpenGLView::triggerRaytracedShadows(bool raytraced)
+{
+    rayTracedShadows = raytraced;
+    if (!raytraced) shadowMaskValid = false;
+}
+
+PickStatus OpenGLView::pick(const QPoint& pixel, PickResult& result) {
+    result = PickResult();
+    if (rayScene.isEmpty()) return PickStatus::NotReady;
+    if (width() <= 0 || height() <= 0) return PickStatus::Miss;
+    QMatrix4x4 modelView;
+    modelView.lookAt(cameraPos, cameraPos + cameraDir, QVector3D(0.0f, 1.0f, 0.0f));
+    const QMatrix4x4 inverse = (state.getCurrentProjectionMatrix() * modelView).inverted();
+    // from the near to the far plane through the center of the pixel, widget rows go from top to bottom
+    const float x = 2.f * (pixel.x() + 0.5f) / width() - 1.f, y = 1.f - 2.f * (pixel.y() + 0.5f) / height();
+    const Ray<float> ray(QVector3DToVec3f(inverse.map(QVector3D(x, y, -1.f))), QVector3DToVec3f(inverse.map(QVector3D(x, y, 1.f))));
+
+    RayHit hit;
+    hit.t = std::numeric_limits<float>::max();
+    unsigned int intersectionTests = 0;
+    if (!rayScene.intersect(ray, hit, intersectionTests)) return PickStatus::Miss;
+    result.object = rayScene.getHitObject(hit);
+    // like the PVS, an opened snapshot is only taken for the scene objects if it has as many
+    result.snapshotObject = rayScene.isMapped() && rayScene.getNumObjects() != objects.size();
+    if (!hit.isPrimitive()) result.triangle = hit.triangle - rayScene.getObject(result.object).firstTriangle;
+    result.position = ray.o + hit.t * ray.d;
+    result.distance = hit.t;
+    return PickStatus::Hit;
+}
+
+// The ray tracer uses the snapshot instead of the objects until the application is restarted
+bool OpenGLView::openSnapshot(const QString& fileName) {
+    // a running shadow job still reads the old scene
+    waitForShadowMask();
+    QElapsedTimer timer;
+    timer.start();
+    if (!rayScene.open(fileName)) return false;
+    std::cout << "opened snapshot with " << rayScene.getNumTriangles() << " triangles in " << timer.elapsed() << " ms" << std::endl;
+    return true;
+}
+
+bool OpenGLView::saveSnapshot(const QString& fileName) {
+    if (rayScene.isEmpty()) rayScene.build(objects);
+    return rayScene.save(fileName);
+}
+
+// The object indices of the PVS have to match the objects of the view, otherwise it is not used
+bool OpenGLView::openPVS(const QString& fileName) {
+    if (!pvs.open(fileName)) return false;
+    if (pvs.getNumObjects() != objects.size()) {
+        std::cout << "PVS " << fileName.toStdString() << " was baked for " << pvs.getNumObjects() << " objects, the scene has " << objects.size() << std::endl;
+        pvs.clear();
+        return false;
+    }
+    return true;
+}
+
 // This creates a VAO that represents the coordinate system
 GLuint OpenGLView::genCSVAO() {
     GLuint VAOresult;
@@ -403,164 +586,87 @@ GLuint OpenGLView::genCSVAO() {
     return VAOresult;
 }
 
-Vec3f OpenGLView::traceRay(const Ray<float>& ray, int recursion_depth, unsigned int& intersectionTests) {
-    // 1. Termination condition: If depth is zero, then stop shooting and tracing rays
-    if (recursion_depth <= 0) {
-        return Vec3f(0.0f, 0.0f, 0.0f); // Schwarz
-    }
-
-    // 2. look for next intersection
-    float t = std::numeric_limits<float>::max(); // intiialize to possible maximum
-    float u = 0.f, v = 0.f; // barycentric coordinates for triangle intersection
-    unsigned int hitTri = 0; // id of triangle that was hit
-    auto hitObjIt = intersectRayObjectsEarliest(objects.cbegin(), objects.cend(), ray, t, u, v, hitTri, intersectionTests);
-
-    // If no object hit, show black background color
-    if (hitObjIt == objects.cend()) {
-        return Vec3f(0.0f, 0.0f, 0.0f);
-    }
+void OpenGLView::raytrace(unsigned int w, unsigned int h, const QMatrix4x4& projection, const QMatrix4x4& modelView, const std::vector<RayHit>* primaryHits) {
+    // flatten the scene on first use, unless a snapshot was opened
+    if (rayScene.isEmpty()) rayScene.build(objects);
+    RayTracer tracer(rayScene, state.getLight());
+    // counting the work slows the tracer down, it is only done for a heatmap
+    tracer.recordCost = heatmapIndex > 0;
+    rayTracedImage = tracer.render(w, h, projection, modelView, primaryHits);
+    rayTracedCosts = std::move(tracer.pixelCosts);
+    rayTracedWidth = w;
+    rayTracedHeight = h;
+    rayTracedProjection = projection;
+    rayTracedModelView = modelView;
+    std::cout << "normalizing picture with multiplicator 255" << std::endl << std::endl;
+    showRayTracedImageOrHeatmap();
+}
 
-    // 3. calculate intersection point
-    const SceneObject& hitObject = *hitObjIt;
-    Vec3f intersectionPoint = ray.o + t * ray.d;
-
-    // triangle vertices from object's mesh
-    const auto& vertices = hitObject.mesh.getVertices();
-    const auto& triangles = hitObject.mesh.getTriangles();
-    const Vec3ui& tri = triangles[hitTri];
-    Vec3f p0 = vertices[tri[0]];
-    Vec3f p1 = vertices[tri[1]];
-    Vec3f p2 = vertices[tri[2]];
-
-    // normal vector of intersected triangle
-    Vec3f normal = cross(p1 - p0, p2 - p0).normalized();
-
-    // 4. Shadow Test
-    // offset iwth epsilon, so it does not intersect it self
-    const float eps = 1e-3f;
-    Vec3f lightPos = state.getLight().position;
-    Vec3f lightDir = (lightPos - intersectionPoint).normalized();
-    float lightDist = (lightPos - intersectionPoint).length();
-
-    // shoot shadow ray to light source
-    Ray<float> shadowRay(intersectionPoint + normal * eps, lightDir);
-    float shadowT;
-    unsigned int shadowTri;
-    float dummyU, dummyV;
-    auto shadowHit = intersectRayObjectsEarliest(objects.cbegin(), objects.cend(), shadowRay, shadowT, dummyU, dummyV, shadowTri, intersectionTests);
-
-    // If object is hit before the light, poiint is in a shadow
-    float S_i = 1.0f; // 1 = lit, 0 = not so lit
-    if (shadowHit != objects.cend() && shadowT < lightDist) {
-        S_i = 0.0f;
+void OpenGLView::showRayTracedImageOrHeatmap() {
+    if (rayTracedImage.empty()) return;
+    if (heatmapIndex > 0) {
+        uploadRayTracedImage(RayTracer::costHeatmap(rayTracedCosts, static_cast<CostMetric>(heatmapIndex - 1)), rayTracedWidth, rayTracedHeight);
+    } else {
+        uploadRayTracedImage(rayTracedImage, rayTracedWidth, rayTracedHeight);
     }
+}
 
-    // 5. calculate phong lighting at intersection
-    Vec3f viewDir = (ray.o - intersectionPoint).normalized();
-    Vec3f ambient = hitObject.ambientColor * state.getLight().ambientIntensity;
-
-    // diffuse
-    float NdotL = std::max(0.0f, dot(normal, lightDir));
-    Vec3f diffuse = hitObject.diffuseColor * NdotL * state.getLight().lightIntensity;
-    
-    // specular
-    Vec3f reflectDir = (2.0f * normal * (normal * lightDir) - lightDir).normalized();
-    float RdotV = std::max(0.0f, dot(reflectDir, viewDir));
-    Vec3f specular = hitObject.specularColor * std::pow(RdotV, hitObject.shininess) * state.getLight().lightIntensity;
-
-    // combine ambient, diffuse and specular color with the shadow factor to have the phong Color
-    Vec3f phongColor = ambient + S_i * (diffuse + specular);
-
-    // 6. recursive
-    float k_r = hitObject.reflectionIntensity; // intensity of reflection (I)
-    if (k_r > 0.0f) {
-        // generate reflection
-        Ray<float> reflectionRay(intersectionPoint + normal * eps, reflectDir);
-        Vec3f reflectionColor = traceRay(reflectionRay, recursion_depth - 1, intersectionTests); //trace recursively
-
-        // add reflection into the phong  Color
-        phongColor += k_r * reflectionColor;
+// Traces one frame at a resolution that fits the frame budget and blends it with the reprojected previous frames.
+void OpenGLView::raytraceInteractive() {
+    if (rayScene.isEmpty()) rayScene.build(objects);
+    if (lightMoves) {
+        moveLight();
+        temporalAccumulator.reset();
     }
-
-    // 7. transparency
-    float k_t = hitObject.transparency; // transparency factor
-    if (k_t > 0.0f) {
-        float refractionIndex = hitObject.refractiveIndex; // refractive index of the object
-        Vec3f refractDir = refract(ray.d, normal, refractionIndex);// refraction direction
-        // if the refractDirection is valid, acually calculated the color and add the color value
-        if (refractDir.length() > 0) {
-            // generate refraction ray with offset
-            Ray<float> refractionRay(intersectionPoint - normal * eps, refractDir);
-            // recursive tracing the refraction ray
-            Vec3f refractionColor = traceRay(refractionRay, recursion_depth - 1, intersectionTests);
-
-            // add transparency part of coloring
-            phongColor += k_t * refractionColor;
-        }
+    QMatrix4x4 modelView;
+    modelView.lookAt(cameraPos, cameraPos + cameraDir, QVector3D(0.0f, 1.0f, 0.0f));
+    const QMatrix4x4& projection = state.getCurrentProjectionMatrix();
+    unsigned int w = std::max(1.f, width() * interactiveScale), h = std::max(1.f, height() * interactiveScale);
+
+    QElapsedTimer timer;
+    timer.start();
+    RayTracer tracer(rayScene, state.getLight());
+    tracer.showProgress = false;
+    temporalAccumulator.nextJitter(tracer.jitterX, tracer.jitterY);
+    std::vector<Vec3f> positions;
+    std::vector<Vec3f> pictureRGB = tracer.render(w, h, projection, modelView, nullptr, &positions);
+    const std::vector<Vec3f>& blended = temporalAccumulator.accumulate(pictureRGB, positions, w, h, projection * modelView);
+    uploadRayTracedImage(blended, w, h);
+    frameCounter++;
+
+    // the cost is about proportional to the pixel count. The resolution stays fixed from the first frame with an
+    // unchanged camera on, so the samples accumulate at one resolution instead of being resampled.
+    float elapsed = std::max<float>(1.f, timer.elapsed());
+    if (!temporalAccumulator.isStill()) {
+        interactiveScale *= std::sqrt(INTERACTIVE_FRAME_BUDGET_MS / elapsed);
+        interactiveScale = std::max(0.05f, std::min(interactiveScale, 1.f));
     }
-
-    return phongColor;
 }
 
-Vec3f OpenGLView::refract(const Vec3f& incident, const Vec3f& normal, float eta) {
-    float NdotI = dot(normal, incident);
-    // discriminant for refraction equation
-    float k = 1.0f - eta * eta * (1.0f - NdotI * NdotI);
-
-    // if negative/zero, no refraction occurs
-    if (k <= 0.0f) {
-        return Vec3f(0.0f, 0.0f, 0.0f); // Totale interne Reflexion
-    }
-    else {
-        // refracted direction 
-        // https://registry.khronos.org/OpenGL-Refpages/gl4/html/refract.xhtml
-        return eta * incident - (eta * NdotI + sqrt(k)) * normal;
+// Adds one path traced sample per pixel to the accumulated image, which is reset whenever the view changes.
+void OpenGLView::pathTraceProgressive() {
+    if (rayScene.isEmpty()) rayScene.build(objects);
+    QMatrix4x4 modelView;
+    modelView.lookAt(cameraPos, cameraPos + cameraDir, QVector3D(0.0f, 1.0f, 0.0f));
+    const QMatrix4x4& projection = state.getCurrentProjectionMatrix();
+    unsigned int w = std::max(1.f, width() * 0.75f), h = std::max(1.f, height() * 0.75f);
+    if (lightMoves) moveLight();
+    if (lightMoves || w != pathTraceBuffer.width || h != pathTraceBuffer.height || projection * modelView != pathTraceViewProjection) {
+        pathTraceBuffer.reset(w, h);
+        pathTraceViewProjection = projection * modelView;
     }
+
+    PathTracer tracer(rayScene, state.getLight());
+    tracer.render(pathTraceBuffer, projection, modelView, 1);
+    if (denoising) uploadRayTracedImage(denoiser.denoise(pathTraceBuffer.average(), pathTraceBuffer.guides, w, h), w, h);
+    else uploadRayTracedImage(pathTraceBuffer.average(), w, h);
+    frameCounter++;
 }
 
-void OpenGLView::raytrace() {
-    // initalization
-    size_t w = width() * 0.75, h = height() * 0.75;
+void OpenGLView::uploadRayTracedImage(const std::vector<Vec3f>& pictureRGB, unsigned int w, unsigned int h) {
     size_t viewPortSize = w * h;
-    std::vector<Vec3f> pictureRGB(viewPortSize);
-    unsigned int intersectionTests = 0, hits = 0;
-    auto clockStart = std::chrono::system_clock::now();
-    std::cout << "   10   20   30   40   50   60   70   80   90  100" << std::endl;
-    std::cout << "====|====|====|====|====|====|====|====|====|====|" << std::endl;
-    // iterate over all pixel
-    unsigned int pixelCounter = 0;
-    int maxDepth = 5;
-    #pragma omp parallel for schedule(dynamic)
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x++) {
-            // get pixel index for addressing pictureRGB array
-            size_t pixel = y * w + x;
-            QVector3D eye(x, y, -1.f), end(x, y, 1.f);
-            eye = eye.unproject(state.getCurrentModelViewMatrix(), state.getCurrentProjectionMatrix(), QRect(0, 0, w, h));
-            end = end.unproject(state.getCurrentModelViewMatrix(), state.getCurrentProjectionMatrix(), QRect(0, 0, w, h));
-            const auto& eyeF(QVector3DToVec3f(eye));
-            const auto& endF(QVector3DToVec3f(end));
-
-            Ray<float> ray(eyeF, endF);
-            pictureRGB[pixel] = traceRay(ray, maxDepth, intersectionTests);
-
-            // cout "." every 1/50 of all pixels
-
-            #pragma omp critical
-            {
-                pixelCounter++;
-                if (pixelCounter % (viewPortSize / 50) == 0) std::clog << ".";
-            };
-        }
-
-    }
-    auto clockEnd = std::chrono::system_clock::now();
-    auto passedTime = clockEnd - clockStart;
-    std::cout << std::endl << "finished. tests: " << intersectionTests << ", hits: " << hits << ", ms: "
-        << std::chrono::duration_cast<std::chrono::milliseconds>(passedTime).count() << std::endl;
     // generate openGL texture
     float mul = 255.0f; // multiply rgb values within [0,1] by 255
-    std::cout << "normalizing picture with multiplicator " << mul << std::endl << std::endl;
     std::unique_ptr<GLubyte[]> picture{new GLubyte[viewPortSize * 4]};
 
     for (unsigned int y = 0; y < h; y++) {
@@ -580,7 +686,7 @@ void OpenGLView::raytrace() {
     }
     // generate texture
     if (!raytracedTextureID) f->glGenTextures(1, &raytracedTextureID);
-    f->glBindTexture(GL_TEXTURE_2D, raytracedTextureID);
+    state.bindTexture(0, raytracedTextureID);
     f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -589,6 +695,269 @@ void OpenGLView::raytrace() {
         picture.get());
 }
 
+// Rasterizes object ID, triangle index and barycentric coordinates of every pixel and starts reading them back into
+// pixel buffer objects. The read back finishes in the background, readVisibilityBuffer picks the result up later.
+void OpenGLView::renderVisibilityBuffer() {
+    unsigned int w = width() * 0.75, h = height() * 0.75;
+    if (w == 0 || h == 0) return;
+    if (w != visibilityWidth || h != visibilityHeight) {
+        if (!visibilityFramebuffer) {
+            f->glGenFramebuffers(1, &visibilityFramebuffer);
+            f->glGenTextures(2, visibilityTextures);
+            f->glGenRenderbuffers(1, &visibilityDepthBuffer);
+            f->glGenBuffers(2, visibilityPBOs);
+        }
+        visibilityWidth = w;
+        visibilityHeight = h;
+        // integer texture for object ID and triangle index, float texture for the barycentric coordinates
+        state.bindTexture(0, visibilityTextures[0]);
+        f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, w, h, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        state.bindTexture(0, visibilityTextures[1]);
+        f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, w, h, 0, GL_RG, GL_FLOAT, nullptr);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        state.bindTexture(0, 0);
+        f->glBindRenderbuffer(GL_RENDERBUFFER, visibilityDepthBuffer);
+        f->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+        f->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        f->glBindFramebuffer(GL_FRAMEBUFFER, visibilityFramebuffer);
+        f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibilityTextures[0], 0);
+        f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, visibilityTextures[1], 0);
+        f->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, visibilityDepthBuffer);
+        if (f->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Visibility framebuffer is incomplete" << std::endl;
+        }
+
+        for (GLuint pbo : visibilityPBOs) {
+            f->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+            f->glBufferData(GL_PIXEL_PACK_BUFFER, w * h * 2 * sizeof(GLuint), nullptr, GL_STREAM_READ);
+        }
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    GLint viewport[4];
+    f->glGetIntegerv(GL_VIEWPORT, viewport);
+    f->glBindFramebuffer(GL_FRAMEBUFFER, visibilityFramebuffer);
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    f->glDrawBuffers(2, drawBuffers);
+    f->glViewport(0, 0, w, h);
+    const GLuint noObject[] = {0, 0, 0, 0};
+    const GLfloat noBarycentric[] = {0.f, 0.f, 0.f, 0.f};
+    f->glClearBufferuiv(GL_COLOR, 0, noObject);
+    f->glClearBufferfv(GL_COLOR, 1, noBarycentric);
+    f->glClear(GL_DEPTH_BUFFER_BIT);
+
+    state.setCurrentProgram(visibilityProgramID);
+    for (unsigned int i = 0; i < objects.size(); ++i) {
+        f->glUniform1ui(objectIDUniform, i + 1);
+        objects[i].draw(state);
+    }
+
+    // asynchronous read back, glReadPixels returns immediately when the target is a pixel buffer object
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, visibilityPBOs[0]);
+    f->glReadBuffer(GL_COLOR_ATTACHMENT0);
+    f->glReadPixels(0, 0, w, h, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, visibilityPBOs[1]);
+    f->glReadBuffer(GL_COLOR_ATTACHMENT1);
+    f->glReadPixels(0, 0, w, h, GL_RG, GL_FLOAT, nullptr);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (visibilityFence) f->glDeleteSync(visibilityFence);
+    visibilityFence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    visibilityPending = true;
+
+    visibilityProjection = state.getCurrentProjectionMatrix();
+    visibilityModelView = state.getCurrentModelViewMatrix();
+
+    f->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    f->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    state.setCurrentProgram(currentProgramID);
+}
+
+// Returns false while the GPU has not finished the read back.
+bool OpenGLView::readVisibilityBuffer(std::vector<RayHit>& primaryHits) {
+    if (!visibilityFence) return false;
+    GLenum status = f->glClientWaitSync(visibilityFence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    f->glDeleteSync(visibilityFence);
+    visibilityFence = nullptr;
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        // GL_WAIT_FAILED, the buffers may never be filled: fall back to tracing everything
+        std::cout << "Waiting for the visibility buffer failed, tracing primary rays as well" << std::endl;
+        visibilityPending = false;
+        raytrace(visibilityWidth, visibilityHeight, visibilityProjection, visibilityModelView);
+        showRayTracing = true;
+        return false;
+    }
+
+    // the visibility buffer refers to objects, so the ray tracing scene has to consist of exactly these objects
+    if (rayScene.isEmpty()) rayScene.build(objects);
+    bool sceneMatches = rayScene.getNumObjects() == objects.size();
+    for (unsigned int i = 0; sceneMatches && i < objects.size(); ++i) {
+        sceneMatches = objects[i].shape != SceneObject::Shape::Mesh || rayScene.getObject(i).triangleCount == objects[i].mesh.getNumTriangles();
+    }
+    // pixels of analytic shapes only remember the shape, the tracer intersects it exactly
+    std::vector<unsigned int> objectPrimitives(rayScene.getNumObjects(), RayHit::NO_HIT);
+    for (unsigned int i = 0; i < rayScene.getNumPrimitives(); ++i) objectPrimitives[rayScene.getPrimitive(i).object] = i;
+    if (!sceneMatches) {
+        std::cout << "The ray tracing scene does not match the rasterized objects, tracing primary rays as well" << std::endl;
+    }
+
+    const size_t pixelCount = visibilityWidth * visibilityHeight;
+    primaryHits.resize(pixelCount);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, visibilityPBOs[0]);
+    const GLuint* ids = static_cast<const GLuint*>(f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixelCount * 2 * sizeof(GLuint), GL_MAP_READ_BIT));
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, visibilityPBOs[1]);
+    const GLfloat* barycentrics = static_cast<const GLfloat*>(f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixelCount * 2 * sizeof(GLfloat), GL_MAP_READ_BIT));
+    bool ok = ids && barycentrics && sceneMatches;
+    if (ok) {
+        for (size_t pixel = 0; pixel < pixelCount; ++pixel) {
+            RayHit& hit = primaryHits[pixel];
+            hit.triangle = RayHit::NO_HIT;
+            GLuint objectID = ids[2 * pixel], primitive = ids[2 * pixel + 1];
+            if (objectID == 0 || objectID > rayScene.getNumObjects()) continue;
+            if (objectPrimitives[objectID - 1] != RayHit::NO_HIT) {
+                hit.triangle = RayHit::PRIMITIVE_FLAG | objectPrimitives[objectID - 1];
+                continue;
+            }
+            const RayObject& range = rayScene.getObject(objectID - 1);
+            if (primitive >= range.triangleCount) continue;
+            hit.triangle = range.firstTriangle + primitive;
+            hit.u = barycentrics[2 * pixel];
+            hit.v = barycentrics[2 * pixel + 1];
+        }
+    }
+    if (barycentrics) f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, visibilityPBOs[0]);
+    if (ids) f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!ok) {
+        // fall back to tracing everything
+        visibilityPending = false;
+        raytrace(visibilityWidth, visibilityHeight, visibilityProjection, visibilityModelView);
+        showRayTracing = true;
+        return false;
+    }
+    return true;
+}
+
+// Advances the shadow mask pipeline by at most one step per frame: render the depth pre-pass, start the shadow rays
+// once its read back has arrived, upload the mask once the rays are finished. Nothing here waits for the GPU or the
+// worker threads.
+void OpenGLView::updateShadowMask() {
+    if (shadowMaskJob.valid()) {
+        if (shadowMaskJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+        std::vector<unsigned char> mask = shadowMaskJob.get();
+        if (!shadowMaskTexture) f->glGenTextures(1, &shadowMaskTexture);
+        state.bindTexture(0, shadowMaskTexture);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        f->glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, shadowMaskJobWidth, shadowMaskJobHeight, 0, GL_RED, GL_UNSIGNED_BYTE, mask.data());
+        f->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        state.bindTexture(0, 0);
+        shadowMaskValid = true;
+        return;
+    }
+    if (!shadowMaskFence) {
+        renderShadowDepth();
+        return;
+    }
+    const GLenum status = f->glClientWaitSync(shadowMaskFence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) return;
+    f->glDeleteSync(shadowMaskFence);
+    shadowMaskFence = nullptr;
+    // after GL_WAIT_FAILED the depth is not read, the next frame renders the pre-pass again
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+
+    const size_t pixelCount = shadowMaskWidth * shadowMaskHeight;
+    std::vector<float> depth(pixelCount);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, shadowMaskPBO);
+    const GLfloat* mapped = static_cast<const GLfloat*>(f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixelCount * sizeof(GLfloat), GL_MAP_READ_BIT));
+    if (mapped) {
+        std::copy(mapped, mapped + pixelCount, depth.begin());
+        f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!mapped) return;
+
+    // the worker threads get copies of everything except the scene, which stays alive until the job is finished
+    if (rayScene.isEmpty()) rayScene.build(objects);
+    shadowMaskJobWidth = shadowMaskWidth;
+    shadowMaskJobHeight = shadowMaskHeight;
+    const RayScene& scene = rayScene;
+    Light light = state.getLight();
+    unsigned int w = shadowMaskWidth, h = shadowMaskHeight;
+    QMatrix4x4 projection = shadowMaskProjection, modelView = shadowMaskModelView;
+    shadowMaskJob = std::async(std::launch::async, [&scene, light, depth, w, h, projection, modelView]() {
+        RayTracer tracer(scene, light);
+        return tracer.traceShadowMask(depth, w, h, projection, modelView);
+    });
+}
+
+// Renders only depth at reduced resolution and starts reading it back into a pixel buffer object.
+void OpenGLView::renderShadowDepth() {
+    unsigned int w = width() * SHADOW_MASK_SCALE, h = height() * SHADOW_MASK_SCALE;
+    if (w == 0 || h == 0 || visibilityProgramID == 0) return;
+    if (w != shadowMaskWidth || h != shadowMaskHeight) {
+        if (!shadowMaskFramebuffer) {
+            f->glGenFramebuffers(1, &shadowMaskFramebuffer);
+            f->glGenTextures(1, &shadowMaskDepthTexture);
+            f->glGenBuffers(1, &shadowMaskPBO);
+        }
+        shadowMaskWidth = w;
+        shadowMaskHeight = h;
+        state.bindTexture(0, shadowMaskDepthTexture);
+        f->glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        state.bindTexture(0, 0);
+
+        f->glBindFramebuffer(GL_FRAMEBUFFER, shadowMaskFramebuffer);
+        f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMaskDepthTexture, 0);
+        f->glDrawBuffer(GL_NONE);
+        f->glReadBuffer(GL_NONE);
+        if (f->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Shadow mask framebuffer is incomplete" << std::endl;
+        }
+
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, shadowMaskPBO);
+        f->glBufferData(GL_PIXEL_PACK_BUFFER, w * h * sizeof(GLfloat), nullptr, GL_STREAM_READ);
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    GLint viewport[4];
+    f->glGetIntegerv(GL_VIEWPORT, viewport);
+    f->glBindFramebuffer(GL_FRAMEBUFFER, shadowMaskFramebuffer);
+    f->glViewport(0, 0, w, h);
+    f->glClear(GL_DEPTH_BUFFER_BIT);
+
+    // the visibility program has the same vertex transformation, its color outputs go nowhere
+    state.setCurrentProgram(visibilityProgramID);
+    for (auto& object : objects) object.draw(state);
+
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, shadowMaskPBO);
+    f->glReadPixels(0, 0, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    shadowMaskFence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    shadowMaskProjection = state.getCurrentProjectionMatrix();
+    shadowMaskModelView = state.getCurrentModelViewMatrix();
+
+    f->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    f->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    state.setCurrentProgram(currentProgramID);
+}
+
+void OpenGLView::waitForShadowMask() {
+    if (shadowMaskJob.valid()) shadowMaskJob.wait();
+}
+
 GLuint OpenGLView::genRayTraceVAO() {
     GLuint result;
     f->glGenVertexArrays(1, &result);
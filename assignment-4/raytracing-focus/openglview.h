@@ -12,6 +12,9 @@
 #ifndef OPENGLVIEW_H
 #define OPENGLVIEW_H
 
+#include <future>
+#include <vector>
+
 #include <QByteArray>
 #include <QTimer>
 #include <QString>
@@ -25,12 +28,34 @@
 #include "vec3.h"
 #include "renderstate.h"
 #include "sceneobject.h"
+#include "rayscene.h"
+#include "raytracer.h"
+#include "temporal.h"
+#include "pathtracer.h"
+#include "pvs.h"
+#include "sceneculler.h"
+#include "occlusionculler.h"
+
+// Result of OpenGLView::pick
+enum class PickStatus { Hit, Miss, NotReady };
+struct PickResult {
+    unsigned int object{RayHit::NO_HIT};   // index of the SceneObject, or of the object in the snapshot
+    bool snapshotObject{false};            // object indexes the objects of an opened snapshot, not the scene objects
+    unsigned int triangle{RayHit::NO_HIT}; // triangle of the object's mesh, NO_HIT for analytic shapes
+    Vec3f position;                        // hit point in world space
+    float distance{};                      // from the near plane of the camera
+};
 
 class OpenGLView : public QOpenGLWidget
 {
     Q_OBJECT
 public:
     OpenGLView(QWidget* parent = nullptr);
+    ~OpenGLView() override;
+
+    // object under a point of the widget, found with one ray through the BVH of the ray tracer instead of a read
+    // back of the frame buffer. The BVH is built with the scene, without it the pick is NotReady.
+    PickStatus pick(const QPoint& pixel, PickResult& result);
 
 public slots:
     void setGridSize(int gridSize);
@@ -40,8 +65,20 @@ public slots:
     void cameraMoves(float deltaX, float deltaY, float deltaZ);
     void cameraRotates(float deltaX, float deltaY);
     void changeShader(unsigned int index);
+    void changeHeatmap(int index);
     void compileShader(const QString& vertexShaderPath, const QString& fragmentShaderPath);
     void triggerRaytracing(bool shouldRaytrace);
+    void triggerHybridRaytracing(bool hybrid);
+    void triggerRaytracedShadows(bool raytraced);
+    void triggerInteractiveRaytracing(bool interactive);
+    void triggerPathTracing(bool pathTrace);
+    void triggerDenoising(bool denoise);
+    void triggerAmbientOcclusion(bool bake);
+    void triggerPVSCulling(bool cull);
+    void triggerOcclusionCulling(bool cull);
+    bool openSnapshot(const QString& fileName);
+    bool saveSnapshot(const QString& fileName);
+    bool openPVS(const QString& fileName);
 
 protected:
     void initializeGL() override;
@@ -50,11 +87,15 @@ protected:
 
 signals:
     void fpsCountChanged(int newFps);
+    // GL state changes per frame that RenderState issued and skipped
+    void stateChangesCounted(unsigned int issued, unsigned int skipped);
+    // objects in the frustum that occlusion culling left out of the render queue, sent when the number changes
+    void occludedObjectsChanged(unsigned int occluded);
     void triangleCountChanged(unsigned int newTriangles);
     void shaderCompiled(unsigned int index);
 
 private:
-    QOpenGLFunctions_3_3_Core* f;
+    QOpenGLFunctions_3_3_Core* f{};
 
     // camera Information
     QVector3D cameraPos;
@@ -69,7 +110,18 @@ private:
     unsigned int objectsLastRun, trianglesLastRun;
     std::vector<TriangleMesh> meshes;
     std::vector<SceneObject> objects;
+    std::vector<MipMappedTexture> rayTracingTextures;
     TriangleMesh sphereMesh; // sun
+    // draws of the raster pass, sorted each frame
+    RenderQueue renderQueue;
+    // view frustum culling of the objects, the visible ones of the current frame
+    SceneCuller sceneCuller;
+    std::vector<unsigned int> visibleObjectIndices;
+    //occlusion culling: objects hidden in the last known query result are queried instead of queued
+    bool occlusionCulling = false;
+    OcclusionCuller occlusionCuller;
+    std::vector<unsigned int> unoccludedObjectIndices;
+    unsigned int occludedLastRun = 0;
 
     static GLuint csVAO, csVBOs[2];
     int gridSize;
@@ -106,11 +158,64 @@ private:
     GLuint rayTracingProgramID;
     static GLuint rayTraceVAO, rayTraceVBOs[2];
     GLuint raytracedTextureID{};
-    void raytrace();
-    Vec3f traceRay(const Ray<float>& ray, int recursion_depth, unsigned int& intersectionTests);
-    Vec3f refract(const Vec3f& incident, const Vec3f& normal, float eta);
+    void raytrace(unsigned int w, unsigned int h, const QMatrix4x4& projection, const QMatrix4x4& modelView, const std::vector<RayHit>* primaryHits = nullptr);
+    void uploadRayTracedImage(const std::vector<Vec3f>& pictureRGB, unsigned int w, unsigned int h);
+    RayScene rayScene;
     bool showRayTracing = false;
 
+    //cost heatmap: 0 shows the image of raytrace(), the other indices a CostMetric + 1
+    int heatmapIndex = 0;
+    std::vector<Vec3f> rayTracedImage;
+    std::vector<PixelCost> rayTracedCosts;   // only recorded while a heatmap is selected
+    unsigned int rayTracedWidth{}, rayTracedHeight{};
+    QMatrix4x4 rayTracedProjection, rayTracedModelView;   // to trace again when a heatmap is selected afterwards
+    void showRayTracedImageOrHeatmap();
+
+    //interactive ray tracing: a new frame every paintGL, the resolution follows the time budget
+    bool interactiveRayTracing = false;
+    float interactiveScale = 0.25f;   // fraction of the window resolution
+    TemporalAccumulator temporalAccumulator;
+    void raytraceInteractive();
+
+    //progressive path tracing: every paintGL adds one sample per pixel until the camera or the light moves
+    bool pathTracing = false;
+    AccumulationBuffer pathTraceBuffer;
+    QMatrix4x4 pathTraceViewProjection;
+    bool denoising = false;
+    Denoiser denoiser;
+    void pathTraceProgressive();
+
+    //potentially visible set: objects that cannot be seen from the cell of the camera are not drawn
+    bool pvsCulling = false;
+    PotentiallyVisibleSet pvs;
+
+    //hybrid raytracing: primary hits are rasterized into a visibility buffer and read back asynchronously
+    bool hybridRayTracing = false;
+    bool visibilityRequested = false; // render the visibility buffer in the next frame
+    bool visibilityPending = false;   // read back is running, trace as soon as it is finished
+    GLuint visibilityProgramID{};
+    GLint objectIDUniform{-1};
+    GLuint visibilityFramebuffer{}, visibilityTextures[2]{}, visibilityDepthBuffer{}, visibilityPBOs[2]{};
+    GLsync visibilityFence{};
+    unsigned int visibilityWidth{}, visibilityHeight{};
+    QMatrix4x4 visibilityProjection, visibilityModelView;
+    void renderVisibilityBuffer();
+    bool readVisibilityBuffer(std::vector<RayHit>& primaryHits);
+
+    //ray traced shadows: a depth pre-pass is read back, the shadow rays run on worker threads and the result is
+    //uploaded as mask for the raster pass. The mask lags a few frames behind the camera.
+    bool rayTracedShadows = false;
+    GLuint shadowMaskFramebuffer{}, shadowMaskDepthTexture{}, shadowMaskPBO{}, shadowMaskTexture{};
+    GLsync shadowMaskFence{};
+    unsigned int shadowMaskWidth{}, shadowMaskHeight{};           // size of the depth pre-pass
+    unsigned int shadowMaskJobWidth{}, shadowMaskJobHeight{};     // size of the mask that is being traced
+    QMatrix4x4 shadowMaskProjection, shadowMaskModelView;
+    bool shadowMaskValid = false;
+    std::future<std::vector<unsigned char>> shadowMaskJob;
+    void updateShadowMask();
+    void renderShadowDepth();
+    void waitForShadowMask();
+
     //shadow mapping
     GLuint shadowMapTexture;
     GLuint shadowMapFramebuffer;
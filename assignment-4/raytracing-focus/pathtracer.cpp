@@ -0,0 +1,236 @@
+//
+// Progressive Monte Carlo path tracer on a RayScene, with next-event estimation and multiple importance sampling.
+//
+
+#include <cmath>
+#include <limits>
+
+#include <QVector4D>
+
+#include "pathtracer.h"
+#include "utilities.h"
+
+namespace {
+    // The light is a sphere whose emitted radiance is chosen so that a surface at this distance receives as much
+    // light as from the point light of the Whitted tracer, which has no falloff.
+    const float REFERENCE_DISTANCE = 10.f;
+    const float SURFACE_OFFSET = 1e-3f;
+    const float PI = 3.14159265358979f;
+
+    Vec3f multiply(const Vec3f& a, const Vec3f& b) {
+        return Vec3f(a.x() * b.x(), a.y() * b.y(), a.z() * b.z());
+    }
+
+    float luminance(const Vec3f& color) {
+        return 0.2126f * color.x() + 0.7152f * color.y() + 0.0722f * color.z();
+    }
+
+    // weight of a sample from strategy a if strategy b could have produced it as well
+    float powerHeuristic(float pdfA, float pdfB) {
+        return pdfA * pdfA / (pdfA * pdfA + pdfB * pdfB);
+    }
+}
+
+void AccumulationBuffer::reset(unsigned int w, unsigned int h) {
+    width = w;
+    height = h;
+    samples = 0;
+    sum.assign(w * h, Vec3f(0.f));
+    guides.reset(w, h);
+}
+
+std::vector<Vec3f> AccumulationBuffer::average() const {
+    std::vector<Vec3f> result(sum.size(), Vec3f(0.f));
+    if (samples == 0) return result;
+    for (size_t i = 0; i < sum.size(); ++i) result[i] = sum[i] / static_cast<float>(samples);
+    return result;
+}
+
+PathTracer::PathTracer(const RayScene& scene, const Light& light) : scene(scene), light(light) {
+    this->light.radius = std::max(light.radius, 1e-3f);
+    lightRadiance = Vec3f(light.lightIntensity * REFERENCE_DISTANCE * REFERENCE_DISTANCE / (this->light.radius * this->light.radius));
+}
+
+float PathTracer::intersectLight(const Ray<float>& ray) const {
+    Vec3f oc = ray.o - light.position;
+    float b = oc * ray.d, c = oc * oc - light.radius * light.radius;
+    float discriminant = b * b - c;
+    if (discriminant < 0.f) return std::numeric_limits<float>::infinity();
+    float root = std::sqrt(discriminant);
+    if (-b - root > 0.f) return -b - root;
+    if (-b + root > 0.f) return -b + root;
+    return std::numeric_limits<float>::infinity();
+}
+
+float PathTracer::lightPdf(const Vec3f& position) const {
+    float distance2 = (light.position - position) * (light.position - position);
+    if (distance2 <= light.radius * light.radius) return 0.f;
+    float cosMax = std::sqrt(std::max(0.f, 1.f - light.radius * light.radius / distance2));
+    return 1.f / (2.f * PI * (1.f - cosMax));
+}
+
+bool PathTracer::sampleLight(const Vec3f& position, Random& random, Vec3f& direction, float& pdf) const {
+    Vec3f toCenter = light.position - position;
+    float distance2 = toCenter * toCenter;
+    if (distance2 <= light.radius * light.radius) return false;
+    float cosMax = std::sqrt(std::max(0.f, 1.f - light.radius * light.radius / distance2));
+    float cosTheta = 1.f - random.nextFloat() * (1.f - cosMax);
+    direction = sampleAround(toCenter / std::sqrt(distance2), cosTheta, 2.f * PI * random.nextFloat());
+    pdf = 1.f / (2.f * PI * (1.f - cosMax));
+    return true;
+}
+
+// The material of the Whitted tracer is read as sum of a Lambertian lobe (diffuse color), a normalized Phong lobe
+// (specular color, shininess) and the two delta lobes for mirror reflection and refraction. A path continues with
+// one of the lobes, chosen proportional to its weight.
+Vec3f PathTracer::tracePath(Ray<float> ray, Random& random, unsigned int& intersectionTests) const {
+    Vec3f radiance(0.f), throughput(1.f);
+    // camera rays and delta lobes can only find the light by hitting it, its emission counts fully then
+    bool deltaBounce = true;
+    float bsdfPdf = 0.f;
+    Vec3f lastPosition = ray.o;
+
+    for (int depth = 0; depth < maxDepth; ++depth) {
+        RayHit hit;
+        hit.t = std::numeric_limits<float>::max();
+        bool surfaceHit = scene.intersect(ray, hit, intersectionTests);
+        if (intersectLight(ray) < hit.t) {
+            float weight = deltaBounce ? 1.f : powerHeuristic(bsdfPdf, lightPdf(lastPosition));
+            radiance += weight * multiply(throughput, lightRadiance);
+            break;
+        }
+        if (!surfaceHit) break;
+
+        const RaySurface surface = scene.surfaceAt(ray, RayDifferential<float>(), hit);
+        const RayMaterial& material = *surface.material;
+        // normals on the side the ray comes from
+        const Vec3f wo = -1.f * ray.d;
+        const Vec3f ng = surface.normal * wo < 0.f ? -1.f * surface.normal : surface.normal;
+        const Vec3f n = surface.shadingNormal * ng < 0.f ? -1.f * surface.shadingNormal : surface.shadingNormal;
+
+        const float diffuseWeight = luminance(surface.diffuseColor), glossyWeight = luminance(material.specularColor);
+        const float totalWeight = diffuseWeight + glossyWeight + material.reflectionIntensity + material.transparency;
+        if (totalWeight <= 0.f) break;
+        const float pDiffuse = diffuseWeight / totalWeight, pGlossy = glossyWeight / totalWeight;
+        const Vec3f reflected = 2.f * (n * wo) * n - wo;
+
+        // value and sampling density of the non-delta lobes
+        auto evaluate = [&](const Vec3f& wi, float& pdf) {
+            float cosine = std::max(0.f, wi * n);
+            float lobe = std::pow(std::max(0.f, reflected * wi), material.shininess);
+            pdf = pDiffuse * cosine / PI + pGlossy * (material.shininess + 1.f) / (2.f * PI) * lobe;
+            return surface.diffuseColor / PI + ((material.shininess + 2.f) / (2.f * PI) * lobe) * material.specularColor;
+        };
+
+        // next-event estimation, the light is seen through the non-delta lobes only
+        Vec3f wi;
+        float pdf;
+        if (pDiffuse + pGlossy > 0.f && sampleLight(surface.position, random, wi, pdf) && wi * ng > 0.f && wi * n > 0.f) {
+            Ray<float> shadowRay = Ray<float>::withDirection(surface.position + SURFACE_OFFSET * ng, wi);
+            float lightDistance = intersectLight(shadowRay);
+            if (lightDistance != std::numeric_limits<float>::infinity() && !scene.occluded(shadowRay, lightDistance, intersectionTests)) {
+                float pdfBsdf;
+                Vec3f f = evaluate(wi, pdfBsdf);
+                radiance += (powerHeuristic(pdf, pdfBsdf) * (wi * n) / pdf) * multiply(multiply(throughput, f), lightRadiance);
+            }
+        }
+
+        // continue the path with one lobe
+        Vec3f origin;
+        float choice = random.nextFloat() * totalWeight;
+        if (choice < diffuseWeight + glossyWeight) {
+            if (choice < diffuseWeight) {
+                wi = sampleCosineHemisphere(n, random.nextFloat(), random.nextFloat());
+            } else {
+                wi = sampleAround(reflected.normalized(), std::pow(random.nextFloat(), 1.f / (material.shininess + 1.f)), 2.f * PI * random.nextFloat());
+            }
+            Vec3f f = evaluate(wi, pdf);
+            float cosine = wi * n;
+            if (cosine <= 0.f || wi * ng <= 0.f || pdf <= 0.f) break;
+            throughput = multiply(throughput, f) * (cosine / pdf);
+            deltaBounce = false;
+            bsdfPdf = pdf;
+            origin = surface.position + SURFACE_OFFSET * ng;
+        } else if (choice < diffuseWeight + glossyWeight + material.reflectionIntensity) {
+            wi = ray.d - 2.f * (ray.d * ng) * ng;
+            // lobe weight divided by the probability of choosing the lobe
+            throughput = throughput * (totalWeight);
+            deltaBounce = true;
+            origin = surface.position + SURFACE_OFFSET * ng;
+        } else {
+            // entering if the geometric normal faces the ray
+            bool entering = surface.normal * ray.d < 0.f;
+            float eta = entering ? 1.f / material.refractiveIndex : material.refractiveIndex;
+            float cosIncident = wo * ng;
+            float k = 1.f - eta * eta * (1.f - cosIncident * cosIncident);
+            if (k < 0.f) {
+                // total internal reflection
+                wi = ray.d - 2.f * (ray.d * ng) * ng;
+                origin = surface.position + SURFACE_OFFSET * ng;
+            } else {
+                wi = eta * ray.d + (eta * cosIncident - std::sqrt(k)) * ng;
+                origin = surface.position - SURFACE_OFFSET * ng;
+            }
+            throughput = throughput * (totalWeight);
+            deltaBounce = true;
+        }
+        lastPosition = surface.position;
+        ray = Ray<float>::withDirection(origin, wi);
+
+        if (depth + 1 >= russianRouletteDepth) {
+            float survival = std::min(0.95f, std::max(throughput.x(), std::max(throughput.y(), throughput.z())));
+            if (random.nextFloat() >= survival) break;
+            throughput /= survival;
+        }
+    }
+    return radiance;
+}
+
+void PathTracer::traceGuides(const Ray<float>& ray, Vec3f& normal, Vec3f& albedo, float& depth, unsigned int& intersectionTests) const {
+    normal = albedo = Vec3f(0.f);
+    depth = 0.f;
+    RayHit hit;
+    hit.t = std::numeric_limits<float>::max();
+    if (!scene.intersect(ray, hit, intersectionTests) || intersectLight(ray) < hit.t) return;
+    const RaySurface surface = scene.surfaceAt(ray, RayDifferential<float>(), hit);
+    const RayMaterial& material = *surface.material;
+    normal = surface.shadingNormal * ray.d > 0.f ? -1.f * surface.shadingNormal : surface.shadingNormal;
+    // everything the surface reflects, mirrors and refractions included, so that dividing it out never amplifies noise
+    albedo = surface.diffuseColor + material.specularColor + Vec3f(material.reflectionIntensity + material.transparency);
+    depth = hit.t;
+}
+
+void PathTracer::render(AccumulationBuffer& buffer, const QMatrix4x4& projection, const QMatrix4x4& modelView, unsigned int samplesPerPixel) {
+    const unsigned int w = buffer.width, h = buffer.height;
+    unsigned int intersectionTests = 0;
+    // same camera model as RayTracer::render
+    const QMatrix4x4 inverse = (projection * modelView).inverted();
+    auto primaryRay = [&](float x, float y) {
+        QVector4D eye(2.f * x / w - 1.f, 2.f * y / h - 1.f, -3.f, 1.f), end(2.f * x / w - 1.f, 2.f * y / h - 1.f, 1.f, 1.f);
+        eye = inverse * eye;
+        end = inverse * end;
+        return Ray<float>(QVector3DToVec3f(eye.toVector3DAffine()), QVector3DToVec3f(end.toVector3DAffine()));
+    };
+    #pragma omp parallel for schedule(dynamic) reduction(+:intersectionTests)
+    for (int y = 0; y < static_cast<int>(h); y++) {
+        for (int x = 0; x < static_cast<int>(w); x++) {
+            size_t pixel = y * w + x;
+            Vec3f sum(0.f);
+            if (buffer.samples == 0) {
+                traceGuides(primaryRay(x + 0.5f, y + 0.5f), buffer.guides.normals[pixel], buffer.guides.albedo[pixel],
+                            buffer.guides.depth[pixel], intersectionTests);
+            }
+            for (unsigned int sample = 0; sample < samplesPerPixel; ++sample) {
+                // one random sequence per pixel, the sample index selects the position in it
+                Random random(seed * 0x9E3779B97F4A7C15ULL + buffer.samples + sample, pixel);
+                Ray<float> ray = primaryRay(x + random.nextFloat(), y + random.nextFloat());
+                Vec3f radiance = tracePath(ray, random, intersectionTests);
+                // a single broken path must not ruin the pixel for all following samples
+                if (std::isfinite(radiance.x()) && std::isfinite(radiance.y()) && std::isfinite(radiance.z())) sum += radiance;
+            }
+            buffer.sum[pixel] += sum;
+        }
+    }
+    buffer.samples += samplesPerPixel;
+    lastIntersectionTests = intersectionTests;
+}
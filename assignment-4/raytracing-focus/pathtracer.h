@@ -0,0 +1,63 @@
+//
+// Progressive Monte Carlo path tracer on a RayScene, with next-event estimation and multiple importance sampling.
+//
+
+#ifndef UEBUNG_04_PATHTRACER_H
+#define UEBUNG_04_PATHTRACER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QMatrix4x4>
+
+#include "vec3.h"
+#include "ray.h"
+#include "light.h"
+#include "rayscene.h"
+#include "denoiser.h"
+#include "sampling.h"
+
+// Sum of all samples per pixel. Every pixel is written only by the thread that renders it, so worker threads share
+// the buffer without locks.
+struct AccumulationBuffer {
+    unsigned int width{}, height{};
+    unsigned int samples{}; // samples per pixel so far
+    std::vector<Vec3f> sum;
+    GuideBuffers guides;        // written with the first samples, for the denoiser
+
+    void reset(unsigned int w, unsigned int h);
+    std::vector<Vec3f> average() const;
+};
+
+class PathTracer {
+public:
+    PathTracer(const RayScene& scene, const Light& light);
+
+    // adds samplesPerPixel samples to every pixel of the buffer, rows from bottom to top like in OpenGL
+    void render(AccumulationBuffer& buffer, const QMatrix4x4& projection, const QMatrix4x4& modelView, unsigned int samplesPerPixel);
+    // radiance arriving along the ray
+    Vec3f tracePath(Ray<float> ray, Random& random, unsigned int& intersectionTests) const;
+    // features of the surface seen along a camera ray, for the guide buffers of the denoiser
+    void traceGuides(const Ray<float>& ray, Vec3f& normal, Vec3f& albedo, float& depth, unsigned int& intersectionTests) const;
+
+    int maxDepth = 8;
+    // paths are continued with probability proportional to their throughput after this many bounces
+    int russianRouletteDepth = 3;
+    // decorrelates independent renderings of the same image, e.g. the reference of the benchmark
+    uint64_t seed = 0;
+    unsigned int lastIntersectionTests = 0;
+
+private:
+    const RayScene& scene;
+    Light light;
+    Vec3f lightRadiance;
+
+    // distance along the ray to the light sphere, infinity if it is missed
+    float intersectLight(const Ray<float>& ray) const;
+    // density of sampleLight in solid angle, the same for every direction towards the light
+    float lightPdf(const Vec3f& position) const;
+    // samples a direction towards the light uniformly in the cone it covers. Returns false inside the light.
+    bool sampleLight(const Vec3f& position, Random& random, Vec3f& direction, float& pdf) const;
+};
+
+#endif //UEBUNG_04_PATHTRACER_H
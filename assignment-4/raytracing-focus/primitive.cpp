@@ -0,0 +1,92 @@
+//
+// Analytic shapes for the ray tracer: sphere, oriented box and plane.
+//
+
+#include "primitive.h"
+
+RayPrimitive RayPrimitive::create(SceneObject::Shape shape, unsigned int object, const QMatrix4x4& modelMatrix) {
+    RayPrimitive primitive{};
+    primitive.shape = static_cast<unsigned int>(shape);
+    primitive.object = object;
+    const QMatrix4x4 inverse = modelMatrix.inverted();
+    for (int row = 0; row < 3; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            primitive.localToWorld[4 * row + column] = modelMatrix(row, column);
+            primitive.worldToLocal[4 * row + column] = inverse(row, column);
+        }
+    }
+    return primitive;
+}
+
+AABB RayPrimitive::bounds() const {
+    // corners of the unit box (or of the unit square for planes) in world space
+    AABB box;
+    const float zExtent = static_cast<SceneObject::Shape>(shape) == SceneObject::Shape::Plane ? 0.f : 1.f;
+    const float* m = localToWorld;
+    for (float x : {-1.f, 1.f}) {
+        for (float y : {-1.f, 1.f}) {
+            for (float z : {-zExtent, zExtent}) {
+                box.grow(Vec3f(m[0] * x + m[1] * y + m[2] * z + m[3],
+                               m[4] * x + m[5] * y + m[6] * z + m[7],
+                               m[8] * x + m[9] * y + m[10] * z + m[11]));
+            }
+        }
+    }
+    return box;
+}
+
+Vec3f RayPrimitive::normal(const Vec3f& point) const {
+    const Vec3f p = toLocal(point);
+    Vec3f localNormal(0.f, 0.f, 1.f);
+    switch (static_cast<SceneObject::Shape>(shape)) {
+        case SceneObject::Shape::Sphere:
+            localNormal = p;
+            break;
+        case SceneObject::Shape::Box: {
+            // the face whose coordinate is closest to +-1
+            unsigned int axis = 0;
+            for (unsigned int i = 1; i < 3; ++i) {
+                if (std::abs(p[i]) > std::abs(p[axis])) axis = i;
+            }
+            localNormal = Vec3f(0.f);
+            localNormal[axis] = p[axis] < 0.f ? -1.f : 1.f;
+            break;
+        }
+        default:
+            break;
+    }
+    // normals transform with the transposed inverse
+    const float* m = worldToLocal;
+    Vec3f n(m[0] * localNormal[0] + m[4] * localNormal[1] + m[8] * localNormal[2],
+            m[1] * localNormal[0] + m[5] * localNormal[1] + m[9] * localNormal[2],
+            m[2] * localNormal[0] + m[6] * localNormal[1] + m[10] * localNormal[2]);
+    return n.normalized();
+}
+
+void RayPrimitive::texCoord(const Vec3f& point, float& u, float& v) const {
+    const Vec3f p = toLocal(point);
+    switch (static_cast<SceneObject::Shape>(shape)) {
+        case SceneObject::Shape::Sphere: {
+            // same mapping as TriangleMesh::calculateTexCoordsSphereMapping
+            Vec3f n = p.normalized();
+            u = (M_1_PI / 2) * std::atan2(n.x(), n.z()) + 0.5;
+            v = M_1_PI * std::asin(std::max(-1.f, std::min(n.y(), 1.f)));
+            break;
+        }
+        case SceneObject::Shape::Box: {
+            // every face shows the whole texture, spanned by the two other axes
+            unsigned int axis = 0;
+            for (unsigned int i = 1; i < 3; ++i) {
+                if (std::abs(p[i]) > std::abs(p[axis])) axis = i;
+            }
+            u = 0.5f * (p[(axis + 1) % 3] + 1.f);
+            v = 0.5f * (p[(axis + 2) % 3] + 1.f);
+            break;
+        }
+        default:
+            // infinite planes repeat the texture of the unit square
+            u = 0.5f * (p[0] + 1.f);
+            v = 0.5f * (p[1] + 1.f);
+            break;
+    }
+}
@@ -0,0 +1,92 @@
+//
+// Analytic shapes for the ray tracer: sphere, oriented box and plane.
+//
+
+#ifndef UEBUNG_04_PRIMITIVE_H
+#define UEBUNG_04_PRIMITIVE_H
+
+#include <cmath>
+
+#include <QMatrix4x4>
+
+#include "vec3.h"
+#include "ray.h"
+#include "bvh.h"
+#include "sceneobject.h"
+
+// Shape in the unit frame of its object (see SceneObject::Shape), placed in the world by an affine transformation.
+// Rays are transformed into the unit frame without normalizing the direction, so t is the same in both frames and
+// scaled or rotated shapes are still intersected exactly. Plain data, stored in snapshots as it is.
+struct RayPrimitive {
+    unsigned int shape;      // SceneObject::Shape, never Mesh
+    unsigned int object;     // index of the RayObject
+    float worldToLocal[12];  // rows of the upper 3x4 part of the inverse model matrix
+    float localToWorld[12];  // rows of the upper 3x4 part of the model matrix
+
+    static RayPrimitive create(SceneObject::Shape shape, unsigned int object, const QMatrix4x4& modelMatrix);
+
+    bool isBounded() const { return shape != static_cast<unsigned int>(SceneObject::Shape::InfinitePlane); }
+    AABB bounds() const;
+
+    // closest intersection with 0 < t < tMax
+    inline bool intersect(const Ray<float>& ray, float tMax, float& t) const;
+    // outward normal in world space at a point on the surface
+    Vec3f normal(const Vec3f& point) const;
+    // texture coordinates of a point on the surface
+    void texCoord(const Vec3f& point, float& u, float& v) const;
+
+private:
+    Vec3f toLocal(const Vec3f& p) const {
+        const float* m = worldToLocal;
+        return Vec3f(m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3],
+                     m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7],
+                     m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11]);
+    }
+    Vec3f directionToLocal(const Vec3f& d) const {
+        const float* m = worldToLocal;
+        return Vec3f(m[0] * d[0] + m[1] * d[1] + m[2] * d[2],
+                     m[4] * d[0] + m[5] * d[1] + m[6] * d[2],
+                     m[8] * d[0] + m[9] * d[1] + m[10] * d[2]);
+    }
+};
+
+bool RayPrimitive::intersect(const Ray<float>& ray, float tMax, float& t) const {
+    const Vec3f o = toLocal(ray.o), d = directionToLocal(ray.d);
+    switch (static_cast<SceneObject::Shape>(shape)) {
+        case SceneObject::Shape::Sphere: {
+            // |o + t d|^2 = 1
+            float a = d * d, b = o * d, c = o * o - 1.f;
+            float discriminant = b * b - a * c;
+            if (discriminant < 0.f) return false;
+            float root = std::sqrt(discriminant);
+            float t0 = (-b - root) / a, t1 = (-b + root) / a;
+            t = t0 > 0.f ? t0 : t1; // t1 if the ray starts inside
+            return t > 0.f && t < tMax;
+        }
+        case SceneObject::Shape::Box: {
+            float tNear = -std::numeric_limits<float>::max(), tFar = std::numeric_limits<float>::max();
+            for (unsigned int i = 0; i < 3; ++i) {
+                float t0 = (-1.f - o[i]) / d[i], t1 = (1.f - o[i]) / d[i];
+                if (t0 > t1) std::swap(t0, t1);
+                tNear = std::max(tNear, t0);
+                tFar = std::min(tFar, t1);
+            }
+            if (tNear > tFar) return false;
+            t = tNear > 0.f ? tNear : tFar;
+            return t > 0.f && t < tMax;
+        }
+        case SceneObject::Shape::Plane:
+        case SceneObject::Shape::InfinitePlane: {
+            if (d[2] == 0.f) return false;
+            t = -o[2] / d[2];
+            if (!(t > 0.f && t < tMax)) return false;
+            if (!isBounded()) return true;
+            float x = o[0] + t * d[0], y = o[1] + t * d[1];
+            return std::abs(x) <= 1.f && std::abs(y) <= 1.f;
+        }
+        default:
+            return false;
+    }
+}
+
+#endif //UEBUNG_04_PRIMITIVE_H
@@ -0,0 +1,165 @@
+//
+// Potentially visible set: which scene objects can be seen from which cell of a grid over the scene, sampled offline
+// with the ray tracer.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <QFile>
+
+#include "pvs.h"
+#include "sampling.h"
+
+namespace {
+    const char PVS_MAGIC[8] = {'G', 'D', 'V', 'P', 'V', 'S', '0', '1'};
+    const uint32_t PVS_VERSION = 1;
+    const float SURFACE_OFFSET = 1e-3f;
+    // the raster pass blends what lies behind transparent objects, so rays continue through that many of them
+    const unsigned int MAX_TRANSPARENT_LAYERS = 4;
+    const float PI = 3.14159265358979f;
+
+    struct PVSHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t cells[3];
+        uint32_t numObjects;
+        uint32_t words;
+        float origin[3];
+        float cellSize;
+    };
+}
+
+void PotentiallyVisibleSet::clear() {
+    bits.clear();
+    cells[0] = cells[1] = cells[2] = 0;
+    numObjects = words = 0;
+}
+
+void PotentiallyVisibleSet::bake(const RayScene& scene, const AABB& bounds, unsigned int cellsPerAxis, unsigned int pointsPerCell, unsigned int raysPerPoint) {
+    clear();
+    const Vec3f extent = bounds.max - bounds.min;
+    if (extent.x() < 0.f || cellsPerAxis == 0) return;
+    cellSize = std::max(extent.x(), std::max(extent.y(), extent.z())) / cellsPerAxis;
+    if (cellSize <= 0.f) return;
+    origin = bounds.min;
+    for (unsigned int axis = 0; axis < 3; ++axis) cells[axis] = std::max(1u, static_cast<unsigned int>(std::ceil(extent[axis] / cellSize)));
+    numObjects = scene.getNumObjects();
+    words = (numObjects + 63) / 64;
+    bits.assign(static_cast<size_t>(getNumCells()) * words, 0);
+
+    // every cell is written by the thread that samples it only
+    #pragma omp parallel for schedule(dynamic)
+    for (int cell = 0; cell < static_cast<int>(getNumCells()); cell++) {
+        uint64_t* cellBits = bits.data() + static_cast<size_t>(cell) * words;
+        const unsigned int x = cell % cells[0], y = (cell / cells[0]) % cells[1], z = cell / (cells[0] * cells[1]);
+        const Vec3f corner = origin + cellSize * Vec3f(x, y, z);
+        Random random(0, cell);
+        RayCost cost;
+        for (unsigned int point = 0; point < pointsPerCell; ++point) {
+            const Vec3f position = corner + cellSize * Vec3f(random.nextFloat(), random.nextFloat(), random.nextFloat());
+            for (unsigned int sample = 0; sample < raysPerPoint; ++sample) {
+                // uniform over the sphere, stratified in the polar angle
+                const float cosTheta = 1.f - 2.f * (sample + random.nextFloat()) / raysPerPoint;
+                const Vec3f direction = sampleAround(Vec3f(0.f, 1.f, 0.f), cosTheta, 2.f * PI * random.nextFloat());
+                Vec3f start = position;
+                for (unsigned int layer = 0; layer < MAX_TRANSPARENT_LAYERS; ++layer) {
+                    RayHit hit;
+                    hit.t = std::numeric_limits<float>::max();
+                    if (!scene.intersect(Ray<float>::withDirection(start, direction), hit, cost)) break;
+                    const unsigned int object = scene.getHitObject(hit);
+                    cellBits[object / 64] |= uint64_t(1) << (object % 64);
+                    if (scene.getMaterial(object).transparency <= 0.f) break;
+                    start = start + (hit.t + SURFACE_OFFSET) * direction;
+                }
+            }
+        }
+    }
+}
+
+AABB PotentiallyVisibleSet::defaultBounds(const RayScene& scene) {
+    AABB bounds = scene.getBounds();
+    const Vec3f extent = bounds.max - bounds.min;
+    if (extent.x() < 0.f) return bounds;
+    const Vec3f margin(0.25f * std::max(extent.x(), std::max(extent.y(), extent.z())));
+    bounds.min -= margin;
+    bounds.max += margin;
+    return bounds;
+}
+
+int PotentiallyVisibleSet::cellAt(const Vec3f& point) const {
+    if (bits.empty()) return -1;
+    int index[3];
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        const float cell = std::floor((point[axis] - origin[axis]) / cellSize);
+        if (!(cell >= 0.f && cell < static_cast<float>(cells[axis]))) return -1;
+        index[axis] = static_cast<int>(cell);
+    }
+    return index[0] + cells[0] * (index[1] + cells[1] * index[2]);
+}
+
+float PotentiallyVisibleSet::averageVisible() const {
+    if (bits.empty()) return 0.f;
+    size_t visible = 0;
+    for (uint64_t word : bits) {
+        for (; word != 0; word &= word - 1) visible++;
+    }
+    return static_cast<float>(visible) / getNumCells();
+}
+
+bool PotentiallyVisibleSet::save(const QString& fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cout << "Could not write PVS " << fileName.toStdString() << std::endl;
+        return false;
+    }
+    PVSHeader header{};
+    std::memcpy(header.magic, PVS_MAGIC, sizeof(header.magic));
+    header.version = PVS_VERSION;
+    std::copy(cells, cells + 3, header.cells);
+    header.numObjects = numObjects;
+    header.words = words;
+    for (unsigned int axis = 0; axis < 3; ++axis) header.origin[axis] = origin[axis];
+    header.cellSize = cellSize;
+    const qint64 size = static_cast<qint64>(bits.size() * sizeof(uint64_t));
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+        && file.write(reinterpret_cast<const char*>(bits.data()), size) == size;
+    if (!ok) std::cout << "Could not write PVS " << fileName.toStdString() << std::endl;
+    return ok;
+}
+
+bool PotentiallyVisibleSet::open(const QString& fileName) {
+    clear();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cout << "Could not open PVS " << fileName.toStdString() << std::endl;
+        return false;
+    }
+    PVSHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+        || std::memcmp(header.magic, PVS_MAGIC, sizeof(header.magic)) != 0 || header.version != PVS_VERSION
+        || header.words != (header.numObjects + 63) / 64 || !(header.cellSize > 0.f)) {
+        std::cout << "PVS " << fileName.toStdString() << " has an unsupported format" << std::endl;
+        return false;
+    }
+    const size_t count = static_cast<size_t>(header.cells[0]) * header.cells[1] * header.cells[2] * header.words;
+    if (count == 0 || file.size() != static_cast<qint64>(sizeof(header) + count * sizeof(uint64_t))) {
+        std::cout << "PVS " << fileName.toStdString() << " is truncated" << std::endl;
+        return false;
+    }
+    bits.resize(count);
+    if (file.read(reinterpret_cast<char*>(bits.data()), count * sizeof(uint64_t)) != static_cast<qint64>(count * sizeof(uint64_t))) {
+        std::cout << "PVS " << fileName.toStdString() << " is truncated" << std::endl;
+        clear();
+        return false;
+    }
+    std::copy(header.cells, header.cells + 3, cells);
+    numObjects = header.numObjects;
+    words = header.words;
+    origin = Vec3f(header.origin[0], header.origin[1], header.origin[2]);
+    cellSize = header.cellSize;
+    return true;
+}
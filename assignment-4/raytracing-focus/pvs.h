@@ -0,0 +1,52 @@
+//
+// Potentially visible set: which scene objects can be seen from which cell of a grid over the scene, sampled offline
+// with the ray tracer.
+//
+
+#ifndef UEBUNG_04_PVS_H
+#define UEBUNG_04_PVS_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QString>
+
+#include "vec3.h"
+#include "bvh.h"
+#include "rayscene.h"
+
+// The space around the scene is split into cubic cells. For every cell one bit per object tells whether the object
+// was seen from some point in the cell. The sets are sampled, so an object that only shows through a small gap can
+// be missed; more points and rays make that less likely.
+class PotentiallyVisibleSet {
+public:
+    // bounds of the navigable space, the longest axis is split into cellsPerAxis cells
+    void bake(const RayScene& scene, const AABB& bounds, unsigned int cellsPerAxis = 16, unsigned int pointsPerCell = 16, unsigned int raysPerPoint = 256);
+    // bounds of the scene grown by a quarter of its longest side, for cameras that look at the scene from outside
+    static AABB defaultBounds(const RayScene& scene);
+    bool save(const QString& fileName) const;
+    bool open(const QString& fileName);
+    void clear();
+
+    bool isEmpty() const { return bits.empty(); }
+    unsigned int getNumObjects() const { return numObjects; }
+    unsigned int getNumCells() const { return cells[0] * cells[1] * cells[2]; }
+
+    // cell containing the point, -1 outside of the grid
+    int cellAt(const Vec3f& point) const;
+    // visibility bits of a cell, bit i of word i / 64 stands for object i
+    const uint64_t* getCell(int cell) const { return bits.data() + static_cast<size_t>(cell) * words; }
+    static bool isSet(const uint64_t* cellBits, unsigned int object) { return (cellBits[object / 64] >> (object % 64)) & 1u; }
+    // average number of visible objects per cell
+    float averageVisible() const;
+
+private:
+    Vec3f origin;
+    float cellSize{};
+    unsigned int cells[3]{};
+    unsigned int numObjects{};
+    unsigned int words{}; // 64 bit words per cell
+    std::vector<uint64_t> bits;
+};
+
+#endif //UEBUNG_04_PVS_H
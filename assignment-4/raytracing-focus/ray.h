@@ -9,6 +9,9 @@
 //                                                                           //
 // ========================================================================== //
 
+#ifndef RAY_H
+#define RAY_H
+
 #include "vec3.h"
 
 template<class T>
@@ -30,6 +33,14 @@ class Ray {
       d.normalize();
     }
 
+  // the constructors above take a second point, this one takes a direction
+  static Ray withDirection(const Vec3<T>& origin, const Vec3<T>& direction) {
+    Ray result(origin, origin);
+    result.d = direction;
+    result.d.normalize();
+    return result;
+  }
+
   bool triangleIntersect(const Vec3_& p0, const Vec3_& p1, const Vec3_& p2, T& u, T& v, T &rayt) const
    {
      Vec3_ e1(p1[0]-p0[0],
@@ -70,3 +81,49 @@ class Ray {
 
 
 };
+
+// Ray differentials (Igehy, "Tracing Ray Differentials", 1999): change of origin and direction
+// from one pixel to its right (x) and upper (y) neighbour. Used for texture filtering.
+template<class T>
+struct RayDifferential {
+  Vec3<T> dOdx, dDdx, dOdy, dDdy;
+  bool valid{false};
+
+  // Moves the differentials to the hit point of ray after distance t on a surface with normal n.
+  // Returns the differentials of the hit point.
+  void transfer(const Ray<T>& ray, T t, const Vec3<T>& n, Vec3<T>& dPdx, Vec3<T>& dPdy) const {
+    T dn = ray.d * n;
+    dPdx = dOdx + t * dDdx;
+    dPdy = dOdy + t * dDdy;
+    if (std::abs(dn) > 1e-7) {
+      dPdx -= ((dPdx * n) / dn) * ray.d;
+      dPdy -= ((dPdy * n) / dn) * ray.d;
+    }
+  }
+
+  // Differentials of the mirrored ray. n is the (flat) normal at the hit point.
+  RayDifferential reflected(const Vec3<T>& dPdx, const Vec3<T>& dPdy, const Vec3<T>& n) const {
+    RayDifferential result;
+    result.valid = valid;
+    result.dOdx = dPdx;
+    result.dOdy = dPdy;
+    result.dDdx = dDdx - 2 * (dDdx * n) * n;
+    result.dDdy = dDdy - 2 * (dDdy * n) * n;
+    return result;
+  }
+
+  // Differentials of the refracted direction t = eta * d - mu * n, see OpenGLView::refract.
+  RayDifferential refracted(const Vec3<T>& dPdx, const Vec3<T>& dPdy, const Vec3<T>& d, const Vec3<T>& t, const Vec3<T>& n, T eta) const {
+    RayDifferential result;
+    result.valid = valid;
+    result.dOdx = dPdx;
+    result.dOdy = dPdy;
+    T tn = t * n;
+    T dmu = std::abs(tn) > 1e-7 ? eta - eta * eta * (d * n) / tn : 0;
+    result.dDdx = eta * dDdx - (dmu * (dDdx * n)) * n;
+    result.dDdy = eta * dDdy - (dmu * (dDdy * n)) * n;
+    return result;
+  }
+};
+
+#endif // RAY_H
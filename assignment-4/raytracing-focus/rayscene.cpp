@@ -0,0 +1,491 @@
+//
+// Flattened world-space scene for the ray tracer, can be stored as a memory-mapped snapshot.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "rayscene.h"
+#include "utilities.h"
+
+// Snapshot layout: header followed by the arrays of the scene, each one aligned to SNAPSHOT_ALIGNMENT bytes.
+// Everything is stored in native byte order exactly as it is used in memory, so opening a snapshot only maps the file.
+namespace {
+    const char SNAPSHOT_MAGIC[8] = {'G', 'D', 'V', 'R', 'T', 'S', 'N', 'P'};
+    const uint32_t SNAPSHOT_VERSION = 2;
+    const uint64_t SNAPSHOT_ALIGNMENT = 64;
+
+    enum SnapshotSection {
+        POSITIONS, NORMALS, TEXCOORDS, TRIANGLES, TRIANGLE_OBJECTS, OBJECTS, MATERIALS, TEXTURE_PATHS, PRIMITIVES,
+        UNBOUNDED_PRIMITIVES, BVH_NODES, BVH_PRIM_INDICES,
+        SECTION_COUNT
+    };
+
+    struct SnapshotSectionEntry {
+        uint64_t offset;
+        uint64_t count;
+        uint64_t elementSize;
+    };
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t sectionCount;
+        SnapshotSectionEntry sections[SECTION_COUNT];
+    };
+
+    static_assert(sizeof(Vec3f) == 3 * sizeof(float), "Vec3f is stored directly in snapshots");
+    static_assert(sizeof(Vec3ui) == 3 * sizeof(unsigned int), "Vec3ui is stored directly in snapshots");
+    static_assert(sizeof(RayPrimitive) == 26 * sizeof(float), "RayPrimitive is stored directly in snapshots");
+
+    template<typename T>
+    void setView(ArrayView<T>& view, const std::vector<T>& data) {
+        view.data = data.data();
+        view.size = data.size();
+    }
+
+    template<typename T>
+    bool mapView(ArrayView<T>& view, const uchar* base, qint64 fileSize, const SnapshotSectionEntry& section) {
+        if (section.elementSize != sizeof(T) || section.offset % SNAPSHOT_ALIGNMENT != 0) return false;
+        if (section.offset > static_cast<uint64_t>(fileSize) || section.count > (fileSize - section.offset) / sizeof(T)) return false;
+        view.data = reinterpret_cast<const T*>(base + section.offset);
+        view.size = section.count;
+        return true;
+    }
+
+    template<typename T>
+    bool writeSection(QFile& file, SnapshotSectionEntry& section, const ArrayView<T>& view) {
+        // pad to alignment
+        static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+        uint64_t position = file.pos();
+        uint64_t padding = (SNAPSHOT_ALIGNMENT - position % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+        if (padding && file.write(zeros, padding) != static_cast<qint64>(padding)) return false;
+        section.offset = position + padding;
+        section.count = view.size;
+        section.elementSize = sizeof(T);
+        qint64 bytes = view.size * sizeof(T);
+        return bytes == 0 || file.write(reinterpret_cast<const char*>(view.data), bytes) == bytes;
+    }
+}
+
+void RayScene::clear() {
+    storage = {};
+    snapshotFile.reset();
+    textures.clear();
+    materialFeatures.clear();
+    pointToStorage();
+}
+
+void RayScene::pointToStorage() {
+    setView(positions, storage.positions);
+    setView(normals, storage.normals);
+    setView(texCoords, storage.texCoords);
+    setView(triangles, storage.triangles);
+    setView(triangleObjects, storage.triangleObjects);
+    setView(objects, storage.objects);
+    setView(materials, storage.materials);
+    setView(texturePaths, storage.texturePaths);
+    setView(primitives, storage.primitives);
+    setView(unboundedPrimitives, storage.unboundedPrimitives);
+    setView(nodes, storage.nodes);
+    setView(primIndices, storage.primIndices);
+}
+
+void RayScene::build(const std::vector<SceneObject>& sceneObjects) {
+    clear();
+    std::vector<const MipMappedTexture*> usedTextures;
+
+    for (const SceneObject& object : sceneObjects) {
+        TriangleMesh& mesh = object.mesh;
+        const QMatrix4x4& modelMatrix = object.getModelMatrix();
+        const QMatrix4x4 normalMatrix = modelMatrix.inverted().transposed();
+        const bool analytic = object.shape != SceneObject::Shape::Mesh;
+
+        RayObject range;
+        range.firstTriangle = storage.triangles.size();
+        range.triangleCount = analytic ? 0 : mesh.getNumTriangles();
+        range.firstVertex = storage.positions.size();
+        range.vertexCount = analytic ? 0 : mesh.getNumVertices();
+        storage.objects.push_back(range);
+
+        if (analytic) {
+            storage.primitives.push_back(RayPrimitive::create(object.shape, storage.objects.size() - 1, modelMatrix));
+            if (!storage.primitives.back().isBounded()) storage.unboundedPrimitives.push_back(storage.primitives.size() - 1);
+        } else {
+            // vertices in world space
+            const auto& vertices = mesh.getVertices();
+            const auto& meshNormals = mesh.getNormals();
+            const auto& meshTexCoords = mesh.getTexCoords();
+            for (unsigned int i = 0; i < vertices.size(); ++i) {
+                storage.positions.push_back(QVector3DToVec3f(modelMatrix.map(Vec3fToQVector3D(vertices[i]))));
+                Vec3f normal = i < meshNormals.size() ? QVector3DToVec3f(normalMatrix.mapVector(Vec3fToQVector3D(meshNormals[i]))) : Vec3f(0.f);
+                storage.normals.push_back(normal.normalized());
+                storage.texCoords.push_back(i < meshTexCoords.size() ? meshTexCoords[i] : TriangleMesh::TexCoord{0.f, 0.f});
+            }
+            for (const Vec3ui& triangle : mesh.getTriangles()) {
+                storage.triangles.emplace_back(triangle[0] + range.firstVertex, triangle[1] + range.firstVertex, triangle[2] + range.firstVertex);
+                storage.triangleObjects.push_back(storage.objects.size() - 1);
+            }
+        }
+
+        RayMaterial material;
+        material.ambientColor = object.ambientColor;
+        material.diffuseColor = object.diffuseColor;
+        material.specularColor = object.specularColor;
+        material.shininess = object.shininess;
+        material.reflectionIntensity = object.reflectionIntensity;
+        material.transparency = object.transparency;
+        material.refractiveIndex = object.refractiveIndex;
+        material.texture = -1;
+        if (object.diffuseTexture && object.diffuseTexture->isValid()) {
+            auto it = std::find(usedTextures.begin(), usedTextures.end(), object.diffuseTexture);
+            material.texture = it - usedTextures.begin();
+            if (it == usedTextures.end()) usedTextures.push_back(object.diffuseTexture);
+        }
+        storage.materials.push_back(material);
+    }
+
+    for (const MipMappedTexture* texture : usedTextures) {
+        RayTexturePath path{};
+        std::strncpy(path.fileName, texture->getFileName().c_str(), sizeof(path.fileName) - 1);
+        storage.texturePaths.push_back(path);
+    }
+
+    // BVH entries: all triangles, then the bounded primitives
+    std::vector<AABB> primBounds(storage.triangles.size());
+    std::vector<unsigned int> entries(storage.triangles.size());
+    for (unsigned int i = 0; i < storage.triangles.size(); ++i) {
+        for (unsigned int j = 0; j < 3; ++j) primBounds[i].grow(storage.positions[storage.triangles[i][j]]);
+        entries[i] = i;
+    }
+    for (unsigned int i = 0; i < storage.primitives.size(); ++i) {
+        if (!storage.primitives[i].isBounded()) continue;
+        primBounds.push_back(storage.primitives[i].bounds());
+        entries.push_back(storage.triangles.size() + i);
+    }
+    if (!primBounds.empty()) buildBVH(primBounds, storage.nodes, storage.primIndices);
+    for (unsigned int& index : storage.primIndices) index = entries[index];
+
+    pointToStorage();
+    loadTextures();
+}
+
+bool RayScene::save(const QString& fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cout << "Could not write snapshot " << fileName.toStdString() << std::endl;
+        return false;
+    }
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.sectionCount = SECTION_COUNT;
+    // header is written twice, the second time with the section offsets
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+        && writeSection(file, header.sections[POSITIONS], positions)
+        && writeSection(file, header.sections[NORMALS], normals)
+        && writeSection(file, header.sections[TEXCOORDS], texCoords)
+        && writeSection(file, header.sections[TRIANGLES], triangles)
+        && writeSection(file, header.sections[TRIANGLE_OBJECTS], triangleObjects)
+        && writeSection(file, header.sections[OBJECTS], objects)
+        && writeSection(file, header.sections[MATERIALS], materials)
+        && writeSection(file, header.sections[TEXTURE_PATHS], texturePaths)
+        && writeSection(file, header.sections[PRIMITIVES], primitives)
+        && writeSection(file, header.sections[UNBOUNDED_PRIMITIVES], unboundedPrimitives)
+        && writeSection(file, header.sections[BVH_NODES], nodes)
+        && writeSection(file, header.sections[BVH_PRIM_INDICES], primIndices)
+        && file.seek(0)
+        && file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    if (!ok) std::cout << "Could not write snapshot " << fileName.toStdString() << std::endl;
+    return ok;
+}
+
+bool RayScene::open(const QString& fileName, bool verify) {
+    clear();
+    std::unique_ptr<QFile> file(new QFile(fileName));
+    if (!file->open(QIODevice::ReadOnly)) {
+        std::cout << "Could not open snapshot " << fileName.toStdString() << std::endl;
+        return false;
+    }
+    const qint64 fileSize = file->size();
+    const uchar* base = fileSize >= static_cast<qint64>(sizeof(SnapshotHeader)) ? file->map(0, fileSize) : nullptr;
+    if (!base) {
+        std::cout << "Could not map snapshot " << fileName.toStdString() << std::endl;
+        return false;
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION || header.sectionCount != SECTION_COUNT) {
+        std::cout << "Snapshot " << fileName.toStdString() << " has an unsupported format" << std::endl;
+        return false;
+    }
+    bool ok = mapView(positions, base, fileSize, header.sections[POSITIONS])
+        && mapView(normals, base, fileSize, header.sections[NORMALS])
+        && mapView(texCoords, base, fileSize, header.sections[TEXCOORDS])
+        && mapView(triangles, base, fileSize, header.sections[TRIANGLES])
+        && mapView(triangleObjects, base, fileSize, header.sections[TRIANGLE_OBJECTS])
+        && mapView(objects, base, fileSize, header.sections[OBJECTS])
+        && mapView(materials, base, fileSize, header.sections[MATERIALS])
+        && mapView(texturePaths, base, fileSize, header.sections[TEXTURE_PATHS])
+        && mapView(primitives, base, fileSize, header.sections[PRIMITIVES])
+        && mapView(unboundedPrimitives, base, fileSize, header.sections[UNBOUNDED_PRIMITIVES])
+        && mapView(nodes, base, fileSize, header.sections[BVH_NODES])
+        && mapView(primIndices, base, fileSize, header.sections[BVH_PRIM_INDICES])
+        && normals.size == positions.size && texCoords.size == positions.size
+        && triangleObjects.size == triangles.size && materials.size == objects.size
+        && primIndices.size + unboundedPrimitives.size == triangles.size + primitives.size
+        && (nodes.size > 0 || primIndices.size == 0);
+    if (!ok) {
+        std::cout << "Snapshot " << fileName.toStdString() << " is truncated or inconsistent" << std::endl;
+        pointToStorage();
+        return false;
+    }
+    // loadTextures reads the texture table right away, it has one entry per material and texture
+    for (unsigned int i = 0; ok && i < materials.size; ++i) ok = materials[i].texture < static_cast<int>(texturePaths.size);
+    for (unsigned int i = 0; ok && i < texturePaths.size; ++i) ok = std::memchr(texturePaths[i].fileName, '\0', sizeof(texturePaths[i].fileName)) != nullptr;
+    if (!ok || (verify && !indicesAreValid())) {
+        std::cout << "Snapshot " << fileName.toStdString() << " contains indices out of range" << std::endl;
+        pointToStorage();
+        return false;
+    }
+    snapshotFile = std::move(file);
+    loadTextures();
+    return true;
+}
+
+bool RayScene::indicesAreValid() const {
+    for (const Vec3ui& triangle : triangles) {
+        if (triangle[0] >= positions.size || triangle[1] >= positions.size || triangle[2] >= positions.size) return false;
+    }
+    for (unsigned int object : triangleObjects) {
+        if (object >= objects.size) return false;
+    }
+    for (const RayObject& object : objects) {
+        if (object.firstTriangle > triangles.size || object.triangleCount > triangles.size - object.firstTriangle) return false;
+        if (object.firstVertex > positions.size || object.vertexCount > positions.size - object.firstVertex) return false;
+    }
+    for (const RayPrimitive& primitive : primitives) {
+        if (primitive.object >= objects.size) return false;
+        if (primitive.shape == static_cast<unsigned int>(SceneObject::Shape::Mesh) || primitive.shape > static_cast<unsigned int>(SceneObject::Shape::InfinitePlane)) return false;
+    }
+    for (unsigned int primitive : unboundedPrimitives) {
+        if (primitive >= primitives.size) return false;
+    }
+    for (unsigned int entry : primIndices) {
+        if (entry >= triangles.size + primitives.size) return false;
+    }
+    // Children come after their parent, so the nodes cannot form a cycle, and no path may be deeper than the 64
+    // entries of the traversal stack of traverseBVH.
+    const unsigned int maxDepth = 63;
+    std::vector<unsigned int> depth(nodes.size, 0);
+    for (size_t i = 0; i < nodes.size; ++i) {
+        const BVHNode& node = nodes[i];
+        if (node.isLeaf()) {
+            if (node.leftFirst > primIndices.size || node.count > primIndices.size - node.leftFirst) return false;
+            continue;
+        }
+        if (node.leftFirst <= i || node.leftFirst >= nodes.size - 1 || depth[i] >= maxDepth) return false;
+        for (unsigned int child = node.leftFirst; child <= node.leftFirst + 1; ++child) depth[child] = std::max(depth[child], depth[i] + 1);
+    }
+    return true;
+}
+
+void RayScene::loadTextures() {
+    textures.clear();
+    textures.resize(texturePaths.size);
+    for (unsigned int i = 0; i < texturePaths.size; ++i) {
+        // an empty texture samples as white, so a missing file only loses the texture
+        if (!textures[i].load(texturePaths[i].fileName)) {
+            std::cout << "Could not load texture " << texturePaths[i].fileName << std::endl;
+        }
+    }
+
+    materialFeatures.resize(materials.size);
+    for (unsigned int i = 0; i < materials.size; ++i) {
+        const RayMaterial& material = materials[i];
+        const MipMappedTexture* texture = getTexture(material);
+        const Vec3f& specular = material.specularColor;
+        materialFeatures[i] = (specular.x() > 0.f || specular.y() > 0.f || specular.z() > 0.f ? MATERIAL_SPECULAR : 0u)
+                              | (material.reflectionIntensity > 0.f ? MATERIAL_REFLECTIVE : 0u)
+                              | (material.transparency > 0.f ? MATERIAL_REFRACTIVE : 0u)
+                              | (texture && texture->isValid() ? MATERIAL_TEXTURED : 0u);
+    }
+}
+
+bool RayScene::intersectEntry(unsigned int entry, const Ray<float>& ray, float& tMax, RayHit* hit) const {
+    float t;
+    if (entry >= triangles.size) {
+        unsigned int primitive = entry - triangles.size;
+        if (!primitives[primitive].intersect(ray, tMax, t)) return false;
+        tMax = t;
+        if (hit) hit->triangle = RayHit::PRIMITIVE_FLAG | primitive;
+        return true;
+    }
+    const Vec3ui& tri = triangles[entry];
+    float u, v;
+    if (ray.triangleIntersect(positions[tri[0]], positions[tri[1]], positions[tri[2]], u, v, t) && t > 0.f && t < tMax) {
+        tMax = t;
+        if (hit) {
+            hit->u = u;
+            hit->v = v;
+            hit->triangle = entry;
+        }
+        return true;
+    }
+    return false;
+}
+
+AABB RayScene::getBounds() const {
+    AABB bounds;
+    if (nodes.size == 0) return bounds;
+    bounds.grow(Vec3f(nodes[0].boundsMin[0], nodes[0].boundsMin[1], nodes[0].boundsMin[2]));
+    bounds.grow(Vec3f(nodes[0].boundsMax[0], nodes[0].boundsMax[1], nodes[0].boundsMax[2]));
+    return bounds;
+}
+
+bool RayScene::intersect(const Ray<float>& ray, RayHit& hit, unsigned int& intersectionTests) const {
+    RayCost cost;
+    bool found = intersect(ray, hit, cost);
+#pragma omp atomic
+    intersectionTests += cost.intersectionTests;
+    return found;
+}
+
+bool RayScene::occluded(const Ray<float>& ray, float maxT, unsigned int& intersectionTests) const {
+    RayCost cost;
+    bool found = occluded(ray, maxT, cost);
+#pragma omp atomic
+    intersectionTests += cost.intersectionTests;
+    return found;
+}
+
+bool RayScene::intersect(const Ray<float>& ray, RayHit& hit, RayCost& cost) const {
+    unsigned int tests = 0;
+    bool found = false;
+    for (unsigned int primitive : unboundedPrimitives) {
+        ++tests;
+        found |= intersectEntry(triangles.size + primitive, ray, hit.t, &hit);
+    }
+    if (nodes.size > 0) {
+        found |= traverseBVH(nodes.data, primIndices.data, ray, hit.t, false, [&](unsigned int entry, float& tMax) {
+            ++tests;
+            return intersectEntry(entry, ray, tMax, &hit);
+        }, &cost.nodeVisits);
+    }
+    cost.rays++;
+    cost.intersectionTests += tests;
+    return found;
+}
+
+bool RayScene::occluded(const Ray<float>& ray, float maxT, RayCost& cost) const {
+    unsigned int tests = 0;
+    bool found = false;
+    for (unsigned int primitive : unboundedPrimitives) {
+        ++tests;
+        if (intersectEntry(triangles.size + primitive, ray, maxT, nullptr)) {
+            found = true;
+            break;
+        }
+    }
+    if (!found && nodes.size > 0) {
+        found = traverseBVH(nodes.data, primIndices.data, ray, maxT, true, [&](unsigned int entry, float& tMax) {
+            ++tests;
+            return intersectEntry(entry, ray, tMax, nullptr);
+        }, &cost.nodeVisits);
+    }
+    cost.rays++;
+    cost.intersectionTests += tests;
+    return found;
+}
+
+Vec3f RayScene::interpolateNormal(const RayHit& hit) const {
+    const Vec3ui& tri = triangles[hit.triangle];
+    return ((1.f - hit.u - hit.v) * normals[tri[0]] + hit.u * normals[tri[1]] + hit.v * normals[tri[2]]).normalized();
+}
+
+template<unsigned int Features>
+RaySurface RayScene::surfaceAt(const Ray<float>& ray, const RayDifferential<float>& differential, const RayHit& hit) const {
+    RaySurface surface;
+    const float t = hit.t, u = hit.u, v = hit.v;
+    const RayMaterial& material = getMaterial(getHitObject(hit));
+    surface.material = &material;
+    const Vec3f intersectionPoint = surface.position = ray.o + t * ray.d;
+
+    Vec3f& normal = surface.normal;
+    const RayPrimitive* primitive = hit.isPrimitive() ? &primitives[hit.getPrimitive()] : nullptr;
+    if (primitive) {
+        // analytic shapes have exact normals
+        normal = surface.shadingNormal = primitive->normal(intersectionPoint);
+    } else {
+        // triangle vertices, already in world space
+        const Vec3ui& tri = getTriangle(hit.triangle);
+        const Vec3f& p0 = getPosition(tri[0]);
+        const Vec3f& p1 = getPosition(tri[1]);
+        const Vec3f& p2 = getPosition(tri[2]);
+        // normal vector of intersected triangle, used for offsets and secondary rays
+        normal = cross(p1 - p0, p2 - p0).normalized();
+        // interpolated vertex normal for lighting, like in the phong shader
+        surface.shadingNormal = interpolateNormal(hit);
+    }
+
+    // footprint of the pixel on the surface, needed for texture filtering and secondary differentials
+    Vec3f& dPdx = surface.dPdx;
+    Vec3f& dPdy = surface.dPdy;
+    if (differential.valid) differential.transfer(ray, t, normal, dPdx, dPdy);
+
+    // material colors, modulated by the texture if there is one
+    Vec3f& ambientColor = surface.ambientColor = material.ambientColor;
+    Vec3f& diffuseColor = surface.diffuseColor = material.diffuseColor;
+    const MipMappedTexture* texture = getTexture(material);
+    if ((Features & MATERIAL_TEXTURED) && texture && texture->isValid()) {
+        float texU, texV, lod = 0.f;
+        if (primitive) {
+            primitive->texCoord(intersectionPoint, texU, texV);
+            if (differential.valid) {
+                // finite differences over the footprint, wrapped for the seam of the sphere mapping
+                auto wrap = [](float delta) { return delta - std::round(delta); };
+                float uX, vX, uY, vY;
+                primitive->texCoord(intersectionPoint + dPdx, uX, vX);
+                primitive->texCoord(intersectionPoint + dPdy, uY, vY);
+                lod = texture->computeLod(wrap(uX - texU), wrap(vX - texV), wrap(uY - texU), wrap(vY - texV));
+            }
+        } else {
+            const Vec3ui& tri = getTriangle(hit.triangle);
+            const Vec3f& p0 = getPosition(tri[0]);
+            const Vec3f& p1 = getPosition(tri[1]);
+            const Vec3f& p2 = getPosition(tri[2]);
+            const auto& uv0 = getTexCoord(tri[0]);
+            const auto& uv1 = getTexCoord(tri[1]);
+            const auto& uv2 = getTexCoord(tri[2]);
+            // u and v are the weights of p1 and p2
+            texU = uv0.u + u * (uv1.u - uv0.u) + v * (uv2.u - uv0.u);
+            texV = uv0.v + u * (uv1.v - uv0.v) + v * (uv2.v - uv0.v);
+
+            if (differential.valid) {
+                // express the differentials of the hit point in barycentric coordinates of the triangle
+                Vec3f e1 = p1 - p0, e2 = p2 - p0;
+                float a = e1 * e1, b = e1 * e2, c = e2 * e2;
+                float det = a * c - b * b;
+                if (std::abs(det) > 1e-12f) {
+                    float dudx = (c * (dPdx * e1) - b * (dPdx * e2)) / det;
+                    float dvdx = (a * (dPdx * e2) - b * (dPdx * e1)) / det;
+                    float dudy = (c * (dPdy * e1) - b * (dPdy * e2)) / det;
+                    float dvdy = (a * (dPdy * e2) - b * (dPdy * e1)) / det;
+                    lod = texture->computeLod(
+                            dudx * (uv1.u - uv0.u) + dvdx * (uv2.u - uv0.u), dudx * (uv1.v - uv0.v) + dvdx * (uv2.v - uv0.v),
+                            dudy * (uv1.u - uv0.u) + dvdy * (uv2.u - uv0.u), dudy * (uv1.v - uv0.v) + dvdy * (uv2.v - uv0.v));
+                }
+            }
+        }
+        Vec3f texel = texture->sample(texU, texV, lod);
+        ambientColor = Vec3f(ambientColor.x() * texel.x(), ambientColor.y() * texel.y(), ambientColor.z() * texel.z());
+        diffuseColor = Vec3f(diffuseColor.x() * texel.x(), diffuseColor.y() * texel.y(), diffuseColor.z() * texel.z());
+    }
+    return surface;
+}
+
+template RaySurface RayScene::surfaceAt<0>(const Ray<float>&, const RayDifferential<float>&, const RayHit&) const;
+template RaySurface RayScene::surfaceAt<MATERIAL_TEXTURED>(const Ray<float>&, const RayDifferential<float>&, const RayHit&) const;
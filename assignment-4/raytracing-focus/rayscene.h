@@ -0,0 +1,204 @@
+//
+// Flattened world-space scene for the ray tracer, can be stored as a memory-mapped snapshot.
+//
+
+#ifndef UEBUNG_04_RAYSCENE_H
+#define UEBUNG_04_RAYSCENE_H
+
+#include <memory>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+#include "vec3.h"
+#include "ray.h"
+#include "bvh.h"
+#include "primitive.h"
+#include "texture.h"
+#include "trianglemesh.h"
+#include "sceneobject.h"
+
+// Material of a scene object as plain data.
+struct RayMaterial {
+    Vec3f ambientColor;
+    Vec3f diffuseColor;
+    Vec3f specularColor;
+    float shininess;
+    float reflectionIntensity;
+    float transparency;
+    float refractiveIndex;
+    int texture; // index into the textures of the RayScene, -1 if the object is not textured
+};
+
+// Parts of the shading a material needs. The ray tracer instantiates one shading kernel per combination, so a kernel
+// contains no code for features its materials do not have.
+enum MaterialFeature : unsigned int {
+    MATERIAL_SPECULAR = 1,   // Phong highlight
+    MATERIAL_REFLECTIVE = 2, // mirror rays
+    MATERIAL_REFRACTIVE = 4, // refraction rays
+    MATERIAL_TEXTURED = 8,   // texture lookup with mip map level from the ray differentials
+    MATERIAL_FEATURE_COMBINATIONS = 16
+};
+
+// Range of triangles and vertices that belong to one SceneObject, both empty for analytic shapes.
+struct RayObject {
+    unsigned int firstTriangle, triangleCount;
+    unsigned int firstVertex, vertexCount;
+};
+
+// File name of a texture, textures themselves are not part of the snapshot.
+struct RayTexturePath {
+    char fileName[256];
+};
+
+struct RayHit {
+    static constexpr unsigned int NO_HIT = 0xffffffffu;
+    static constexpr unsigned int PRIMITIVE_FLAG = 0x80000000u;
+
+    float t, u, v; // u and v are the barycentric weights of the second and third vertex, unused for primitives
+    unsigned int triangle; // triangle index, or PRIMITIVE_FLAG | primitive index for analytic shapes
+
+    bool isPrimitive() const { return triangle != NO_HIT && (triangle & PRIMITIVE_FLAG); }
+    unsigned int getPrimitive() const { return triangle & ~PRIMITIVE_FLAG; }
+};
+
+// Geometry and material at a hit point.
+struct RaySurface {
+    Vec3f position;
+    Vec3f normal;        // geometric normal, used for offsets and secondary rays
+    Vec3f shadingNormal; // interpolated vertex normal, exact normal for analytic shapes
+    Vec3f dPdx, dPdy;    // footprint of the pixel on the surface, zero without ray differentials
+    Vec3f ambientColor, diffuseColor; // material colors, modulated by the texture if there is one
+    const RayMaterial* material;
+};
+
+// Traversal work of one or more rays, summed per pixel for the cost heatmap of the ray tracer.
+struct RayCost {
+    unsigned int rays{};
+    unsigned int nodeVisits{};
+    unsigned int intersectionTests{}; // triangles and analytic shapes
+};
+
+// Read-only array that either points into a std::vector or into the mapped snapshot file.
+template<typename T>
+struct ArrayView {
+    const T* data{nullptr};
+    size_t size{0};
+
+    const T& operator[](size_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+};
+
+class RayScene {
+public:
+    RayScene() = default;
+    RayScene(const RayScene& other) = delete;
+    RayScene& operator= (const RayScene& other) = delete;
+
+    // copies all objects to world space and builds the BVH
+    void build(const std::vector<SceneObject>& objects);
+    // writes the scene to a snapshot file. Returns false on failure.
+    bool save(const QString& fileName) const;
+    // Maps a snapshot file into memory, the data is used in place. Only the header, the section bounds and the
+    // material and texture tables are checked, so opening does not depend on the number of triangles. verify also
+    // checks every index, which reads the whole file; without it a damaged file can crash the tracer. Returns false
+    // on failure.
+    bool open(const QString& fileName, bool verify = false);
+    void clear();
+
+    bool isEmpty() const { return triangles.size == 0; }
+    bool isMapped() const { return snapshotFile != nullptr; }
+
+    // closest hit along the ray, hit.t has to be initialized with the maximal distance
+    bool intersect(const Ray<float>& ray, RayHit& hit, unsigned int& intersectionTests) const;
+    // true if anything is hit closer than maxT
+    bool occluded(const Ray<float>& ray, float maxT, unsigned int& intersectionTests) const;
+    // the same, adding the work to cost instead of a shared counter
+    bool intersect(const Ray<float>& ray, RayHit& hit, RayCost& cost) const;
+    bool occluded(const Ray<float>& ray, float maxT, RayCost& cost) const;
+
+    unsigned int getNumTriangles() const { return triangles.size; }
+    unsigned int getNumVertices() const { return positions.size; }
+    unsigned int getNumObjects() const { return objects.size; }
+    unsigned int getNumBVHNodes() const { return nodes.size; }
+    unsigned int getNumPrimitives() const { return primitives.size; }
+    // bounds of the BVH, unbounded planes are not included
+    AABB getBounds() const;
+
+    const Vec3ui& getTriangle(unsigned int triangle) const { return triangles[triangle]; }
+    const Vec3f& getPosition(unsigned int vertex) const { return positions[vertex]; }
+    const Vec3f& getNormal(unsigned int vertex) const { return normals[vertex]; }
+    const TriangleMesh::TexCoord& getTexCoord(unsigned int vertex) const { return texCoords[vertex]; }
+    unsigned int getObjectIndex(unsigned int triangle) const { return triangleObjects[triangle]; }
+    const RayPrimitive& getPrimitive(unsigned int primitive) const { return primitives[primitive]; }
+    unsigned int getHitObject(const RayHit& hit) const {
+        return hit.isPrimitive() ? primitives[hit.getPrimitive()].object : triangleObjects[hit.triangle];
+    }
+    const RayObject& getObject(unsigned int object) const { return objects[object]; }
+    const RayMaterial& getMaterial(unsigned int object) const { return materials[object]; }
+    const MipMappedTexture* getTexture(const RayMaterial& material) const {
+        return material.texture >= 0 ? &textures[material.texture] : nullptr;
+    }
+    // MaterialFeature flags of the material of an object
+    unsigned int getMaterialFeatures(unsigned int object) const { return materialFeatures[object]; }
+
+    // interpolated vertex normal at a triangle hit
+    Vec3f interpolateNormal(const RayHit& hit) const;
+    // normals, texture lookup and material at a hit of the ray
+    RaySurface surfaceAt(const Ray<float>& ray, const RayDifferential<float>& differential, const RayHit& hit) const {
+        return surfaceAt<MATERIAL_TEXTURED>(ray, differential, hit);
+    }
+    // the same for a hit whose material features are known, the texture is only sampled with MATERIAL_TEXTURED
+    template<unsigned int Features>
+    RaySurface surfaceAt(const Ray<float>& ray, const RayDifferential<float>& differential, const RayHit& hit) const;
+
+private:
+    ArrayView<Vec3f> positions;
+    ArrayView<Vec3f> normals;
+    ArrayView<TriangleMesh::TexCoord> texCoords;
+    ArrayView<Vec3ui> triangles;
+    ArrayView<unsigned int> triangleObjects;
+    ArrayView<RayObject> objects;
+    ArrayView<RayMaterial> materials;
+    ArrayView<RayTexturePath> texturePaths;
+    ArrayView<RayPrimitive> primitives;
+    ArrayView<unsigned int> unboundedPrimitives; // infinite planes, tested outside of the BVH
+    // BVH over triangles and bounded primitives. Entries of primIndices below the triangle count are triangles,
+    // the others are primitive indices offset by the triangle count.
+    ArrayView<BVHNode> nodes;
+    ArrayView<unsigned int> primIndices;
+
+    // backing storage after build()
+    struct {
+        std::vector<Vec3f> positions;
+        std::vector<Vec3f> normals;
+        std::vector<TriangleMesh::TexCoord> texCoords;
+        std::vector<Vec3ui> triangles;
+        std::vector<unsigned int> triangleObjects;
+        std::vector<RayObject> objects;
+        std::vector<RayMaterial> materials;
+        std::vector<RayTexturePath> texturePaths;
+        std::vector<RayPrimitive> primitives;
+        std::vector<unsigned int> unboundedPrimitives;
+        std::vector<BVHNode> nodes;
+        std::vector<unsigned int> primIndices;
+    } storage;
+    // backing storage after open(), stays open as long as the data is used
+    std::unique_ptr<QFile> snapshotFile;
+
+    std::vector<MipMappedTexture> textures;
+    // derived from the materials and the loaded textures, not part of the snapshot
+    std::vector<unsigned int> materialFeatures;
+
+    // loads the textures and sets the material features, which depend on the textures found
+    void loadTextures();
+    void pointToStorage();
+    // true if every index in the arrays is in range and the BVH fits the traversal stack, see open
+    bool indicesAreValid() const;
+    // tests one BVH entry (triangle or bounded primitive) and shrinks tMax on a hit
+    bool intersectEntry(unsigned int entry, const Ray<float>& ray, float& tMax, RayHit* hit) const;
+};
+
+#endif //UEBUNG_04_RAYSCENE_H
@@ -0,0 +1,344 @@
+//
+// Whitted-style ray tracer working on a RayScene. Used by OpenGLView and the headless renderer.
+//
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+#include "raytracer.h"
+#include "utilities.h"
+
+static uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+Vec3f RayTracer::traceRay(const Ray<float>& ray, const RayDifferential<float>& differential, int recursion_depth, RayCost& cost) const {
+    // 1. Termination condition: If depth is zero, then stop shooting and tracing rays
+    if (recursion_depth <= 0) {
+        return Vec3f(0.0f, 0.0f, 0.0f); // Schwarz
+    }
+
+    // 2. look for next intersection
+    RayHit hit;
+    hit.t = std::numeric_limits<float>::max(); // intiialize to possible maximum
+
+    // If no object hit, show black background color
+    if (!scene.intersect(ray, hit, cost)) {
+        return Vec3f(0.0f, 0.0f, 0.0f);
+    }
+
+    return shade(ray, differential, hit, recursion_depth, cost);
+}
+
+const RayTracer::ShadeKernel RayTracer::shadeKernels[MATERIAL_FEATURE_COMBINATIONS] = {
+        &RayTracer::shadeKernel<0>, &RayTracer::shadeKernel<1>, &RayTracer::shadeKernel<2>, &RayTracer::shadeKernel<3>,
+        &RayTracer::shadeKernel<4>, &RayTracer::shadeKernel<5>, &RayTracer::shadeKernel<6>, &RayTracer::shadeKernel<7>,
+        &RayTracer::shadeKernel<8>, &RayTracer::shadeKernel<9>, &RayTracer::shadeKernel<10>, &RayTracer::shadeKernel<11>,
+        &RayTracer::shadeKernel<12>, &RayTracer::shadeKernel<13>, &RayTracer::shadeKernel<14>, &RayTracer::shadeKernel<15>,
+};
+
+Vec3f RayTracer::shade(const Ray<float>& ray, const RayDifferential<float>& differential, const RayHit& hit, int recursion_depth, RayCost& cost) const {
+    const ShadeKernel kernel = shadeKernels[scene.getMaterialFeatures(scene.getHitObject(hit))];
+    return (this->*kernel)(ray, differential, hit, recursion_depth, cost);
+}
+
+template<unsigned int Features>
+Vec3f RayTracer::shadeKernel(const Ray<float>& ray, const RayDifferential<float>& differential, const RayHit& hit, int recursion_depth, RayCost& cost) const {
+    // 3. calculate intersection point, normals and material
+    const RaySurface surface = scene.surfaceAt<Features & MATERIAL_TEXTURED>(ray, differential, hit);
+    const RayMaterial& material = *surface.material;
+    const Vec3f& intersectionPoint = surface.position;
+    const Vec3f& normal = surface.normal;
+    const Vec3f& shadingNormal = surface.shadingNormal;
+    const Vec3f& dPdx = surface.dPdx;
+    const Vec3f& dPdy = surface.dPdy;
+    const Vec3f& ambientColor = surface.ambientColor;
+
+    // 4. Shadow Test
+    // offset iwth epsilon, so it does not intersect it self
+    const float eps = 1e-3f;
+    Vec3f lightPos = light.position;
+    Vec3f lightDir = (lightPos - intersectionPoint).normalized();
+    float lightDist = (lightPos - intersectionPoint).length();
+
+    // shoot shadow ray to light source
+    Ray<float> shadowRay = Ray<float>::withDirection(intersectionPoint + normal * eps, lightDir);
+
+    // If object is hit before the light, poiint is in a shadow
+    float S_i = 1.0f; // 1 = lit, 0 = not so lit
+    if (scene.occluded(shadowRay, lightDist, cost)) {
+        S_i = 0.0f;
+    }
+
+    // 5. calculate phong lighting at intersection
+    Vec3f ambient = ambientColor * light.ambientIntensity;
+
+    // diffuse
+    float NdotL = std::max(0.0f, dot(shadingNormal, lightDir));
+    Vec3f diffuse = surface.diffuseColor * NdotL * light.lightIntensity;
+    
+    // specular
+    Vec3f specular(0.0f);
+    if (Features & MATERIAL_SPECULAR) {
+        Vec3f viewDir = (ray.o - intersectionPoint).normalized();
+        Vec3f reflectDir = (2.0f * shadingNormal * (shadingNormal * lightDir) - lightDir).normalized();
+        float RdotV = std::max(0.0f, dot(reflectDir, viewDir));
+        specular = material.specularColor * std::pow(RdotV, material.shininess) * light.lightIntensity;
+    }
+
+    // combine ambient, diffuse and specular color with the shadow factor to have the phong Color
+    Vec3f phongColor = ambient + S_i * (diffuse + specular);
+
+    // 6. recursive
+    float k_r = material.reflectionIntensity; // intensity of reflection (I)
+    if (Features & MATERIAL_REFLECTIVE) {
+        // generate reflection by mirroring the incoming ray
+        Vec3f mirrorDir = ray.d - 2.0f * (ray.d * normal) * normal;
+        Ray<float> reflectionRay = Ray<float>::withDirection(intersectionPoint + normal * eps, mirrorDir);
+        Vec3f reflectionColor = traceRay(reflectionRay, differential.reflected(dPdx, dPdy, normal), recursion_depth - 1, cost); //trace recursively
+
+        // add reflection into the phong  Color
+        phongColor += k_r * reflectionColor;
+    }
+
+    // 7. transparency
+    float k_t = material.transparency; // transparency factor
+    if (Features & MATERIAL_REFRACTIVE) {
+        float refractionIndex = material.refractiveIndex; // refractive index of the object
+        Vec3f refractDir = refract(ray.d, normal, refractionIndex);// refraction direction
+        // if the refractDirection is valid, acually calculated the color and add the color value
+        if (refractDir.length() > 0) {
+            // generate refraction ray with offset
+            Ray<float> refractionRay = Ray<float>::withDirection(intersectionPoint - normal * eps, refractDir);
+            // recursive tracing the refraction ray
+            RayDifferential<float> refractionDifferential = differential.refracted(dPdx, dPdy, ray.d, refractDir, normal, refractionIndex);
+            Vec3f refractionColor = traceRay(refractionRay, refractionDifferential, recursion_depth - 1, cost);
+
+            // add transparency part of coloring
+            phongColor += k_t * refractionColor;
+        }
+    }
+
+    return phongColor;
+}
+
+Vec3f RayTracer::refract(const Vec3f& incident, const Vec3f& normal, float eta) {
+    float NdotI = dot(normal, incident);
+    // discriminant for refraction equation
+    float k = 1.0f - eta * eta * (1.0f - NdotI * NdotI);
+
+    // if negative/zero, no refraction occurs
+    if (k <= 0.0f) {
+        return Vec3f(0.0f, 0.0f, 0.0f); // Totale interne Reflexion
+    }
+    else {
+        // refracted direction 
+        // https://registry.khronos.org/OpenGL-Refpages/gl4/html/refract.xhtml
+        return eta * incident - (eta * NdotI + sqrt(k)) * normal;
+    }
+}
+
+std::vector<Vec3f> RayTracer::render(unsigned int w, unsigned int h, const QMatrix4x4& projection, const QMatrix4x4& modelView,
+                                     const std::vector<RayHit>* primaryHits, std::vector<Vec3f>* primaryPositions) {
+    // initalization
+    size_t viewPortSize = w * h;
+    std::vector<Vec3f> pictureRGB(viewPortSize);
+    if (primaryPositions) primaryPositions->resize(viewPortSize);
+    pixelCosts.assign(recordCost ? viewPortSize : 0, PixelCost());
+    unsigned int intersectionTests = 0, hits = 0;
+    auto clockStart = std::chrono::system_clock::now();
+    if (showProgress) {
+        std::cout << "   10   20   30   40   50   60   70   80   90  100" << std::endl;
+        std::cout << "====|====|====|====|====|====|====|====|====|====|" << std::endl;
+    }
+    // iterate over all pixel
+    unsigned int pixelCounter = 0;
+    // same as QVector3D::unproject with QRect(0, 0, w, h), but the inverse is only computed once
+    const QMatrix4x4 inverse = (projection * modelView).inverted();
+    auto primaryRay = [&](float x, float y) {
+        QVector4D eye(2.f * x / w - 1.f, 2.f * y / h - 1.f, -3.f, 1.f), end(2.f * x / w - 1.f, 2.f * y / h - 1.f, 1.f, 1.f);
+        eye = inverse * eye;
+        end = inverse * end;
+        return Ray<float>(QVector3DToVec3f(eye.toVector3DAffine()), QVector3DToVec3f(end.toVector3DAffine()));
+    };
+    auto pixelRay = [&](size_t pixel, RayDifferential<float>& differential) {
+        float x = pixel % w + jitterX, y = pixel / w + jitterY;
+        // rays through pixel centers by default, where the rasterizer samples as well
+        Ray<float> ray = primaryRay(x, y);
+
+        // differentials from the rays through the neighbouring pixels
+        Ray<float> rayX = primaryRay(x + 1.f, y), rayY = primaryRay(x, y + 1.f);
+        differential.dOdx = rayX.o - ray.o;
+        differential.dDdx = rayX.d - ray.d;
+        differential.dOdy = rayY.o - ray.o;
+        differential.dDdy = rayY.d - ray.d;
+        differential.valid = true;
+        return ray;
+    };
+
+    // 1. primary hits of all pixels
+    std::vector<RayHit> pixelHits(viewPortSize);
+    #pragma omp parallel for schedule(dynamic) reduction(+:intersectionTests)
+    for (int y = 0; y < static_cast<int>(h); y++) {
+        for (int x = 0; x < static_cast<int>(w); x++) {
+            // get pixel index for addressing pictureRGB array
+            size_t pixel = y * w + x;
+            const uint64_t start = recordCost ? readCycleCounter() : 0;
+            RayCost cost;
+            RayDifferential<float> differential;
+            Ray<float> ray = pixelRay(pixel, differential);
+
+            RayHit& hit = pixelHits[pixel];
+            if (!primaryHits) {
+                hit.t = std::numeric_limits<float>::max();
+                if (maxDepth <= 0 || !scene.intersect(ray, hit, cost)) hit.triangle = RayHit::NO_HIT;
+            } else {
+                hit = (*primaryHits)[pixel];
+                if (hit.isPrimitive()) {
+                    // analytic shapes are rasterized as meshes, the exact shape can be missed near the silhouette
+                    if (!scene.getPrimitive(hit.getPrimitive()).intersect(ray, std::numeric_limits<float>::max(), hit.t)) {
+                        hit.t = std::numeric_limits<float>::max();
+                        if (!scene.intersect(ray, hit, cost)) hit.triangle = RayHit::NO_HIT;
+                    }
+                } else if (hit.triangle != RayHit::NO_HIT) {
+                    // the hit comes from rasterization, only the distance along the primary ray is missing
+                    const Vec3ui& tri = scene.getTriangle(hit.triangle);
+                    Vec3f p = (1.f - hit.u - hit.v) * scene.getPosition(tri[0]) + hit.u * scene.getPosition(tri[1]) + hit.v * scene.getPosition(tri[2]);
+                    hit.t = (p - ray.o) * ray.d;
+                }
+            }
+            if (hit.triangle == RayHit::NO_HIT) {
+                pictureRGB[pixel] = Vec3f(0.0f, 0.0f, 0.0f);
+                if (primaryPositions) (*primaryPositions)[pixel] = Vec3f(std::numeric_limits<float>::infinity());
+            } else if (primaryPositions) {
+                (*primaryPositions)[pixel] = ray.o + hit.t * ray.d;
+            }
+            intersectionTests += cost.intersectionTests;
+            if (recordCost) {
+                pixelCosts[pixel].traversal = cost;
+                pixelCosts[pixel].cycles = readCycleCounter() - start;
+            }
+        }
+    }
+
+    // 2. sort the hits into one queue per shading kernel
+    std::vector<unsigned int> queues[MATERIAL_FEATURE_COMBINATIONS];
+    for (size_t pixel = 0; pixel < viewPortSize; ++pixel) {
+        if (pixelHits[pixel].triangle == RayHit::NO_HIT) continue;
+        queues[scene.getMaterialFeatures(scene.getHitObject(pixelHits[pixel]))].push_back(pixel);
+        hits++;
+    }
+
+    // 3. shade every queue with its kernel. Secondary hits pick their kernel in shade().
+    for (unsigned int features = 0; features < MATERIAL_FEATURE_COMBINATIONS; ++features) {
+        const std::vector<unsigned int>& queue = queues[features];
+        const ShadeKernel kernel = shadeKernels[features];
+        #pragma omp parallel for schedule(dynamic, 64) reduction(+:intersectionTests)
+        for (int i = 0; i < static_cast<int>(queue.size()); i++) {
+            const size_t pixel = queue[i];
+            const uint64_t start = recordCost ? readCycleCounter() : 0;
+            RayCost cost;
+            RayDifferential<float> differential;
+            Ray<float> ray = pixelRay(pixel, differential);
+            pictureRGB[pixel] = (this->*kernel)(ray, differential, pixelHits[pixel], maxDepth, cost);
+            intersectionTests += cost.intersectionTests;
+            if (recordCost) {
+                PixelCost& pixelCost = pixelCosts[pixel];
+                pixelCost.traversal.rays += cost.rays;
+                pixelCost.traversal.nodeVisits += cost.nodeVisits;
+                pixelCost.traversal.intersectionTests += cost.intersectionTests;
+                pixelCost.cycles += readCycleCounter() - start;
+            }
+
+            // cout "." every 1/50 of all pixels that hit something
+
+            if (!showProgress) continue;
+            #pragma omp critical
+            {
+                pixelCounter++;
+                if (hits >= 50 && pixelCounter % (hits / 50) == 0) std::clog << ".";
+            };
+        }
+    }
+    auto clockEnd = std::chrono::system_clock::now();
+    auto passedTime = clockEnd - clockStart;
+    lastIntersectionTests = intersectionTests;
+    if (showProgress) std::cout << std::endl << "finished. tests: " << intersectionTests << ", hits: " << hits << ", ms: "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(passedTime).count() << std::endl;
+    return pictureRGB;
+}
+
+std::vector<Vec3f> RayTracer::costHeatmap(const std::vector<PixelCost>& costs, CostMetric metric) {
+    std::vector<float> values(costs.size());
+    for (size_t i = 0; i < costs.size(); ++i) {
+        const PixelCost& cost = costs[i];
+        switch (metric) {
+            case CostMetric::Rays: values[i] = cost.traversal.rays; break;
+            case CostMetric::NodeVisits: values[i] = cost.traversal.nodeVisits; break;
+            case CostMetric::IntersectionTests: values[i] = cost.traversal.intersectionTests; break;
+            case CostMetric::Cycles: values[i] = static_cast<float>(cost.cycles); break;
+        }
+    }
+    if (values.empty()) return {};
+
+    // scaled to the 99th percentile, a few extreme pixels would leave everything else blue
+    std::vector<float> sorted = values;
+    auto percentile = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+    std::nth_element(sorted.begin(), percentile, sorted.end());
+    const float maximum = std::max(*percentile, 1.f);
+
+    // blue, cyan, green, yellow, red
+    static const Vec3f ramp[5] = {Vec3f(0.f, 0.f, 1.f), Vec3f(0.f, 1.f, 1.f), Vec3f(0.f, 1.f, 0.f), Vec3f(1.f, 1.f, 0.f), Vec3f(1.f, 0.f, 0.f)};
+    std::vector<Vec3f> heatmap(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        float x = std::min(values[i] / maximum, 1.f) * 4.f;
+        unsigned int segment = std::min(static_cast<unsigned int>(x), 3u);
+        float f = x - segment;
+        heatmap[i] = (1.f - f) * ramp[segment] + f * ramp[segment + 1];
+    }
+    return heatmap;
+}
+
+std::vector<unsigned char> RayTracer::traceShadowMask(const std::vector<float>& depth, unsigned int w, unsigned int h,
+                                                      const QMatrix4x4& projection, const QMatrix4x4& modelView) const {
+    std::vector<unsigned char> mask(w * h, 255);
+    const QMatrix4x4 inverse = (projection * modelView).inverted();
+    const Vec3f cameraPos = QVector3DToVec3f(modelView.inverted().map(QVector3D(0.f, 0.f, 0.f)));
+    unsigned int intersectionTests = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:intersectionTests)
+    for (int y = 0; y < static_cast<int>(h); y++) {
+        for (int x = 0; x < static_cast<int>(w); x++) {
+            size_t pixel = y * w + x;
+            if (depth[pixel] >= 1.f) continue; // background
+            // surface position from window coordinates
+            QVector4D ndc(2.f * (x + 0.5f) / w - 1.f, 2.f * (y + 0.5f) / h - 1.f, 2.f * depth[pixel] - 1.f, 1.f);
+            Vec3f position = QVector3DToVec3f((inverse * ndc).toVector3DAffine());
+
+            // without a normal, the origin is moved towards the camera and the light to leave the surface.
+            // The depth buffer gets less precise with distance, so does the offset.
+            Vec3f toLight = light.position - position;
+            float lightDist = toLight.length();
+            Vec3f lightDir = toLight / lightDist;
+            float eps = 1e-3f * (1.f + (cameraPos - position).length());
+            Vec3f origin = position + eps * ((cameraPos - position).normalized() + lightDir);
+
+            Ray<float> shadowRay = Ray<float>::withDirection(origin, lightDir);
+            if (scene.occluded(shadowRay, (light.position - origin).length(), intersectionTests)) mask[pixel] = 0;
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,72 @@
+//
+// Whitted-style ray tracer working on a RayScene. Used by OpenGLView and the headless renderer.
+//
+
+#ifndef UEBUNG_04_RAYTRACER_H
+#define UEBUNG_04_RAYTRACER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QMatrix4x4>
+
+#include "vec3.h"
+#include "ray.h"
+#include "light.h"
+#include "rayscene.h"
+
+// Work spent on one pixel by RayTracer::render, primary ray and shading together.
+struct PixelCost {
+    RayCost traversal;
+    uint64_t cycles{}; // time stamp counter, nanoseconds on processors without one
+};
+
+enum class CostMetric { Rays, NodeVisits, IntersectionTests, Cycles };
+
+class RayTracer {
+public:
+    RayTracer(const RayScene& scene, const Light& light) : scene(scene), light(light) {}
+
+    // renders width x height pixels as seen with the given matrices. Rows are stored from bottom to top like in OpenGL.
+    // With primaryHits (one per pixel, e.g. from a rasterized visibility buffer) only secondary rays are traced,
+    // t of these hits is ignored. primaryPositions receives the world position of the primary hits, infinity for
+    // pixels that show the background.
+    std::vector<Vec3f> render(unsigned int width, unsigned int height, const QMatrix4x4& projection, const QMatrix4x4& modelView,
+                              const std::vector<RayHit>* primaryHits = nullptr, std::vector<Vec3f>* primaryPositions = nullptr);
+
+    // One shadow ray per pixel of a depth buffer (window depth in [0,1] as read with glReadPixels) that was rendered
+    // with the given matrices. Returns 255 for lit pixels and the background and 0 for pixels in shadow.
+    std::vector<unsigned char> traceShadowMask(const std::vector<float>& depth, unsigned int width, unsigned int height,
+                                               const QMatrix4x4& projection, const QMatrix4x4& modelView) const;
+
+    // false-color image of one cost metric, blue for cheap and red for the most expensive pixels
+    static std::vector<Vec3f> costHeatmap(const std::vector<PixelCost>& costs, CostMetric metric);
+
+    Vec3f traceRay(const Ray<float>& ray, const RayDifferential<float>& differential, int recursion_depth, RayCost& cost) const;
+    // color at a known hit of the ray, traces the secondary rays. Runs the shading kernel for the material of the hit.
+    Vec3f shade(const Ray<float>& ray, const RayDifferential<float>& differential, const RayHit& hit, int recursion_depth, RayCost& cost) const;
+
+    int maxDepth = 5;
+    bool showProgress = true;
+    // sample position inside the pixel for primary rays, changed per frame for temporal anti-aliasing
+    float jitterX = 0.5f, jitterY = 0.5f;
+    unsigned int lastIntersectionTests = 0;
+    // record the work per pixel in pixelCosts during render()
+    bool recordCost = false;
+    std::vector<PixelCost> pixelCosts;
+
+private:
+    const RayScene& scene;
+    Light light;
+
+    static Vec3f refract(const Vec3f& incident, const Vec3f& normal, float eta);
+
+    // shade() for materials with the given MaterialFeature flags, without tests or work for the other features
+    template<unsigned int Features>
+    Vec3f shadeKernel(const Ray<float>& ray, const RayDifferential<float>& differential, const RayHit& hit, int recursion_depth, RayCost& cost) const;
+    using ShadeKernel = Vec3f (RayTracer::*)(const Ray<float>&, const RayDifferential<float>&, const RayHit&, int, RayCost&) const;
+    // indexed by the feature flags
+    static const ShadeKernel shadeKernels[MATERIAL_FEATURE_COMBINATIONS];
+};
+
+#endif //UEBUNG_04_RAYTRACER_H
@@ -0,0 +1,130 @@
+//
+// Draw packets of one frame, sorted by a key so that consecutive draws share program, material and mesh.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "renderqueue.h"
+#include "renderstate.h"
+#include "sceneobject.h"
+
+namespace {
+    const unsigned int PROGRAM_BITS = 10, MATERIAL_BITS = 12, VERTEX_ARRAY_BITS = 16, DEPTH_BITS = 24;
+    const unsigned int PASS_SHIFT = 62;
+
+    // IDs beyond the field only cost sorting quality, the packet keeps the real values
+    uint64_t field(uint64_t value, unsigned int bits) {
+        return value & ((uint64_t(1) << bits) - 1);
+    }
+
+    // The bits of a non-negative float grow with its value, the upper ones are a coarse but monotonic depth.
+    uint64_t quantizeDepth(float depth) {
+        depth = std::max(depth, 0.f);
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (31 - DEPTH_BITS);
+    }
+
+    bool isStatic(const DrawPacket& packet) {
+        return packet.object && packet.object->staticGeometry.isValid();
+    }
+
+    bool sameBatch(const DrawPacket& first, const DrawPacket& packet) {
+        return isStatic(packet) && packet.program == first.program
+               && packet.object->materialIndex == first.object->materialIndex
+               && packet.object->staticGeometry.vertexArray == first.object->staticGeometry.vertexArray;
+    }
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, unsigned int material, GLuint vertexArray, float depth) {
+    const uint64_t state = field(program, PROGRAM_BITS) << (MATERIAL_BITS + VERTEX_ARRAY_BITS)
+                           | field(material, MATERIAL_BITS) << VERTEX_ARRAY_BITS
+                           | field(vertexArray, VERTEX_ARRAY_BITS);
+    const uint64_t distance = quantizeDepth(depth);
+    uint64_t key = static_cast<uint64_t>(pass) << PASS_SHIFT;
+    if (pass == RenderPass::Transparent) {
+        // blending needs the order, so the depth decides before the state does
+        const uint64_t farToNear = field(~distance, DEPTH_BITS);
+        key |= farToNear << (PROGRAM_BITS + MATERIAL_BITS + VERTEX_ARRAY_BITS) | state;
+    } else {
+        key |= state << DEPTH_BITS | distance;
+    }
+    return key;
+}
+
+void RenderQueue::clear() {
+    packets.clear();
+    order.clear();
+}
+
+// Least significant digit first, 8 bits per pass. A digit that is the same for all keys is skipped, which in a
+// typical frame leaves only a few passes.
+void RenderQueue::sort() {
+    const size_t n = packets.size();
+    order.resize(n);
+    for (size_t i = 0; i < n; ++i) order[i] = SortEntry{packets[i].key, static_cast<uint32_t>(i)};
+    if (n < 2) return;
+    scratch.resize(n);
+    for (unsigned int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (const SortEntry& entry : order) offsets[(entry.key >> shift) & 0xFF]++;
+        if (offsets[(order[0].key >> shift) & 0xFF] == n) continue;
+        size_t sum = 0;
+        for (size_t& offset : offsets) {
+            const size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for (const SortEntry& entry : order) scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+        order.swap(scratch);
+    }
+}
+
+unsigned int RenderQueue::execute(RenderState& state) {
+    unsigned int triangles = 0;
+    for (size_t i = 0; i < order.size();) {
+        const DrawPacket& packet = packets[order[i].packet];
+        if (packet.program != state.getCurrentProgram()) state.setCurrentProgram(packet.program);
+        if (isStatic(packet)) {
+            size_t end = i + 1;
+            while (end < order.size() && sameBatch(packet, packets[order[end].packet])) end++;
+            triangles += drawBatch(state, i, end);
+            i = end;
+            continue;
+        }
+        state.pushModelViewMatrix();
+        state.getCurrentModelViewMatrix() = packet.modelView;
+        triangles += packet.object ? packet.object->drawSubmitted(state) : packet.mesh->drawUnculled(state);
+        state.popModelViewMatrix();
+        ++i;
+    }
+    return triangles;
+}
+
+unsigned int RenderQueue::drawBatch(RenderState& state, size_t begin, size_t end) {
+    unsigned int triangles = 0;
+    counts.clear();
+    indexOffsets.clear();
+    baseVertices.clear();
+    for (size_t i = begin; i < end; ++i) {
+        const DrawPacket& packet = packets[order[i].packet];
+        const GeometryRange& geometry = packet.object->staticGeometry;
+        counts.push_back(geometry.indexCount);
+        indexOffsets.push_back(geometry.indexOffset());
+        baseVertices.push_back(geometry.baseVertex);
+        triangles += geometry.indexCount / 3;
+        // bounding box and normals are in the model frame of the object
+        state.pushModelViewMatrix();
+        state.getCurrentModelViewMatrix() = packet.modelView;
+        packet.mesh->drawOverlays(state);
+        state.popModelViewMatrix();
+    }
+    const SceneObject& first = *packets[order[begin].packet].object;
+    state.setMatrices();
+    state.bindMaterial(first.materialIndex);
+    state.bindVertexArray(first.staticGeometry.vertexArray);
+    state.getOpenGLFunctions()->glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, indexOffsets.data(),
+                                                              static_cast<GLsizei>(counts.size()), baseVertices.data());
+    return triangles;
+}
@@ -0,0 +1,63 @@
+//
+// Draw packets of one frame, sorted by a key so that consecutive draws share program, material and mesh.
+//
+
+#ifndef UEBUNG_04_RENDERQUEUE_H
+#define UEBUNG_04_RENDERQUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+
+class RenderState;
+class TriangleMesh;
+struct SceneObject;
+
+// Passes are drawn in this order. Transparent geometry comes after everything opaque, back to front.
+enum class RenderPass : unsigned int { Opaque, Transparent };
+
+struct DrawPacket {
+    uint64_t key;
+    GLuint program;
+    QMatrix4x4 modelView;
+    TriangleMesh* mesh;
+    // material and occlusion of the object, nullptr for a mesh that is drawn with the state as it is
+    SceneObject* object;
+};
+
+class RenderQueue {
+public:
+    // From the most significant bits: pass, program, material, vertex array, depth. The depth is the distance from
+    // the camera, opaque packets are sorted front to back, transparent ones back to front and before the state.
+    static uint64_t makeKey(RenderPass pass, GLuint program, unsigned int material, GLuint vertexArray, float depth);
+
+    void submit(const DrawPacket& packet) { packets.push_back(packet); }
+    // radix sort of the keys, packets with equal keys keep the order of submission
+    void sort();
+    // Draws all packets in key order, returns the number of triangles drawn. Consecutive objects with static geometry,
+    // the same program and the same material are drawn with one glMultiDrawElementsBaseVertex; their vertices are in
+    // world space, so the current model view matrix has to be the camera matrix.
+    unsigned int execute(RenderState& state);
+    void clear();
+
+    size_t size() const { return packets.size(); }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+    };
+    // draws the packets [begin, end) of the order, all with static geometry
+    unsigned int drawBatch(RenderState& state, size_t begin, size_t end);
+
+    std::vector<DrawPacket> packets;
+    std::vector<SortEntry> order, scratch;
+    // arguments of the multi draw, kept to reuse their memory
+    std::vector<GLsizei> counts;
+    std::vector<const void*> indexOffsets;
+    std::vector<GLint> baseVertices;
+};
+
+#endif //UEBUNG_04_RENDERQUEUE_H
@@ -5,13 +5,41 @@
 #ifndef UEBUNG_03_RENDERSTATE_H
 #define UEBUNG_03_RENDERSTATE_H
 
+#include <algorithm>
+#include <cstring>
 #include <stack>
+#include <unordered_map>
+#include <vector>
 #include <QMatrix3x3>
 #include <QMatrix4x4>
 #include <QOpenGLFunctions_3_3_Core>
 
 #include "vec3.h"
 #include "light.h"
+#include "shader.h"
+
+// std140 layouts of the uniform blocks in the shaders
+struct FrameBlock {
+    GLfloat view[16];
+    GLfloat projection[16];
+    GLfloat cameraPosition[4];
+};
+
+struct LightBlock {
+    GLfloat position[3];
+    GLfloat intensity;
+    GLfloat ambientIntensity;
+    GLfloat padding[3];
+};
+
+struct MaterialBlock {
+    GLfloat ambientColor[3];
+    GLfloat shininess;
+    GLfloat diffuseColor[3];
+    GLfloat padding0;
+    GLfloat specularColor[3];
+    GLfloat padding1;
+};
 
 class RenderState {
     Light sceneLight;
@@ -20,14 +48,46 @@ class RenderState {
     std::stack<QMatrix4x4> modelViewMatrixStack;
     std::stack<QMatrix4x4> projectionMatrixStack;
     QOpenGLFunctions_3_3_Core* f;
-    GLint modelViewMatrixUniformStandard{-1}, projectionMatrixUniformStandard{-1}, normalMatrixUniformStandard{-1}, lightPositionUniformStandard{-1},
-            cameraPositionUniformStandard{-1}, textureUniformStandard{-1}, normalMapUniformStandard{-1}, useTextureUniformStandard{-1}, ambientColorUniformStandard{-1},
-            diffuseColorUniformStandard{-1}, specularColorUniformStandard{-1}, shininessUniformStandard{-1}, depthMapUniformStandard{-1}, lightMatrixUniformStandard{-1},
-            lightIntensityUniformStandard{-1}, ambientIntensityUniformStandard{-1};
-    GLint modelViewMatrixUniform{-1}, projectionMatrixUniform{-1}, normalMatrixUniform{-1}, lightPositionUniform{-1},
-        cameraPositionUniform{-1}, textureUniform{-1}, normalMapUniform{-1}, useTextureUniform{-1}, ambientColorUniform{-1},
-        diffuseColorUniform{-1}, specularColorUniform{-1}, shininessUniform{-1}, depthMapUniform{-1}, lightMatrixUniform{-1},
-        lightIntensityUniform{-1}, ambientIntensityUniform{-1};
+    // reflection of the active and of the standard program, see getProgramUniforms
+    const ProgramUniforms* uniforms{nullptr};
+    const ProgramUniforms* standardUniforms{nullptr};
+    // buffers of the uniform blocks
+    GLuint frameBuffer{}, lightBuffer{}, materialBuffer{};
+    GLintptr materialStride{};
+    size_t materialCount{};
+
+    // Shadow of the GL state that the frame loop changes. Calls that would set what is already set are skipped and
+    // counted.
+    static const unsigned int TEXTURE_UNITS = 8;
+    bool stateKnown{false};
+    GLuint boundVertexArray{};
+    GLuint activeTextureUnit{};
+    GLuint boundTextures[TEXTURE_UNITS]{};
+    bool depthTest{}, blend{};
+    GLuint boundMaterial{~0u};
+    // model view matrix last uploaded to each program, the normal matrix follows from it
+    std::unordered_map<GLuint, QMatrix4x4> uploadedModelView;
+    unsigned int issuedCalls{}, skippedCalls{};
+
+    void useProgram(GLuint program) {
+        if (stateKnown && program == activeProgram) {
+            skippedCalls++;
+            return;
+        }
+        f->glUseProgram(program);
+        issuedCalls++;
+    }
+
+    void setCapability(GLenum capability, bool enable, bool& current) {
+        if (stateKnown && enable == current) {
+            skippedCalls++;
+            return;
+        }
+        if (enable) f->glEnable(capability);
+        else f->glDisable(capability);
+        current = enable;
+        issuedCalls++;
+    }
 
     static void loadIdentity(std::stack<QMatrix4x4>& stack) {
         if (!stack.empty()) {
@@ -87,87 +147,33 @@ public:
     GLuint getStandardProgram() const { return standardProgram; }
 
     void setCurrentProgram(GLuint nextProgram) {
-        f->glUseProgram(nextProgram);
+        useProgram(nextProgram);
         activeProgram = nextProgram;
-        modelViewMatrixUniform = f->glGetUniformLocation(activeProgram, "modelView");
-        projectionMatrixUniform = f->glGetUniformLocation(activeProgram, "projection");
-        normalMatrixUniform = f->glGetUniformLocation(activeProgram, "normalMatrix");
-        lightPositionUniform = f->glGetUniformLocation(activeProgram, "lightPosition");
-        cameraPositionUniform = f->glGetUniformLocation(activeProgram, "cameraPosition");
-        textureUniform = f->glGetUniformLocation(activeProgram, "diffuseTexture");
-        normalMapUniform = f->glGetUniformLocation(activeProgram, "normalMap");
-        useTextureUniform = f->glGetUniformLocation(activeProgram, "useTexture");
-        ambientColorUniform = f->glGetUniformLocation(activeProgram, "ambientColor");
-        diffuseColorUniform = f->glGetUniformLocation(activeProgram, "diffuseColor");
-        specularColorUniform = f->glGetUniformLocation(activeProgram, "specularColor");
-        shininessUniform = f->glGetUniformLocation(activeProgram, "shininess");
-        depthMapUniform = f->glGetUniformLocation(activeProgram, "depthMap");
-        lightMatrixUniform = f->glGetUniformLocation(activeProgram, "lightMatrix");
-        lightIntensityUniform = f->glGetUniformLocation(activeProgram, "lightIntensity");
-        ambientIntensityUniform = f->glGetUniformLocation(activeProgram, "ambientIntensity");
+        uniforms = &getProgramUniforms(f, activeProgram);
     }
 
     void setStandardProgram(GLuint standardProgram) {
-        f->glUseProgram(standardProgram);
+        useProgram(standardProgram);
         activeProgram = standardProgram;
         this->standardProgram = standardProgram;
-
-        modelViewMatrixUniformStandard = f->glGetUniformLocation(activeProgram, "modelView");
-        projectionMatrixUniformStandard = f->glGetUniformLocation(activeProgram, "projection");
-        normalMatrixUniformStandard = f->glGetUniformLocation(activeProgram, "normalMatrix");
-        lightPositionUniformStandard = f->glGetUniformLocation(activeProgram, "lightPosition");
-        cameraPositionUniformStandard = f->glGetUniformLocation(activeProgram, "cameraPosition");
-        textureUniformStandard = f->glGetUniformLocation(activeProgram, "diffuseTexture");
-        normalMapUniformStandard = f->glGetUniformLocation(activeProgram, "normalMap");
-        useTextureUniformStandard = f->glGetUniformLocation(activeProgram, "useTexture");
-        ambientColorUniformStandard = f->glGetUniformLocation(activeProgram, "ambientColor");
-        diffuseColorUniformStandard = f->glGetUniformLocation(activeProgram, "diffuseColor");
-        specularColorUniformStandard = f->glGetUniformLocation(activeProgram, "specularColor");
-        shininessUniformStandard = f->glGetUniformLocation(activeProgram, "shininess");
-        depthMapUniformStandard = f->glGetUniformLocation(activeProgram, "depthMap");
-        lightMatrixUniformStandard = f->glGetUniformLocation(activeProgram, "lightMatrix");
-        lightIntensityUniformStandard = f->glGetUniformLocation(activeProgram, "lightIntensity");
-        ambientIntensityUniformStandard = f->glGetUniformLocation(activeProgram, "ambientIntensity");
+        standardUniforms = uniforms = &getProgramUniforms(f, activeProgram);
     }
 
     void switchToStandardProgram() {
-        f->glUseProgram(standardProgram);
+        useProgram(standardProgram);
         activeProgram = standardProgram;
+        uniforms = standardUniforms;
+    }
 
-        modelViewMatrixUniform = modelViewMatrixUniformStandard;
-        projectionMatrixUniform = projectionMatrixUniformStandard;
-        normalMatrixUniform = normalMatrixUniformStandard;
-        lightPositionUniform = lightPositionUniformStandard;
-        cameraPositionUniform = cameraPositionUniformStandard;
-        textureUniform = textureUniformStandard;
-        normalMapUniform = normalMapUniformStandard;
-        useTextureUniform = useTextureUniformStandard;
-        ambientColorUniform = ambientColorUniformStandard;
-        diffuseColorUniform = diffuseColorUniformStandard;
-        specularColorUniform = specularColorUniformStandard;
-        shininessUniform = shininessUniformStandard;
-        depthMapUniform = depthMapUniformStandard;
-        lightMatrixUniform = lightMatrixUniformStandard;
-        lightIntensityUniform = lightIntensityUniformStandard;
-        ambientIntensityUniform = ambientIntensityUniformStandard;
-    }
-
-    GLint getModelViewUniform() const { return modelViewMatrixUniform; }
-    GLint getProjectionUniform() const { return projectionMatrixUniform; }
-    GLint getNormalMatrixUniform() const { return normalMatrixUniform; }
-    GLint getLightPositionUniform() const { return lightPositionUniform; }
-    GLint getCameraPositionUniform() const { return cameraPositionUniform; }
-    GLint getTextureUniform() const { return textureUniform; }
-    GLint getNormalMapUniform() const { return normalMapUniform; }
-    GLint getUseTextureUniform() const { return useTextureUniform; }
-    GLint getAmbientColorUniform() const { return ambientColorUniform; }
-    GLint getDiffuseColorUniform() const { return diffuseColorUniform; }
-    GLint getSpecularColorUniform() const { return specularColorUniform; }
-    GLint getShininessUniform() const { return shininessUniform; }
-    GLint getDepthMapUniform() const { return depthMapUniform; }
-    GLint getLightMatrixUniform() const { return lightMatrixUniform; }
-    GLint getLightIntensityUniform() const { return lightIntensityUniform; }
-    GLint getAmbientIntensityUniform() const { return ambientIntensityUniform; }
+    // location in the active program, -1 if it does not use the uniform
+    GLint getUniform(UniformName name) const { return uniforms ? uniforms->location(name) : -1; }
+    GLint getModelViewUniform() const { return getUniform(UNIFORM_MODEL_VIEW); }
+    GLint getNormalMatrixUniform() const { return getUniform(UNIFORM_NORMAL_MATRIX); }
+    GLint getTextureUniform() const { return getUniform(UNIFORM_DIFFUSE_TEXTURE); }
+    GLint getNormalMapUniform() const { return getUniform(UNIFORM_NORMAL_MAP); }
+    GLint getUseTextureUniform() const { return getUniform(UNIFORM_USE_TEXTURE); }
+    GLint getDepthMapUniform() const { return getUniform(UNIFORM_DEPTH_MAP); }
+    GLint getLightMatrixUniform() const { return getUniform(UNIFORM_LIGHT_MATRIX); }
 
     Light& getLight() {
         return sceneLight;
@@ -176,20 +182,137 @@ public:
         return sceneLight;
     }
 
+    // Creates the buffers of the uniform blocks and binds the frame and light buffer to their binding points. No
+    // program binds anything else there, so they stay bound.
+    void createUniformBuffers() {
+        f->glGenBuffers(1, &frameBuffer);
+        f->glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+        f->glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+        f->glGenBuffers(1, &lightBuffer);
+        f->glBindBuffer(GL_UNIFORM_BUFFER, lightBuffer);
+        f->glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+        f->glGenBuffers(1, &materialBuffer);
+        f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        f->glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK, frameBuffer);
+        f->glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK, lightBuffer);
+    }
+
+    // once per frame, the current model view matrix is the camera matrix
+    void setFrameUniforms(const QVector3D& cameraPosition) {
+        FrameBlock frame{};
+        std::copy(getCurrentModelViewMatrix().constData(), getCurrentModelViewMatrix().constData() + 16, frame.view);
+        std::copy(getCurrentProjectionMatrix().constData(), getCurrentProjectionMatrix().constData() + 16, frame.projection);
+        frame.cameraPosition[0] = cameraPosition.x();
+        frame.cameraPosition[1] = cameraPosition.y();
+        frame.cameraPosition[2] = cameraPosition.z();
+        frame.cameraPosition[3] = 1.f;
+        f->glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+        f->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+        f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // the light position is transformed with the current model view matrix
     void setLightUniform() {
         const auto& pos = getLight().position;
         QVector4D Qlp4d(pos.x(), pos.y(), pos.z(), 1.0f);
         const QVector3D Qlp = getCurrentModelViewMatrix().map(Qlp4d).toVector3DAffine();
-        f->glUniform3f(getLightPositionUniform(), Qlp.x(), Qlp.y(), Qlp.z());
-        f->glUniform1f(getLightIntensityUniform(), getLight().lightIntensity);
-        f->glUniform1f(getAmbientIntensityUniform(), getLight().ambientIntensity);
+        LightBlock light{};
+        light.position[0] = Qlp.x();
+        light.position[1] = Qlp.y();
+        light.position[2] = Qlp.z();
+        light.intensity = getLight().lightIntensity;
+        light.ambientIntensity = getLight().ambientIntensity;
+        f->glBindBuffer(GL_UNIFORM_BUFFER, lightBuffer);
+        f->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(light), &light);
+        f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // Uploads the materials of all objects into one buffer. Every entry starts at a multiple of the offset alignment,
+    // so a draw only binds the range of its material.
+    void setMaterials(const std::vector<MaterialBlock>& materials) {
+        GLint alignment = 256;
+        f->glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        materialStride = (sizeof(MaterialBlock) + alignment - 1) / alignment * alignment;
+        std::vector<char> data(materials.size() * materialStride);
+        for (size_t i = 0; i < materials.size(); ++i) std::memcpy(data.data() + i * materialStride, &materials[i], sizeof(MaterialBlock));
+        f->glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+        f->glBufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+        f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        materialCount = materials.size();
     }
 
+    void bindMaterial(unsigned int index) {
+        if (index >= materialCount) return;
+        if (stateKnown && index == boundMaterial) {
+            skippedCalls++;
+            return;
+        }
+        f->glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK, materialBuffer, index * materialStride, sizeof(MaterialBlock));
+        boundMaterial = index;
+        issuedCalls++;
+    }
+
+    // uploads the model view and normal matrix unless the active program already has them
     void setMatrices() {
-        f->glUniformMatrix4fv(getProjectionUniform(), 1, GL_FALSE, getCurrentProjectionMatrix().constData());
-        f->glUniformMatrix4fv(getModelViewUniform(), 1, GL_FALSE, getCurrentModelViewMatrix().constData());
+        const QMatrix4x4& modelView = getCurrentModelViewMatrix();
+        auto uploaded = uploadedModelView.find(activeProgram);
+        if (stateKnown && uploaded != uploadedModelView.end() && uploaded->second == modelView) {
+            skippedCalls += 2;
+            return;
+        }
+        f->glUniformMatrix4fv(getModelViewUniform(), 1, GL_FALSE, modelView.constData());
         f->glUniformMatrix3fv(getNormalMatrixUniform(), 1, GL_FALSE, calculateNormalMatrix().constData());
+        uploadedModelView[activeProgram] = modelView;
+        issuedCalls += 2;
+    }
+
+    void bindVertexArray(GLuint vertexArray) {
+        if (stateKnown && vertexArray == boundVertexArray) {
+            skippedCalls++;
+            return;
+        }
+        f->glBindVertexArray(vertexArray);
+        boundVertexArray = vertexArray;
+        issuedCalls++;
+    }
+
+    // binds a 2D texture to a texture unit, the active unit is only changed if the binding changes
+    void bindTexture(GLuint unit, GLuint texture) {
+        if (unit >= TEXTURE_UNITS) return;
+        if (stateKnown && texture == boundTextures[unit]) {
+            skippedCalls++;
+            return;
+        }
+        if (!stateKnown || unit != activeTextureUnit) {
+            f->glActiveTexture(GL_TEXTURE0 + unit);
+            activeTextureUnit = unit;
+            issuedCalls++;
+        }
+        f->glBindTexture(GL_TEXTURE_2D, texture);
+        boundTextures[unit] = texture;
+        issuedCalls++;
     }
+
+    void setDepthTest(bool enable) { setCapability(GL_DEPTH_TEST, enable, depthTest); }
+    void setBlend(bool enable) { setCapability(GL_BLEND, enable, blend); }
+
+    // Sets the shadowed state to known values at the start of a frame. Between two frames Qt and the creation of
+    // buffers and textures change bindings behind the back of RenderState, so nothing is trusted across frames.
+    void beginFrame() {
+        stateKnown = false;
+        uploadedModelView.clear();
+        boundMaterial = ~0u;
+        useProgram(activeProgram);
+        bindVertexArray(0);
+        for (GLuint unit = TEXTURE_UNITS; unit-- > 0;) bindTexture(unit, 0);
+        setDepthTest(true);
+        setBlend(false);
+        stateKnown = true;
+    }
+
+    unsigned int getIssuedCalls() const { return issuedCalls; }
+    unsigned int getSkippedCalls() const { return skippedCalls; }
+    void resetCallCounters() { issuedCalls = skippedCalls = 0; }
 };
 
 #endif //UEBUNG_03_RENDERSTATE_H
@@ -0,0 +1,54 @@
+//
+// Random numbers and direction sampling shared by the path tracer and the ambient occlusion baker.
+//
+
+#ifndef UEBUNG_04_SAMPLING_H
+#define UEBUNG_04_SAMPLING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "vec3.h"
+
+// PCG32 random number generator, small enough to create one per pixel and sample.
+class Random {
+public:
+    Random(uint64_t seed, uint64_t sequence) : increment((sequence << 1u) | 1u) {
+        next();
+        state += seed;
+        next();
+    }
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+        uint32_t shifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        uint32_t rotation = static_cast<uint32_t>(old >> 59u);
+        return (shifted >> rotation) | (shifted << ((-rotation) & 31));
+    }
+    // uniform in [0, 1)
+    float nextFloat() { return (next() >> 8) * (1.f / 16777216.f); }
+
+private:
+    uint64_t state{0};
+    uint64_t increment;
+};
+
+// direction at angle acos(cosTheta) from axis, rotated by phi around it
+inline Vec3f sampleAround(const Vec3f& axis, float cosTheta, float phi) {
+    // orthonormal basis, Duff et al. 2017
+    float sign = std::copysign(1.f, axis.z());
+    float a = -1.f / (sign + axis.z());
+    float b = axis.x() * axis.y() * a;
+    Vec3f tangent(1.f + sign * axis.x() * axis.x() * a, sign * b, -sign * axis.x());
+    Vec3f bitangent(b, sign + axis.y() * axis.y() * a, -axis.y());
+    float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+    return (sinTheta * std::cos(phi)) * tangent + (sinTheta * std::sin(phi)) * bitangent + cosTheta * axis;
+}
+
+// cosine weighted direction in the hemisphere around the normal, u1 and u2 uniform in [0, 1)
+inline Vec3f sampleCosineHemisphere(const Vec3f& normal, float u1, float u2) {
+    return sampleAround(normal, std::sqrt(u1), 2.f * 3.14159265358979f * u2);
+}
+
+#endif //UEBUNG_04_SAMPLING_H
@@ -0,0 +1,93 @@
+//
+// View frustum culling of scene objects with a bounding volume hierarchy over their world space boxes.
+//
+
+#include "sceneculler.h"
+#include "sceneobject.h"
+
+void SceneCuller::build(const std::vector<SceneObject>& objects) {
+    std::vector<AABB> bounds(objects.size());
+    objectBoxes.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        TriangleMesh& mesh = objects[i].mesh;
+        const QMatrix4x4& model = objects[i].getModelMatrix();
+        if (mesh.getNumTriangles() == 0) {
+            // nothing to draw, an empty box at the origin of the object keeps the hierarchy finite
+            bounds[i].grow(QVector3DToVec3f(model.map(QVector3D())));
+        } else {
+            const Vec3f low = mesh.getBoundingBoxMin(), high = mesh.getBoundingBoxMax();
+            for (unsigned int corner = 0; corner < 8; ++corner) {
+                const QVector3D p(corner & 1 ? high.x() : low.x(), corner & 2 ? high.y() : low.y(), corner & 4 ? high.z() : low.z());
+                bounds[i].grow(QVector3DToVec3f(model.map(p)));
+            }
+        }
+        objectBoxes[i] = Box{bounds[i].center(), 0.5f * (bounds[i].max - bounds[i].min)};
+    }
+    nodes.clear();
+    objectIndices.clear();
+    if (!objects.empty()) buildBVH(bounds, nodes, objectIndices);
+
+    nodeBoxes.resize(nodes.size());
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        const Vec3f low(nodes[n].boundsMin[0], nodes[n].boundsMin[1], nodes[n].boundsMin[2]);
+        const Vec3f high(nodes[n].boundsMax[0], nodes[n].boundsMax[1], nodes[n].boundsMax[2]);
+        nodeBoxes[n] = Box{0.5f * (low + high), 0.5f * (high - low)};
+    }
+    nodePlanes.assign(nodes.size(), 0);
+    objectPlanes.assign(objects.size(), 0);
+}
+
+void SceneCuller::takeAll(unsigned int node, std::vector<unsigned int>& visible) const {
+    unsigned int stack[64];
+    unsigned int stackSize = 0;
+    while (true) {
+        const BVHNode& current = nodes[node];
+        if (current.isLeaf()) {
+            for (unsigned int i = 0; i < current.count; ++i) visible.push_back(objectIndices[current.leftFirst + i]);
+            if (stackSize == 0) return;
+            node = stack[--stackSize];
+        } else {
+            stack[stackSize++] = current.leftFirst + 1;
+            node = current.leftFirst;
+        }
+    }
+}
+
+unsigned int SceneCuller::cull(const Frustum& frustum, std::vector<unsigned int>& visible) {
+    if (nodes.empty()) return 0;
+    // nodes with the planes they still have to be tested against
+    struct Entry {
+        unsigned int node;
+        unsigned int mask;
+    };
+    Entry stack[64];
+    unsigned int stackSize = 0;
+    unsigned int tests = 0;
+    Entry entry{0, Frustum::ALL_PLANES};
+    while (true) {
+        const BVHNode& node = nodes[entry.node];
+        tests++;
+        const Frustum::Result result = frustum.testBox(nodeBoxes[entry.node].center, nodeBoxes[entry.node].extent, entry.mask, nodePlanes[entry.node]);
+        if (result == Frustum::Result::Inside) {
+            takeAll(entry.node, visible);
+        } else if (result == Frustum::Result::Intersecting) {
+            if (node.isLeaf()) {
+                for (unsigned int i = 0; i < node.count; ++i) {
+                    const unsigned int object = objectIndices[node.leftFirst + i];
+                    unsigned int mask = entry.mask;
+                    tests++;
+                    if (frustum.testBox(objectBoxes[object].center, objectBoxes[object].extent, mask, objectPlanes[object]) != Frustum::Result::Outside) {
+                        visible.push_back(object);
+                    }
+                }
+            } else {
+                stack[stackSize++] = Entry{node.leftFirst + 1, entry.mask};
+                entry = Entry{node.leftFirst, entry.mask};
+                continue;
+            }
+        }
+        if (stackSize == 0) break;
+        entry = stack[--stackSize];
+    }
+    return tests;
+}
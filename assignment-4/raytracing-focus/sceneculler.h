@@ -0,0 +1,43 @@
+//
+// View frustum culling of scene objects with a bounding volume hierarchy over their world space boxes.
+//
+
+#ifndef UEBUNG_04_SCENECULLER_H
+#define UEBUNG_04_SCENECULLER_H
+
+#include <vector>
+
+#include "bvh.h"
+#include "frustum.h"
+
+struct SceneObject;
+
+class SceneCuller {
+public:
+    // Builds the hierarchy over the boxes of the meshes transformed by the model matrices. Like the static geometry
+    // of the objects it is not updated when they move.
+    void build(const std::vector<SceneObject>& objects);
+    bool isEmpty() const { return nodes.empty(); }
+    size_t getNumObjects() const { return objectBoxes.size(); }
+
+    // Appends the indices of the objects whose boxes are not outside of the frustum. A node inside of a plane hands
+    // only the other planes to its children, the objects below a node inside of all of them are taken untested.
+    // Returns the number of box tests.
+    unsigned int cull(const Frustum& frustum, std::vector<unsigned int>& visible);
+
+private:
+    struct Box {
+        Vec3f center;
+        Vec3f extent;
+    };
+    // appends the objects of the subtree
+    void takeAll(unsigned int node, std::vector<unsigned int>& visible) const;
+
+    std::vector<BVHNode> nodes;
+    std::vector<unsigned int> objectIndices;
+    std::vector<Box> nodeBoxes, objectBoxes;
+    // plane that rejected a node or object in the last frame, tested first in the next one
+    std::vector<unsigned int> nodePlanes, objectPlanes;
+};
+
+#endif //UEBUNG_04_SCENECULLER_H
@@ -3,27 +3,25 @@
 //
 
 #include "sceneobject.h"
+#include "shader.h"
+
+MaterialBlock SceneObject::getMaterialBlock() const {
+    MaterialBlock material{};
+    for (unsigned int i = 0; i < 3; ++i) {
+        material.ambientColor[i] = ambientColor[i];
+        material.diffuseColor[i] = diffuseColor[i];
+        material.specularColor[i] = specularColor[i];
+    }
+    material.shininess = shininess;
+    return material;
+}
 
 unsigned int SceneObject::draw(RenderState &state, const QMatrix4x4* lightMatrix) {
     state.pushModelViewMatrix();
     state.getCurrentModelViewMatrix() *= modelMatrix;
-    auto* f = state.getOpenGLFunctions();
     // TODO: Ex 4.1a Set uniforms with material parameters for OpenGL phong shader
-    
-    GLint ambientLocation = f->glGetUniformLocation(state.getCurrentProgram(), "material.ambientColor");
-    float ambient[] = { ambientColor.x(), ambientColor.y(), ambientColor.z() };
-    if (ambientLocation != -1) f->glUniform3fv(ambientLocation, 1, ambient);
-
-    GLint diffuseLocation = f->glGetUniformLocation(state.getCurrentProgram(), "material.diffuseColor");
-    float diffuse[] = { diffuseColor.x(), diffuseColor.y(), diffuseColor.z() };
-    if (diffuseLocation != -1) f->glUniform3fv(diffuseLocation, 1, diffuse);
-
-    GLint specularLocation = f->glGetUniformLocation(state.getCurrentProgram(), "material.specularColor");
-    float specular[] = { specularColor.x(), specularColor.y(), specularColor.z() };
-    if (specularLocation != -1) f->glUniform3fv(specularLocation, 1, specular);
-
-    GLint shininessLocation = f->glGetUniformLocation(state.getCurrentProgram(), "material.shininess");
-    if (shininessLocation != -1) f->glUniform1f(shininessLocation, shininess);
+    // the material was uploaded once with all others, see RenderState::setMaterials
+    state.bindMaterial(materialIndex);
 
     // TODO: Ex 4.2 Fix light matrix so it contains model transformation.
 
@@ -32,6 +30,61 @@ unsigned int SceneObject::draw(RenderState &state, const QMatrix4x4* lightMatrix
     return result;
 }
 
+void SceneObject::submit(RenderQueue& queue, RenderState& state, GLuint program) {
+    state.pushModelViewMatrix();
+    state.getCurrentModelViewMatrix() *= modelMatrix;
+    if (mesh.getVAO() != 0) {
+        const QMatrix4x4& modelView = state.getCurrentModelViewMatrix();
+        const Vec3f mid = mesh.getBoundingBoxMid();
+        const float depth = -modelView.map(QVector3D(mid.x(), mid.y(), mid.z())).z();
+        const RenderPass pass = transparency > 0.f ? RenderPass::Transparent : RenderPass::Opaque;
+        queue.submit(DrawPacket{RenderQueue::makeKey(pass, program, materialIndex, mesh.getVAO(), depth), program, modelView, &mesh, this});
+    }
+    state.popModelViewMatrix();
+}
+
+unsigned int SceneObject::drawSubmitted(RenderState& state) {
+    state.bindMaterial(materialIndex);
+    return mesh.drawUnculled(state);
+}
+
+unsigned int SceneObject::drawStatic(RenderState& state) {
+    if (!staticGeometry.isValid()) return draw(state);
+    // bounding box and normals are in the model frame of the object
+    state.pushModelViewMatrix();
+    state.getCurrentModelViewMatrix() *= modelMatrix;
+    mesh.drawOverlays(state);
+    state.popModelViewMatrix();
+    state.setMatrices();
+    state.bindMaterial(materialIndex);
+    state.bindVertexArray(staticGeometry.vertexArray);
+    state.getOpenGLFunctions()->glDrawElementsBaseVertex(GL_TRIANGLES, staticGeometry.indexCount, GL_UNSIGNED_INT, staticGeometry.indexOffset(),
+                                                         staticGeometry.baseVertex);
+    return staticGeometry.indexCount / 3;
+}
+
+void SceneObject::createStaticGeometry(QOpenGLFunctions_3_3_Core* f, bool withOcclusion) {
+    GeometryBuffer::meshes().free(staticGeometry);
+    staticGeometry = GeometryRange();
+    std::vector<MeshVertex> vertices = mesh.getMeshVertices();
+    if (vertices.empty()) return;
+    const bool occluded = withOcclusion && occlusion.size() == vertices.size();
+    // normals transform with the inverse transpose, which keeps them perpendicular under non-uniform scaling
+    const QMatrix4x4 normalMatrix = modelMatrix.inverted().transposed();
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        MeshVertex& vertex = vertices[i];
+        const QVector3D position = modelMatrix.map(QVector3D(vertex.position[0], vertex.position[1], vertex.position[2]));
+        const QVector3D normal = normalMatrix.mapVector(QVector3D(vertex.normal[0], vertex.normal[1], vertex.normal[2])).normalized();
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            vertex.position[axis] = position[axis];
+            vertex.normal[axis] = normal[axis];
+        }
+        if (occluded) vertex.occlusion = occlusion[i];
+    }
+    const std::vector<Vec3ui>& triangles = mesh.getTriangles();
+    staticGeometry = GeometryBuffer::meshes().allocate(f, vertices.data(), vertices.size(), reinterpret_cast<const GLuint*>(triangles.data()), 3 * triangles.size());
+}
+
 SceneObject::SceneObject(const Vec3f &ambientCol, const Vec3f &diffuseCol, const Vec3f &specularCol, float shini, float reflect, TriangleMesh &msh, const Vec3f& pos, const Vec3f& scale, float transp, float refrIdx)
 : ambientColor(ambientCol), diffuseColor(diffuseCol), specularColor(specularCol), shininess(shini), reflectionIntensity(reflect), mesh(msh), transparency(transp), refractiveIndex(refrIdx) {
     translate(pos);
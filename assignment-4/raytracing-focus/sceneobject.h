@@ -9,8 +9,15 @@
 #include "vec3.h"
 #include "trianglemesh.h"
 #include "renderstate.h"
+#include "texture.h"
+#include "renderqueue.h"
 
 struct SceneObject {
+    // Shape the ray tracer uses for the object. The analytic shapes are defined in the unit frame of the object:
+    // sphere with radius 1, box [-1,1]^3, plane z = 0 with |x|, |y| <= 1 (or unbounded). The mesh is still used
+    // for rasterization, sphere.off and cube.off match the sphere and the box.
+    enum class Shape : unsigned int { Mesh, Sphere, Box, Plane, InfinitePlane };
+
     Vec3f ambientColor;
     Vec3f diffuseColor;
     Vec3f specularColor;
@@ -19,8 +26,30 @@ struct SceneObject {
     float transparency;
     float refractiveIndex;
     TriangleMesh& mesh;
+    // optional texture, modulates ambient and diffuse color in the ray tracer
+    const MipMappedTexture* diffuseTexture{nullptr};
+    Shape shape{Shape::Mesh};
+    // baked ambient occlusion per mesh vertex (see bakeAmbientOcclusion), drawn if the static geometry contains it
+    std::vector<float> occlusion;
+    // Copy of the mesh in world space in GeometryBuffer::meshes(). All objects with such a copy are drawn with the
+    // camera matrix alone, so the render queue draws runs of them with one call. It is not updated when the mesh or
+    // the model matrix change.
+    GeometryRange staticGeometry;
+    // entry of the material buffer of the RenderState
+    unsigned int materialIndex{0};
 
     unsigned int draw(RenderState& state, const QMatrix4x4* lightMatrix = nullptr);
+    // (re)creates staticGeometry, with the baked occlusion or with the constant 1
+    void createStaticGeometry(QOpenGLFunctions_3_3_Core* f, bool withOcclusion);
+    // queues the object, objects with transparency in the transparent pass. Culling is up to the caller (see SceneCuller).
+    void submit(RenderQueue& queue, RenderState& state, GLuint program);
+    // draw of a queued object, the current model view matrix already contains the model matrix
+    unsigned int drawSubmitted(RenderState& state);
+    // draws staticGeometry like a batch of the render queue, with the current model view matrix as camera matrix.
+    // Without static geometry it falls back to draw.
+    unsigned int drawStatic(RenderState& state);
+    // material parameters in the layout of the Material uniform block
+    MaterialBlock getMaterialBlock() const;
     void scale(const Vec3f& scale);
     void translate(const Vec3f& pos);
     const QMatrix4x4& getModelMatrix() const { return modelMatrix; };
@@ -1,5 +1,60 @@
+#include <algorithm>
+#include <iterator>
+
 #include "shader.h"
 
+namespace {
+    // in the order of UniformName
+    const char* const UNIFORM_NAMES[UNIFORM_NAME_COUNT] = {
+        "modelView", "normalMatrix", "diffuseTexture", "normalMap", "useTexture",
+        "depthMap", "lightMatrix", "shadowMask", "useShadowMask", "viewportSize",
+        "objectID"
+    };
+
+    // in the order of UniformBlock
+    const char* const UNIFORM_BLOCK_NAMES[UNIFORM_BLOCK_COUNT] = {"Frame", "Light", "Material"};
+
+    std::unordered_map<GLuint, ProgramUniforms> programUniforms;
+
+    ProgramUniforms reflectProgram(QOpenGLFunctions_3_3_Core* f, GLuint program) {
+        ProgramUniforms result;
+        std::fill(std::begin(result.locations), std::end(result.locations), -1);
+        if (program == 0) return result;
+        GLint count = 0, maxLength = 0;
+        f->glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        f->glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            UniformInfo info{};
+            f->glGetActiveUniform(program, i, buffer.size(), &length, &info.size, &info.type, buffer.data());
+            std::string name(buffer.data(), length);
+            // arrays are reported as name[0], the location of the first element is the one of the array
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) name.resize(name.size() - 3);
+            // uniforms in uniform blocks have no location
+            info.location = f->glGetUniformLocation(program, name.c_str());
+            if (info.location != -1) result.byName[name] = info;
+        }
+        for (unsigned int i = 0; i < UNIFORM_NAME_COUNT; ++i) result.locations[i] = result.location(UNIFORM_NAMES[i]);
+        for (GLuint i = 0; i < UNIFORM_BLOCK_COUNT; ++i) {
+            GLuint index = f->glGetUniformBlockIndex(program, UNIFORM_BLOCK_NAMES[i]);
+            if (index != GL_INVALID_INDEX) f->glUniformBlockBinding(program, index, i);
+        }
+        return result;
+    }
+}
+
+GLint ProgramUniforms::location(const std::string& name) const {
+    auto it = byName.find(name);
+    return it == byName.end() ? -1 : it->second.location;
+}
+
+const ProgramUniforms& getProgramUniforms(QOpenGLFunctions_3_3_Core* f, GLuint program) {
+    auto it = programUniforms.find(program);
+    if (it == programUniforms.end()) it = programUniforms.emplace(program, reflectProgram(f, program)).first;
+    return it->second;
+}
+
 GLint getProgramLogLength(QOpenGLFunctions_3_3_Core* f, GLuint obj) {
     GLint infologLength = 0;
     f->glGetProgramiv(obj, GL_INFO_LOG_LENGTH, &infologLength);
@@ -68,6 +123,10 @@ void printProgramInfoLog(QOpenGLFunctions_3_3_Core* f, GLuint obj)
 
 
 GLuint compileShaders(QOpenGLFunctions_3_3_Core* f, const char* vertexShaderSrc, GLint vertexShaderSize, const char* fragmentShaderSrc, GLint fragmentShaderSize) {
+    return compileShaders(f, vertexShaderSrc, vertexShaderSize, nullptr, 0, fragmentShaderSrc, fragmentShaderSize);
+}
+
+GLuint compileShaders(QOpenGLFunctions_3_3_Core* f, const char* vertexShaderSrc, GLint vertexShaderSize, const char* geometryShaderSrc, GLint geometryShaderSize, const char* fragmentShaderSrc, GLint fragmentShaderSize) {
     // create shaders, set source and compile
     GLuint vertexShader = f->glCreateShader(GL_VERTEX_SHADER);
     GLuint fragmentShader = f->glCreateShader(GL_FRAGMENT_SHADER);
@@ -75,13 +134,22 @@ GLuint compileShaders(QOpenGLFunctions_3_3_Core* f, const char* vertexShaderSrc,
     f->glShaderSource(fragmentShader, 1, &fragmentShaderSrc, &fragmentShaderSize);
     f->glCompileShader(vertexShader);
     f->glCompileShader(fragmentShader);
+    // the geometry shader is optional
+    GLuint geometryShader = 0;
+    if (geometryShaderSrc) {
+        geometryShader = f->glCreateShader(GL_GEOMETRY_SHADER);
+        f->glShaderSource(geometryShader, 1, &geometryShaderSrc, &geometryShaderSize);
+        f->glCompileShader(geometryShader);
+    }
 
-    // create a program, attach both shaders and link the program (shaders can be deleted now)
+    // create a program, attach all shaders and link the program (shaders can be deleted now)
     GLuint program = f->glCreateProgram();
     f->glAttachShader(program, vertexShader);
+    if (geometryShader) f->glAttachShader(program, geometryShader);
     f->glAttachShader(program, fragmentShader);
     f->glLinkProgram(program);
     f->glDeleteShader(vertexShader);
+    if (geometryShader) f->glDeleteShader(geometryShader);
     f->glDeleteShader(fragmentShader);
 
     // check if compilation was successful and return the programID
@@ -93,28 +161,39 @@ GLuint compileShaders(QOpenGLFunctions_3_3_Core* f, const char* vertexShaderSrc,
         failureBox.setStandardButtons(QMessageBox::StandardButton::Ok);
         failureBox.setText(QObject::tr("Compilerfehler oder Linkerfehler. Der Shader wurde nicht geladen."));
         failureBox.setInformativeText(QObject::tr("Der eingelesene Quellcode, die Fehlerausgabe des Compilers und des Linkers sind in den Details beigelegt."));
-        failureBox.setDetailedText(QStringLiteral(
+        QString details = QStringLiteral(
             "===== Vertex Shader =====\n"
             "%1\n"
             "===== Vertex Shader Info Log =====\n"
-            "%2\n"
+            "%2\n")
+            .arg(vertexShaderSrc, getShaderInfoLogAsQString(f, vertexShader));
+        if (geometryShader) {
+            details += QStringLiteral(
+                "===== Geometry Shader =====\n"
+                "%1\n"
+                "===== Geometry Shader Info Log =====\n"
+                "%2\n")
+                .arg(geometryShaderSrc, getShaderInfoLogAsQString(f, geometryShader));
+        }
+        details += QStringLiteral(
             "===== Fragment Shader =====\n"
-            "%3\n"
+            "%1\n"
             "===== Fragment Shader Info Log =====\n"
-            "%4\n"
+            "%2\n"
             "===== Program Info Log =====\n"
-            "%5\n")
-            .arg(vertexShaderSrc,
-                 getShaderInfoLogAsQString(f, vertexShader),
-                 fragmentShaderSrc,
+            "%3\n")
+            .arg(fragmentShaderSrc,
                  getShaderInfoLogAsQString(f, fragmentShader),
-                 getProgramInfoLogAsQString(f, program))
-        );
+                 getProgramInfoLogAsQString(f, program));
+        failureBox.setDetailedText(details);
         
         failureBox.exec();
         
         f->glDeleteProgram(program);
         program = 0;
+    } else {
+        // program names can be reused after a program was deleted
+        programUniforms[program] = reflectProgram(f, program);
     }
     return program;
 }
@@ -141,3 +220,36 @@ GLuint readShaders(QOpenGLFunctions_3_3_Core* f, const QString& vertexShaderPath
 
   return compileShaders(f, vertexShaderText.constData(), vertexShaderText.size(), fragmentShaderText.constData(), fragmentShaderText.size());
 }
+
+GLuint readShaders(QOpenGLFunctions_3_3_Core* f, const QString& vertexShaderPath, const QString& geometryShaderPath, const QString& fragmentShaderPath) {
+    QFile vertexShaderFile(vertexShaderPath);
+    QFile geometryShaderFile(geometryShaderPath);
+    QFile fragmentShaderFile(fragmentShaderPath);
+
+    //Open and read vertex shader file
+    if (!vertexShaderFile.open(QFile::OpenModeFlag::ReadOnly)) {
+        qDebug() << "readShaders(): could not open file " << vertexShaderPath;
+        return 0;
+    }
+
+    const auto vertexShaderText = vertexShaderFile.readAll();
+
+    //Open and read geometry shader file
+    if (!geometryShaderFile.open(QFile::OpenModeFlag::ReadOnly)) {
+        qDebug() << "readShaders(): could not open file " << geometryShaderPath;
+        return 0;
+    }
+
+    const auto geometryShaderText = geometryShaderFile.readAll();
+
+    //Open and read fragment shader file
+    if (!fragmentShaderFile.open(QFile::OpenModeFlag::ReadOnly)) {
+        qDebug() << "readShaders(): could not open file " << fragmentShaderPath;
+        return 0;
+    }
+
+    const auto fragmentShaderText = fragmentShaderFile.readAll();
+
+    return compileShaders(f, vertexShaderText.constData(), vertexShaderText.size(), geometryShaderText.constData(), geometryShaderText.size(),
+                          fragmentShaderText.constData(), fragmentShaderText.size());
+}
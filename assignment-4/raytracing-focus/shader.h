@@ -14,6 +14,7 @@
 
 #include <iostream>      // cout
 #include <string>
+#include <unordered_map>
 
 #include <QDebug>
 #include <QtGlobal>
@@ -29,6 +30,46 @@ const GLuint NORMAL_LOCATION = 1;
 const GLuint COLOR_LOCATION = 2;
 const GLuint TEXCOORD_LOCATION = 3;
 const GLuint TANGENT_LOCATION = 4;
+const GLuint OCCLUSION_LOCATION = 5;
+
+// Uniforms the renderer sets every frame. The reflection of every program stores their locations in this order, so
+// the render loop looks them up by index instead of asking OpenGL by name.
+// Projection, light and material are in the uniform blocks below.
+enum UniformName : unsigned int {
+    UNIFORM_MODEL_VIEW, UNIFORM_NORMAL_MATRIX, UNIFORM_DIFFUSE_TEXTURE, UNIFORM_NORMAL_MAP, UNIFORM_USE_TEXTURE,
+    UNIFORM_DEPTH_MAP, UNIFORM_LIGHT_MATRIX, UNIFORM_SHADOW_MASK, UNIFORM_USE_SHADOW_MASK, UNIFORM_VIEWPORT_SIZE,
+    UNIFORM_OBJECT_ID, UNIFORM_NAME_COUNT
+};
+
+// Uniform blocks shared by all programs. Each block uses the binding point of its value, the buffers are bound by
+// RenderState.
+enum UniformBlock : GLuint {
+    FRAME_BLOCK,    // view, projection and camera position, once per frame
+    LIGHT_BLOCK,    // the scene light
+    MATERIAL_BLOCK, // one range of the material buffer per object
+    UNIFORM_BLOCK_COUNT
+};
+
+struct UniformInfo {
+    GLint location;
+    GLenum type;  // e.g. GL_FLOAT_VEC3 or GL_SAMPLER_2D
+    GLint size;   // number of elements for arrays, 1 otherwise
+};
+
+// Active uniforms of a linked program
+struct ProgramUniforms {
+    GLint locations[UNIFORM_NAME_COUNT]; // -1 where the program does not use the uniform
+    std::unordered_map<std::string, UniformInfo> byName; // all active uniforms, arrays without the [0]
+
+    GLint location(UniformName name) const { return locations[name]; }
+    // for uniforms that are not in UniformName, -1 if the program does not use it
+    GLint location(const std::string& name) const;
+};
+
+// Reflection of a program, read once after linking in compileShaders. The uniform blocks of the program are
+// connected to their binding points on the way. Programs created elsewhere are read on their
+// first use. The reference stays valid for the lifetime of the application.
+const ProgramUniforms& getProgramUniforms(QOpenGLFunctions_3_3_Core* f, GLuint program);
 
 GLint getProgramLogLength(QOpenGLFunctions_3_3_Core* f, GLuint obj);
 GLint getShaderLogLength(QOpenGLFunctions_3_3_Core* f, GLuint obj);
@@ -39,6 +80,8 @@ std::vector<GLchar> getProgramInfoLogAsVector(QOpenGLFunctions_3_3_Core* f, GLui
 QString getProgramInfoLogAsQString(QOpenGLFunctions_3_3_Core* f, GLuint obj);
 void printProgramInfoLog(QOpenGLFunctions_3_3_Core* f, GLuint obj);
 GLuint compileShaders(QOpenGLFunctions_3_3_Core* f, const char* vertexShaderSrc, GLint vertexShaderSize, const char* fragmentShaderSrc, GLint fragmentShaderSize);
+GLuint compileShaders(QOpenGLFunctions_3_3_Core* f, const char* vertexShaderSrc, GLint vertexShaderSize, const char* geometryShaderSrc, GLint geometryShaderSize, const char* fragmentShaderSrc, GLint fragmentShaderSize);
 GLuint readShaders(QOpenGLFunctions_3_3_Core* f, const QString& vertexShaderPath, const QString& fragmentShaderPath);
+GLuint readShaders(QOpenGLFunctions_3_3_Core* f, const QString& vertexShaderPath, const QString& geometryShaderPath, const QString& fragmentShaderPath);
 
 #endif  //UEBUNG_03_SHADER_H
@@ -0,0 +1,85 @@
+//
+// Temporal reprojection and accumulation of ray traced frames for the interactive mode.
+//
+
+#include <cmath>
+
+#include <QVector4D>
+
+#include "temporal.h"
+
+// radical inverse of index in the given base
+static float halton(unsigned int index, unsigned int base) {
+    float result = 0.f, fraction = 1.f / base;
+    while (index > 0) {
+        result += fraction * (index % base);
+        index /= base;
+        fraction /= base;
+    }
+    return result;
+}
+
+void TemporalAccumulator::nextJitter(float& x, float& y) const {
+    if (stillFrames == 0) {
+        x = y = 0.5f;
+        return;
+    }
+    x = halton(stillFrames, 2);
+    y = halton(stillFrames, 3);
+}
+
+void TemporalAccumulator::reset() {
+    history.clear();
+    historyPositions.clear();
+    historySamples.clear();
+    historyWidth = historyHeight = 0;
+    still = false;
+    stillFrames = 0;
+}
+
+const std::vector<Vec3f>& TemporalAccumulator::accumulate(const std::vector<Vec3f>& color, const std::vector<Vec3f>& positions,
+                                                          unsigned int w, unsigned int h, const QMatrix4x4& viewProjection) {
+    const bool hasHistory = historyWidth != 0;
+    // the history is reprojected, so a frame at another resolution still continues it
+    still = hasHistory && viewProjection == historyViewProjection;
+    stillFrames = still ? stillFrames + 1 : 0;
+    const unsigned int maxSamples = still ? maxSamplesStill : maxSamplesMoving;
+
+    blended.resize(w * h);
+    blendedSamples.resize(w * h);
+    #pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(h); y++) {
+        for (int x = 0; x < static_cast<int>(w); x++) {
+            size_t pixel = y * w + x;
+            blended[pixel] = color[pixel];
+            blendedSamples[pixel] = 1;
+            const Vec3f& p = positions[pixel];
+            if (!hasHistory || !std::isfinite(p.x())) continue;
+
+            // where the hit was seen in the last frame
+            QVector4D clip = historyViewProjection * QVector4D(p.x(), p.y(), p.z(), 1.f);
+            if (clip.w() <= 0.f) continue;
+            int hx = static_cast<int>(std::floor((clip.x() / clip.w() * 0.5f + 0.5f) * historyWidth));
+            int hy = static_cast<int>(std::floor((clip.y() / clip.w() * 0.5f + 0.5f) * historyHeight));
+            if (hx < 0 || hy < 0 || hx >= static_cast<int>(historyWidth) || hy >= static_cast<int>(historyHeight)) continue;
+            size_t historyPixel = hy * historyWidth + hx;
+
+            // reject the history if another surface was visible there (disocclusion), tolerance grows with distance
+            const Vec3f& q = historyPositions[historyPixel];
+            if (!std::isfinite(q.x()) || (q - p).length() > 0.01f * clip.w()) continue;
+
+            unsigned int samples = std::min(historySamples[historyPixel] + 1, maxSamples);
+            const Vec3f& old = history[historyPixel];
+            blended[pixel] = old + (color[pixel] - old) / static_cast<float>(samples);
+            blendedSamples[pixel] = samples;
+        }
+    }
+
+    history.swap(blended);
+    historySamples.swap(blendedSamples);
+    historyPositions = positions;
+    historyWidth = w;
+    historyHeight = h;
+    historyViewProjection = viewProjection;
+    return history;
+}
@@ -0,0 +1,47 @@
+//
+// Temporal reprojection and accumulation of ray traced frames for the interactive mode.
+//
+
+#ifndef UEBUNG_04_TEMPORAL_H
+#define UEBUNG_04_TEMPORAL_H
+
+#include <vector>
+
+#include <QMatrix4x4>
+
+#include "vec3.h"
+
+// Keeps the last blended frame with the world positions of its primary hits. A new frame looks up its history by
+// projecting each hit with the old camera, so the history stays valid while the camera moves and across resolution
+// changes. If the camera stands still, the jittered frames converge to an anti-aliased image.
+class TemporalAccumulator {
+public:
+    // blends a frame into the history and returns the result. positions are the primary hits of the frame
+    // (infinity for background), viewProjection is projection * modelView of the frame.
+    const std::vector<Vec3f>& accumulate(const std::vector<Vec3f>& color, const std::vector<Vec3f>& positions,
+                                         unsigned int width, unsigned int height, const QMatrix4x4& viewProjection);
+    void reset();
+
+    // true if the last accumulated frame was rendered with the same view projection as the one before, at any resolution
+    bool isStill() const { return still; }
+    // sample position inside the pixel for the next frame, a Halton sequence that restarts when the camera moves
+    void nextJitter(float& x, float& y) const;
+
+    // history length while the camera moves (few frames against ghosting) and while it stands still
+    unsigned int maxSamplesMoving = 4;
+    unsigned int maxSamplesStill = 64;
+
+private:
+    std::vector<Vec3f> history;
+    std::vector<Vec3f> historyPositions;
+    std::vector<unsigned int> historySamples;
+    unsigned int historyWidth{}, historyHeight{};
+    QMatrix4x4 historyViewProjection;
+    bool still = false;
+    unsigned int stillFrames = 0;
+
+    std::vector<Vec3f> blended;
+    std::vector<unsigned int> blendedSamples;
+};
+
+#endif //UEBUNG_04_TEMPORAL_H
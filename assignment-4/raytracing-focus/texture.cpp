@@ -0,0 +1,90 @@
+//
+// CPU-side textures for the ray tracer.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "stb_image.h"
+#include "texture.h"
+
+bool MipMappedTexture::load(const char* fileName) {
+    //flip like loadImageIntoTexture, so texture coordinates match the OpenGL textures
+    stbi_set_flip_vertically_on_load(true);
+
+    levels.clear();
+    this->fileName = fileName;
+    int width, height, temp;
+    unsigned char* pixelData = stbi_load(fileName, &width, &height, &temp, 4);
+    if (!pixelData) return false;
+
+    levels.push_back(Level{static_cast<unsigned int>(width), static_cast<unsigned int>(height),
+                           std::vector<unsigned char>(pixelData, pixelData + 4 * width * height)});
+    stbi_image_free(pixelData);
+
+    // build the pyramid with a 2x2 box filter
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level& src = levels.back();
+        Level dst{std::max(1u, src.width / 2), std::max(1u, src.height / 2), {}};
+        dst.texels.resize(4 * dst.width * dst.height);
+        for (unsigned int y = 0; y < dst.height; ++y) {
+            unsigned int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+            for (unsigned int x = 0; x < dst.width; ++x) {
+                unsigned int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                for (unsigned int c = 0; c < 4; ++c) {
+                    unsigned int sum = src.texels[4 * (y0 * src.width + x0) + c] + src.texels[4 * (y0 * src.width + x1) + c]
+                                     + src.texels[4 * (y1 * src.width + x0) + c] + src.texels[4 * (y1 * src.width + x1) + c];
+                    dst.texels[4 * (y * dst.width + x) + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        levels.push_back(std::move(dst));
+    }
+    return true;
+}
+
+float MipMappedTexture::computeLod(float dudx, float dvdx, float dudy, float dvdy) const {
+    if (levels.empty()) return 0.f;
+    // footprint of one pixel in level 0 texels, the larger axis decides (like OpenGL)
+    const float w = levels[0].width, h = levels[0].height;
+    float lengthX = std::sqrt(dudx * dudx * w * w + dvdx * dvdx * h * h);
+    float lengthY = std::sqrt(dudy * dudy * w * w + dvdy * dvdy * h * h);
+    float footprint = std::max(lengthX, lengthY);
+    return footprint > 1.f ? std::log2(footprint) : 0.f;
+}
+
+Vec3f MipMappedTexture::fetch(const Level& level, int x, int y) const {
+    // repeat
+    x %= static_cast<int>(level.width);
+    y %= static_cast<int>(level.height);
+    if (x < 0) x += level.width;
+    if (y < 0) y += level.height;
+    const unsigned char* texel = &level.texels[4 * (y * level.width + x)];
+    return Vec3f(texel[0], texel[1], texel[2]) / 255.f;
+}
+
+Vec3f MipMappedTexture::sampleBilinear(const Level& level, float u, float v) const {
+    // texel centers are at half-integer coordinates
+    float x = u * level.width - 0.5f, y = v * level.height - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float ax = x - fx, ay = y - fy;
+    int ix = static_cast<int>(fx), iy = static_cast<int>(fy);
+    Vec3f bottom = (1.f - ax) * fetch(level, ix, iy) + ax * fetch(level, ix + 1, iy);
+    Vec3f top = (1.f - ax) * fetch(level, ix, iy + 1) + ax * fetch(level, ix + 1, iy + 1);
+    return (1.f - ay) * bottom + ay * top;
+}
+
+Vec3f MipMappedTexture::sample(float u, float v, float lod) const {
+    if (levels.empty()) return Vec3f(1.f, 1.f, 1.f);
+    // keep the coordinates small, so float precision does not suffer for large repeat counts
+    u -= std::floor(u);
+    v -= std::floor(v);
+    lod = std::max(0.f, std::min(lod, static_cast<float>(levels.size() - 1)));
+    unsigned int lower = static_cast<unsigned int>(lod);
+    float blend = lod - lower;
+    Vec3f result = sampleBilinear(levels[lower], u, v);
+    if (blend > 0.f && lower + 1 < levels.size()) {
+        result = (1.f - blend) * result + blend * sampleBilinear(levels[lower + 1], u, v);
+    }
+    return result;
+}
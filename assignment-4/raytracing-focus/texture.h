@@ -0,0 +1,43 @@
+//
+// CPU-side textures for the ray tracer.
+//
+
+#ifndef UEBUNG_04_TEXTURE_H
+#define UEBUNG_04_TEXTURE_H
+
+#include <string>
+#include <vector>
+
+#include "vec3.h"
+
+// Mip pyramid kept in main memory so traceRay can do texture lookups without the GPU.
+// The level is chosen from the texture footprint of a ray (see RayDifferential in ray.h).
+class MipMappedTexture {
+    struct Level {
+        unsigned int width, height;
+        std::vector<unsigned char> texels; // RGBA, 4 bytes per texel, rows from bottom to top like OpenGL
+    };
+    std::vector<Level> levels;
+    std::string fileName;
+
+    Vec3f fetch(const Level& level, int x, int y) const;
+    Vec3f sampleBilinear(const Level& level, float u, float v) const;
+
+public:
+    // Loads an image file and builds all mip levels down to 1x1. Returns false on failure.
+    bool load(const char* fileName);
+
+    bool isValid() const { return !levels.empty(); }
+    unsigned int getNumLevels() const { return levels.size(); }
+    unsigned int getWidth() const { return levels.empty() ? 0 : levels[0].width; }
+    unsigned int getHeight() const { return levels.empty() ? 0 : levels[0].height; }
+    const std::string& getFileName() const { return fileName; }
+
+    // Level of detail for the given screen-space derivatives of the texture coordinates.
+    float computeLod(float dudx, float dvdx, float dudy, float dvdy) const;
+
+    // Trilinear lookup with repeating texture coordinates. lod 0 is the full resolution level.
+    Vec3f sample(float u, float v, float lod) const;
+};
+
+#endif //UEBUNG_04_TEXTURE_H
@@ -28,8 +28,9 @@
 
 #include "trianglemesh.h"
 #include "renderstate.h"
+#include "renderqueue.h"
 #include "utilities.h"
-#include "clipplane.h"
+#include "frustum.h"
 #include "shader.h"
 
 using glVertexAttrib3fvPtr = void (*)(GLuint index, const GLfloat* v);
@@ -51,6 +52,7 @@ void TriangleMesh::clear() {
     vertices.clear();
     triangles.clear();
     normals.clear();
+    texCoords.clear();
     // clear bounding box data
     boundingBoxMin = Vec3f(FLT_MAX, FLT_MAX, FLT_MAX);
     boundingBoxMax = Vec3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
@@ -68,10 +70,11 @@ void TriangleMesh::coutData() {
     std::cout << "nr. triangles: " << triangles.size() << std::endl;
     std::cout << "nr. vertices:  " << vertices.size() << std::endl;
     std::cout << "nr. normals:   " << normals.size() << std::endl;
+    std::cout << "nr. texCoords: " << texCoords.size() << std::endl;
     std::cout << "BB: (" << boundingBoxMin << ") - (" << boundingBoxMax << ")" << std::endl;
     std::cout << "  BBMid: (" << boundingBoxMid << ")" << std::endl;
     std::cout << "  BBSize: (" << boundingBoxSize << ")" << std::endl;
-    std::cout << "  VAO ID: " << VAO() << ", VBO IDs: f=" << VBOf() << ", v=" << VBOv() << ", n=" << VBOn() << std::endl;
+    std::cout << "  VAO ID: " << geometry.val.vertexArray << ", base vertex: " << geometry.val.baseVertex << ", first index: " << geometry.val.firstIndex << std::endl;
     std::cout << "coloring using: ";
 }
 
@@ -81,12 +84,10 @@ void TriangleMesh::coutData() {
 
 void TriangleMesh::flipNormals(bool createVBOs) {
     for (auto& n : normals) n *= -1.0f;
-    //correct VBO
-    if (createVBOs && VBOn() != 0) {
-        if (!f) return;
-        f->glBindBuffer(GL_ARRAY_BUFFER, VBOn());
-        f->glBufferSubData(GL_ARRAY_BUFFER, 0, normals.size() * sizeof(Normal), normals.data());
-        f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // the normals are interleaved with the other attributes => upload the mesh again
+    if (createVBOs && geometry.val.isValid()) {
+        cleanupVBO();
+        createAllVBOs();
     }
 }
 
@@ -181,6 +182,11 @@ void TriangleMesh::loadOFF(const char* filename, bool createVBOs) {
     in.close();
     // calculate normals if not given
     if (!noff) calculateNormalsByArea();
+    // calculate texture coordinates
+    calculateTexCoordsSphereMapping();
+    // triangles in file order are rarely good for the vertex cache
+    const VertexCacheStatistics cache = optimizeVertexOrder(false);
+    std::cout << "loadOFF: " << filename << " ACMR " << cache.acmrBefore << " -> " << cache.acmrAfter << std::endl;
     // createVBO
     if (createVBOs) {
         createAllVBOs();
@@ -193,6 +199,49 @@ void TriangleMesh::loadOFF(const char* filename, const Vec3f& BBmid, const float
     scaleToLength(BBlength, true);
 }
 
+bool TriangleMesh::saveOFF(const char* filename) const {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cout << "saveOFF: can not write " << filename << std::endl;
+        return false;
+    }
+    out << "OFF\n" << vertices.size() << " " << triangles.size() << " 0\n";
+    for (const auto& vertex : vertices) out << vertex[0] << " " << vertex[1] << " " << vertex[2] << "\n";
+    for (const auto& triangle : triangles) out << "3 " << triangle[0] << " " << triangle[1] << " " << triangle[2] << "\n";
+    return static_cast<bool>(out);
+}
+
+VertexCacheStatistics TriangleMesh::optimizeVertexOrder(bool createVBOs) {
+    VertexCacheStatistics statistics;
+    // the cache simulation indexes per vertex arrays, so the indices are checked first
+    for (const auto& triangle : triangles) {
+        if (triangle[0] >= vertices.size() || triangle[1] >= vertices.size() || triangle[2] >= vertices.size()) {
+            std::cout << "optimizeVertexOrder: vertex index out of range, keeping the order" << std::endl;
+            return statistics;
+        }
+    }
+    statistics.acmrBefore = statistics.acmrAfter = averageCacheMissRatio(triangles, vertices.size());
+    triangles = optimizeOverdraw(optimizeVertexCache(triangles, vertices.size()), vertices);
+    const std::vector<unsigned int> remap = optimizeVertexFetch(triangles, vertices.size());
+    // per vertex data moves to the new indices
+    auto reorder = [&remap](auto& values) {
+        if (values.size() != remap.size()) return;
+        auto reordered = values;
+        for (size_t i = 0; i < values.size(); ++i) reordered[remap[i]] = values[i];
+        values.swap(reordered);
+    };
+    reorder(vertices);
+    reorder(normals);
+    reorder(texCoords);
+    statistics.acmrAfter = averageCacheMissRatio(triangles, vertices.size());
+    // data changed => delete VBOs and create new ones
+    if (createVBOs) {
+        cleanupVBO();
+        createAllVBOs();
+    }
+    return statistics;
+}
+
 void TriangleMesh::calculateNormalsByArea() {
     // sum up triangle normals in each vertex
     normals.resize(vertices.size());
@@ -213,6 +262,17 @@ void TriangleMesh::calculateNormalsByArea() {
     for (auto& normal : normals) normal.normalize();
 }
 
+void TriangleMesh::calculateTexCoordsSphereMapping() {
+    texCoords.clear();
+    // texCoords by central projection on unit sphere
+    for (const auto& vertex : vertices) {
+        const auto dist = vertex - boundingBoxMid;
+        float u = (M_1_PI / 2) * std::atan2(dist.x(), dist.z()) + 0.5;
+        float v = M_1_PI * std::asin(dist.y() / std::sqrt(dist.x() * dist.x() + dist.y() * dist.y() + dist.z() * dist.z()));
+        texCoords.push_back(TexCoord{ u, v });
+    }
+}
+
 void TriangleMesh::calculateBB() {
     // clear bounding box data
     boundingBoxMin = Vec3f(FLT_MAX, FLT_MAX, FLT_MAX);
@@ -260,7 +320,10 @@ void TriangleMesh::createBBVAO(QOpenGLFunctions_3_3_Core* f) {
 
     // create VBOs of bounding box
     VBOvbb.val = createVBO(f, BoxVertices, BoxVerticesSize, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    VBOfbb.val = createVBO(f, BoxLineIndices, BoxLineIndicesSize, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+    // the lines for drawBB, then the triangles for drawSolidBB
+    std::vector<GLuint> boxIndices(BoxLineIndices, BoxLineIndices + BoxLineIndicesSize / sizeof(GLuint));
+    boxIndices.insert(boxIndices.end(), BoxTriangleIndices, BoxTriangleIndices + BoxTriangleIndicesSize / sizeof(GLuint));
+    VBOfbb.val = createVBO(f, boxIndices.data(), boxIndices.size() * sizeof(GLuint), GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
 
     // bind VAO of bounding box
     f->glBindVertexArray(VAObb.val);
@@ -293,27 +356,26 @@ void TriangleMesh::createNormalVAO(QOpenGLFunctions_3_3_Core* f) {
     f->glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+std::vector<MeshVertex> TriangleMesh::getMeshVertices() const {
+    std::vector<MeshVertex> data(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        MeshVertex& vertex = data[i];
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            vertex.position[axis] = vertices[i][axis];
+            vertex.normal[axis] = i < normals.size() ? normals[i][axis] : 0.f;
+        }
+        vertex.texCoord[0] = i < texCoords.size() ? texCoords[i].u : 0.f;
+        vertex.texCoord[1] = i < texCoords.size() ? texCoords[i].v : 0.f;
+        vertex.occlusion = 1.f;
+    }
+    return data;
+}
+
 void TriangleMesh::createAllVBOs() {
     if (!f) return;
-    // create VAOs
-    f->glGenVertexArrays(1, &VAO.val);
-
-    // create VBOs
-    VBOf.val = createVBO(f, triangles.data(), triangles.size() * sizeof(Triangle), GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
-    VBOv.val = createVBO(f, vertices.data(), vertices.size() * sizeof(Vertex), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    VBOn.val = createVBO(f, normals.data(), normals.size() * sizeof(Normal), GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-
-    // bind VBOs to VAO object
-    f->glBindVertexArray(VAO.val);
-    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBOf.val);
-    f->glBindBuffer(GL_ARRAY_BUFFER, VBOv.val);
-    f->glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-    f->glEnableVertexAttribArray(POSITION_LOCATION);
-    f->glBindBuffer(GL_ARRAY_BUFFER, VBOn.val);
-    f->glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-    f->glEnableVertexAttribArray(NORMAL_LOCATION);
-
-    f->glBindVertexArray(0);
+    // vertices and faces go into the buffers shared by all meshes, the VAO of those buffers draws the mesh
+    const std::vector<MeshVertex> data = getMeshVertices();
+    geometry.val = GeometryBuffer::meshes().allocate(f, data.data(), data.size(), reinterpret_cast<const GLuint*>(triangles.data()), 3 * triangles.size());
 
     createBBVAO(f);
 
@@ -326,21 +388,15 @@ void TriangleMesh::cleanupVBO() {
 }
 
 void TriangleMesh::cleanupVBO(QOpenGLFunctions_3_3_Core* f) {
-    // delete VAO
-    if (VAO.val != 0) f->glDeleteVertexArrays(1, &VAO.val);
-    // delete VBO
-    if (VBOv.val != 0) f->glDeleteBuffers(1, &VBOv.val);
-    if (VBOn.val != 0) f->glDeleteBuffers(1, &VBOn.val);
-    if (VBOf.val != 0) f->glDeleteBuffers(1, &VBOf.val);
+    // free the range of the mesh in the megabuffer
+    GeometryBuffer::meshes().free(geometry.val);
+    geometry.val = GeometryRange();
+    // delete VAOs and VBOs
     if (VAObb.val != 0) f->glDeleteVertexArrays(1, &VAObb.val);
     if (VBOvbb.val != 0) f->glDeleteBuffers(1, &VBOvbb.val);
     if (VBOfbb.val != 0) f->glDeleteBuffers(1, &VBOfbb.val);
     if (VAOn.val != 0) f->glDeleteVertexArrays(1, &VAOn.val);
     if (VBOvn.val != 0) f->glDeleteBuffers(1, &VBOvn.val);
-    VBOv.val = 0;
-    VBOn.val = 0;
-    VBOf.val = 0;
-    VAO.val = 0;
     VAObb.val = 0;
     VBOfbb.val = 0;
     VBOvbb.val = 0;
@@ -350,27 +406,42 @@ void TriangleMesh::cleanupVBO(QOpenGLFunctions_3_3_Core* f) {
 
 unsigned int TriangleMesh::draw(RenderState& state) {
     if (!boundingBoxIsVisible(state)) return 0;
-    if (VAO.val == 0) return 0;
+    return drawUnculled(state);
+}
+
+void TriangleMesh::submit(RenderQueue& queue, RenderState& state, GLuint program) {
+    if (!geometry.val.isValid() || !boundingBoxIsVisible(state)) return;
+    const QMatrix4x4& modelView = state.getCurrentModelViewMatrix();
+    const float depth = -modelView.map(QVector3D(boundingBoxMid.x(), boundingBoxMid.y(), boundingBoxMid.z())).z();
+    queue.submit(DrawPacket{RenderQueue::makeKey(RenderPass::Opaque, program, 0, geometry.val.vertexArray, depth), program, modelView, this, nullptr});
+}
+
+unsigned int TriangleMesh::drawUnculled(RenderState& state) {
+    if (!geometry.val.isValid()) return 0;
     state.setMatrices();
-    if (withBB || withNormals) {
-        GLuint formerProgram = state.getCurrentProgram();
-        state.switchToStandardProgram();
-        if (withBB) drawBB(state);
-        if (withNormals) drawNormals(state);
-        state.setCurrentProgram(formerProgram);
-    }
+    drawOverlays(state);
     drawVBO(state);
 
     return triangles.size();
 }
 
+void TriangleMesh::drawOverlays(RenderState& state) {
+    if (!withBB && !withNormals) return;
+    GLuint formerProgram = state.getCurrentProgram();
+    state.switchToStandardProgram();
+    if (withBB) drawBB(state);
+    if (withNormals) drawNormals(state);
+    state.setCurrentProgram(formerProgram);
+}
+
 void TriangleMesh::drawVBO(RenderState& state) {
     auto* f = state.getOpenGLFunctions();
 
-    // The VAO keeps track of all the buffers and the element buffer, so we do not need to bind else except for the VAO
-    f->glBindVertexArray(VAO.val);
+    // The VAO keeps track of all the buffers and the element buffer, so we do not need to bind else except for the VAO.
+    // It is shared by all meshes, the range of this one starts at its first index and base vertex.
+    state.bindVertexArray(geometry.val.vertexArray);
 
-    f->glDrawElements(GL_TRIANGLES, 3*triangles.size(), GL_UNSIGNED_INT, nullptr);
+    f->glDrawElementsBaseVertex(GL_TRIANGLES, geometry.val.indexCount, GL_UNSIGNED_INT, geometry.val.indexOffset(), geometry.val.baseVertex);
 }
 
 // ===========
@@ -378,89 +449,19 @@ void TriangleMesh::drawVBO(RenderState& state) {
 // ===========
 
 bool TriangleMesh::boundingBoxIsVisible(const RenderState& state) {
-    // openGL stores matrices in column major order:
-    // float pm = _11, _21, _31, _41, _12, _22, _32, _42, _13, _23, _33, _43, _14, _24, _34, _44
-    //     index:  0    1    2    3    4    5    6    7    8    9    10   11   12   13   14   15
-    // TODO ...
-
-    //Calculate ModelViewProjection Matrix
-    const QMatrix4x4 mvp = state.getCurrentProjectionMatrix() * state.getCurrentModelViewMatrix();
-    const float* combinedMatrix = mvp.constData();
-
-    std::array<ClipPlane, 6> planes{
-            // Left
-            ClipPlane{combinedMatrix[3] + combinedMatrix[0],
-                      combinedMatrix[7] + combinedMatrix[4],
-                      combinedMatrix[11] + combinedMatrix[8],
-                      combinedMatrix[15] + combinedMatrix[12]},
-
-            // Right
-            ClipPlane{combinedMatrix[3] - combinedMatrix[0],
-                      combinedMatrix[7] - combinedMatrix[4],
-                      combinedMatrix[11] - combinedMatrix[8],
-                      combinedMatrix[15] - combinedMatrix[12]},
-
-            // Top
-            ClipPlane{combinedMatrix[3] - combinedMatrix[1],
-                      combinedMatrix[7] - combinedMatrix[5],
-                      combinedMatrix[11] - combinedMatrix[9],
-                      combinedMatrix[15] - combinedMatrix[13]},
-
-            // Bottom
-            ClipPlane{combinedMatrix[3] + combinedMatrix[1],
-                      combinedMatrix[7] + combinedMatrix[5],
-                      combinedMatrix[11] + combinedMatrix[9],
-                      combinedMatrix[15] + combinedMatrix[13]},
-
-            // Near
-            ClipPlane{combinedMatrix[3] + combinedMatrix[2],
-                      combinedMatrix[7] + combinedMatrix[6],
-                      combinedMatrix[11] + combinedMatrix[10],
-                      combinedMatrix[15] + combinedMatrix[14]},
-
-            // Far
-            ClipPlane{combinedMatrix[3] - combinedMatrix[2],
-                      combinedMatrix[7] - combinedMatrix[6],
-                      combinedMatrix[11] - combinedMatrix[10],
-                      combinedMatrix[15] - combinedMatrix[14]}
-    };
-
-    std::array<Vec3f, 8> boundBoxEdges {
-            boundingBoxMin,                                                                               // back left bottom
-            boundingBoxMin + Vec3f(0, boundingBoxSize.y(), 0),                                  // back left top
-            boundingBoxMin + Vec3f(boundingBoxSize.x(), 0, 0),                                  // back right bottom
-            boundingBoxMin + Vec3f(boundingBoxSize.x(), boundingBoxSize.y(), 0),                  // back right top
-            boundingBoxMin + Vec3f(0, 0, boundingBoxSize.z()),                                  // front left bottom
-            boundingBoxMin + Vec3f(0, boundingBoxSize.y(), boundingBoxSize.z()),                  // front left top
-            boundingBoxMin + Vec3f(boundingBoxSize.x(), 0, boundingBoxSize.z()),                  // front right bottom
-            boundingBoxMin + Vec3f(boundingBoxSize.x(), boundingBoxSize.y(), boundingBoxSize.z())   // front right top
-    };
-
-    for (auto& plane : planes) {
-        bool allOutside = true;
-        for (auto& edge : boundBoxEdges) {
-            const float distance = plane.evaluatePoint(edge);
-            if (distance > 0) {
-                allOutside = false;
-                break;
-            }
-        }
-        if (allOutside) {
-            return false;
-        }
-    }
-    return true;
+    // the planes of the model view projection matrix are in model space, where the bounding box is axis aligned
+    const Frustum frustum(state.getCurrentProjectionMatrix() * state.getCurrentModelViewMatrix());
+    return frustum.isBoxVisible(boundingBoxMid, 0.5f * boundingBoxSize);
 }
 
 void TriangleMesh::drawBB(RenderState &state) {
     auto* f = state.getOpenGLFunctions();
-    f->glBindVertexArray(VAObb.val);
+    state.bindVertexArray(VAObb.val);
     //Transform BB to correct position.
     state.pushModelViewMatrix();
     state.getCurrentModelViewMatrix().translate(boundingBoxMid.x(), boundingBoxMid.y(), boundingBoxMid.z());
     state.getCurrentModelViewMatrix().scale(boundingBoxSize.x(), boundingBoxSize.y(), boundingBoxSize.z());
     state.setMatrices();
-    f->glUniformMatrix4fv(state.getModelViewUniform(), 1, GL_FALSE, state.getCurrentModelViewMatrix().data());
     //Set color to constant white.
     //Bug in Qt: They flagged glVertexAttrib3f as deprecated in modern OpenGL, which is not true.
     //We have to load it manually. Make it static so we do it only once.
@@ -469,13 +470,25 @@ void TriangleMesh::drawBB(RenderState &state) {
 
     f->glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, nullptr);
     state.popModelViewMatrix();
+}
+
+void TriangleMesh::drawSolidBB(RenderState& state, float margin) {
+    auto* f = state.getOpenGLFunctions();
+    state.bindVertexArray(VAObb.val);
+    state.pushModelViewMatrix();
+    state.getCurrentModelViewMatrix().translate(boundingBoxMid.x(), boundingBoxMid.y(), boundingBoxMid.z());
+    const Vec3f size = (1.f + margin) * boundingBoxSize;
+    state.getCurrentModelViewMatrix().scale(size.x(), size.y(), size.z());
     state.setMatrices();
+    f->glDrawElements(GL_TRIANGLES, BoxTriangleIndicesSize / sizeof(GLuint), GL_UNSIGNED_INT,
+                      reinterpret_cast<const void*>(BoxLineIndicesSize));
+    state.popModelViewMatrix();
 }
 
 void TriangleMesh::drawNormals(RenderState &state) {
     auto* f = state.getOpenGLFunctions();
-    f->glBindVertexArray(VAOn.val);
-    f->glUniformMatrix4fv(state.getModelViewUniform(), 1, GL_FALSE, state.getCurrentModelViewMatrix().data());
+    state.bindVertexArray(VAOn.val);
+    state.setMatrices();
 
     //Set color to constant white.
     //Bug in Qt: They flagged glVertexAttrib3f as deprecated in modern OpenGL, which is not true.
@@ -11,10 +11,13 @@
 
 #include "vec3.h"
 #include "utilities.h"
+#include "geometrybuffer.h"
+#include "vertexcache.h"
 
 //Forward declaration, avoids being forced to include header
 class QOpenGLFunctions_3_3_Core;
 class RenderState;
+class RenderQueue;
 
 class TriangleMesh {
 public:
@@ -29,19 +32,24 @@ private:
     typedef Vec3ui Triangle;
     typedef Vec3f Vertex;
     typedef Vec3f Normal;
+public:
+    struct TexCoord { float u, v; };
+private:
 
     typedef std::vector<Triangle> Triangles;
     typedef std::vector<Vertex> Vertices;
     typedef std::vector<Normal> Normals;
+    typedef std::vector<TexCoord> TexCoords;
 
 
     // data of TriangleMesh
     Vertices vertices;    // vertex positions
     Normals normals;      // normals per vertex
     Triangles triangles;  // indices of vertices that form a triangle
+    TexCoords texCoords;  // u,v per vertex
 
-    // VAO and VBO ids for vertices, normals, faces, colors, texCoords, tangents
-    autoMoved<GLuint> VAO{}, VBOv{}, VBOn{}, VBOf{};
+    // vertices and faces in the megabuffer of all meshes
+    autoMoved<GeometryRange> geometry{};
     // VBO for bounding box
     autoMoved<GLuint> VAObb{}, VBOvbb{}, VBOfbb{};
     //VBO for normal lines
@@ -80,11 +88,19 @@ public:
     std::vector<Vec3f>& getVertices() { return vertices; }
     std::vector<Vec3ui>& getTriangles() { return triangles; }
     std::vector<Vec3f>& getNormals() { return normals; }
+    std::vector<TexCoord>& getTexCoords() { return texCoords; }
+    // vertex array shared by all meshes, 0 before createAllVBOs
+    GLuint getVAO() const { return geometry.val.vertexArray; }
+    // range of the mesh in GeometryBuffer::meshes()
+    const GeometryRange& getGeometry() const { return geometry.val; }
+    // interleaved vertex data as it is uploaded, with occlusion 1
+    std::vector<MeshVertex> getMeshVertices() const;
 
     // get size of all elements
     unsigned int getNumVertices() { return vertices.size(); }
     unsigned int getNumNormals() { return normals.size(); }
     unsigned int getNumTriangles() { return triangles.size(); }
+    unsigned int getNumTexCoords() { return texCoords.size(); }
 
     // get boundingBox data
     Vec3f getBoundingBoxMin() { return boundingBoxMin; }
@@ -104,17 +120,24 @@ public:
     // scales vertices so that the largest bounding box size has length newLength
     void scaleToLength(float newLength, bool createVBOs = true);
 
+    // Reorders the triangles for the post-transform vertex cache, then against overdraw, and the vertices in the
+    // order they are fetched (see vertexcache.h). Returns the average cache miss ratio before and after.
+    VertexCacheStatistics optimizeVertexOrder(bool createVBOs = true);
+
     // =================
     // === LOAD MESH ===
     // =================
 
-    // read from an OFF file. also calculates normals if not given in the file.
+    // read from an OFF file. also calculates normals if not given in the file and optimizes the vertex order.
     void loadOFF(const char* filename, bool createVBOs = true);
 
     // read from an OFF file. also calculates normals if not given in the file.
     // translates and scales vertices with bounding box center at BBmid and largest side BBlength
     void loadOFF(const char* filename, const Vec3f& BBmid, float BBlength);
 
+    // write vertices and triangles to an OFF file, returns false if it could not be written
+    bool saveOFF(const char* filename) const;
+
 private:
     // calculate normals, weighted by area
     void calculateNormalsByArea();
@@ -125,7 +148,7 @@ private:
     // calculates axis aligned bounding box data
     void calculateBB();
 
-    // create VBOs for vertices, faces, normals, colors, textureCoords
+    // upload vertices and faces into the megabuffer, create VBOs for bounding box and normals
     void createAllVBOs();
     // create VBOs for normals
     void createNormalVAO(QOpenGLFunctions_3_3_Core* f);
@@ -146,6 +169,14 @@ public:
 
     // draw mesh with current drawing mode settings. returns the number of triangles drawn.
     unsigned int draw(RenderState& state);
+    // same without the frustum test, for meshes that were tested when they were submitted
+    unsigned int drawUnculled(RenderState& state);
+    // queues the mesh with the current model view matrix if it is in the view frustum
+    void submit(RenderQueue& queue, RenderState& state, GLuint program);
+    // bounding box and normals if they are switched on, for draws of the mesh data that bypass drawUnculled
+    void drawOverlays(RenderState& state);
+    // the faces of the bounding box, grown by margin times its size, for occlusion queries
+    void drawSolidBB(RenderState& state, float margin);
 
 private:
 
@@ -162,6 +193,7 @@ private:
     // === VFC ===
     // ===========
 
+public:
     // check if bounding box is visible in view frustum
     bool boundingBoxIsVisible(const RenderState& state);
 };
@@ -0,0 +1,196 @@
+//
+// Triangle and vertex order for the GPU: Tipsify for the post-transform vertex cache, clusters sorted against overdraw,
+// vertices renumbered in the order they are fetched.
+//
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include "vertexcache.h"
+
+namespace {
+    // FIFO cache by time stamps: a vertex is cached while fewer than cacheSize others were inserted after it
+    class FifoCache {
+    public:
+        FifoCache(unsigned int vertexCount, unsigned int cacheSize) : stamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+        // returns whether the vertex had to be transformed
+        bool access(unsigned int vertex) {
+            if (time - stamps[vertex] <= size) return false;
+            stamps[vertex] = time++;
+            return true;
+        }
+        // the next accesses miss as if the cache was empty
+        void flush() { time += size + 1; }
+
+    private:
+        std::vector<unsigned int> stamps;
+        unsigned int time;
+        unsigned int size;
+    };
+
+    unsigned int misses(FifoCache& cache, const Vec3ui& triangle) {
+        return cache.access(triangle[0]) + cache.access(triangle[1]) + cache.access(triangle[2]);
+    }
+}
+
+float averageCacheMissRatio(const std::vector<Vec3ui>& triangles, unsigned int vertexCount, unsigned int cacheSize) {
+    if (triangles.empty()) return 0.f;
+    FifoCache cache(vertexCount, cacheSize);
+    size_t total = 0;
+    for (const Vec3ui& triangle : triangles) total += misses(cache, triangle);
+    return static_cast<float>(total) / triangles.size();
+}
+
+std::vector<Vec3ui> optimizeVertexCache(const std::vector<Vec3ui>& triangles, unsigned int vertexCount, unsigned int cacheSize) {
+    // triangles around every vertex, as ranges of one list
+    std::vector<unsigned int> offsets(vertexCount + 1, 0), adjacency(3 * triangles.size());
+    for (const Vec3ui& triangle : triangles) {
+        for (unsigned int k = 0; k < 3; ++k) offsets[triangle[k] + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned int t = 0; t < triangles.size(); ++t) {
+        for (unsigned int k = 0; k < 3; ++k) adjacency[fill[triangles[t][k]]++] = t;
+    }
+    // triangles not emitted yet per vertex
+    std::vector<unsigned int> live(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v) live[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<unsigned int> stamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    std::vector<bool> emitted(triangles.size(), false);
+    std::vector<unsigned int> deadEnds, candidates;
+    std::vector<Vec3ui> result;
+    result.reserve(triangles.size());
+    unsigned int cursor = 0;
+
+    int fan = vertexCount > 0 ? 0 : -1;
+    while (fan >= 0) {
+        candidates.clear();
+        for (unsigned int a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            const unsigned int t = adjacency[a];
+            if (emitted[t]) continue;
+            for (unsigned int k = 0; k < 3; ++k) {
+                const unsigned int v = triangles[t][k];
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamps[v] > cacheSize) stamps[v] = time++;
+            }
+            emitted[t] = true;
+            result.push_back(triangles[t]);
+        }
+
+        // The next fan is the candidate that stays cached while its remaining triangles are emitted and of those
+        // the oldest, whose vertices would be lost first. Candidates that do not fit anymore have priority 0.
+        fan = -1;
+        long best = -1;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0) continue;
+            long priority = 0;
+            if (time - stamps[v] + 2 * live[v] <= cacheSize) priority = time - stamps[v];
+            if (priority > best) {
+                best = priority;
+                fan = static_cast<int>(v);
+            }
+        }
+        // dead end: the most recently used vertex with triangles left, else the next one in index order
+        while (fan < 0 && !deadEnds.empty()) {
+            const unsigned int v = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[v] > 0) fan = static_cast<int>(v);
+        }
+        for (; fan < 0 && cursor < vertexCount; ++cursor) {
+            if (live[cursor] > 0) fan = static_cast<int>(cursor);
+        }
+    }
+    return result;
+}
+
+std::vector<Vec3ui> optimizeOverdraw(const std::vector<Vec3ui>& triangles, const std::vector<Vec3f>& positions, unsigned int cacheSize, float threshold) {
+    if (triangles.size() < 2) return triangles;
+
+    // Hard boundaries where the cache starts over. Inside a hard cluster a soft one ends as soon as it is about as
+    // efficient as the whole hard cluster, each simulated with an empty cache since it may be drawn after any other.
+    std::vector<size_t> starts;
+    FifoCache continuous(positions.size(), cacheSize), fresh(positions.size(), cacheSize);
+    std::vector<unsigned int> triangleMisses(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i) triangleMisses[i] = misses(continuous, triangles[i]);
+    for (size_t begin = 0; begin < triangles.size();) {
+        size_t end = begin + 1;
+        while (end < triangles.size() && triangleMisses[end] < 3) end++;
+        size_t total = 0;
+        for (size_t i = begin; i < end; ++i) total += triangleMisses[i];
+        const float clusterACMR = static_cast<float>(total) / (end - begin);
+
+        fresh.flush();
+        starts.push_back(begin);
+        size_t segmentStart = begin, segmentMisses = 0;
+        for (size_t i = begin; i < end; ++i) {
+            segmentMisses += misses(fresh, triangles[i]);
+            if (i + 1 < end && segmentMisses <= threshold * clusterACMR * (i + 1 - segmentStart)) {
+                fresh.flush();
+                starts.push_back(i + 1);
+                segmentStart = i + 1;
+                segmentMisses = 0;
+            }
+        }
+        begin = end;
+    }
+    starts.push_back(triangles.size());
+
+    // area weighted centroid and normal of every cluster and of the mesh
+    const size_t clusterCount = starts.size() - 1;
+    std::vector<Vec3f> centroids(clusterCount, Vec3f(0.f)), normals(clusterCount, Vec3f(0.f));
+    Vec3f meshCentroid(0.f);
+    float meshArea = 0.f;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float area = 0.f;
+        for (size_t i = starts[c]; i < starts[c + 1]; ++i) {
+            const Vec3f& a = positions[triangles[i][0]];
+            const Vec3f& b = positions[triangles[i][1]];
+            const Vec3f& d = positions[triangles[i][2]];
+            const Vec3f normal = cross(b - a, d - a);
+            const float triangleArea = normal.length();
+            normals[c] += normal;
+            centroids[c] += (triangleArea / 3.f) * (a + b + d);
+            area += triangleArea;
+        }
+        meshCentroid += centroids[c];
+        meshArea += area;
+        if (area > 0.f) centroids[c] /= area;
+        normals[c].normalize();
+    }
+    if (meshArea > 0.f) meshCentroid /= meshArea;
+
+    // clusters facing away from the center are in front of the rest from most directions
+    std::vector<float> outwardness(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) outwardness[c] = (centroids[c] - meshCentroid) * normals[c];
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return outwardness[a] > outwardness[b]; });
+
+    std::vector<Vec3ui> result;
+    result.reserve(triangles.size());
+    for (size_t c : order) result.insert(result.end(), triangles.begin() + starts[c], triangles.begin() + starts[c + 1]);
+    return result;
+}
+
+std::vector<unsigned int> optimizeVertexFetch(std::vector<Vec3ui>& triangles, unsigned int vertexCount) {
+    const unsigned int unused = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> remap(vertexCount, unused);
+    unsigned int next = 0;
+    for (Vec3ui& triangle : triangles) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            unsigned int& index = remap[triangle[k]];
+            if (index == unused) index = next++;
+            triangle[k] = index;
+        }
+    }
+    for (unsigned int& index : remap) {
+        if (index == unused) index = next++;
+    }
+    return remap;
+}
@@ -0,0 +1,38 @@
+//
+// Triangle and vertex order for the GPU: Tipsify for the post-transform vertex cache, clusters sorted against overdraw,
+// vertices renumbered in the order they are fetched.
+//
+
+#ifndef UEBUNG_04_VERTEXCACHE_H
+#define UEBUNG_04_VERTEXCACHE_H
+
+#include <vector>
+
+#include "vec3.h"
+
+// entries of the simulated post-transform cache, a conservative size for current GPUs
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// average cache miss ratio of a mesh before and after optimizeVertexOrder
+struct VertexCacheStatistics {
+    float acmrBefore{0.f};
+    float acmrAfter{0.f};
+};
+
+// vertex shader invocations per triangle with a FIFO cache of cacheSize vertices, between 0.5 and 3
+float averageCacheMissRatio(const std::vector<Vec3ui>& triangles, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander et al. 2007): fans around one vertex at a time, the next one is picked among the vertices of the
+// last fans that will still be in the cache. Runs in linear time.
+std::vector<Vec3ui> optimizeVertexCache(const std::vector<Vec3ui>& triangles, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Splits a cache optimized order into clusters and sorts them so that those facing away from the center come first,
+// they tend to hide the others. A cluster ends where the cache starts over or where it is as efficient as the whole
+// run up to threshold, so the ACMR grows by little.
+std::vector<Vec3ui> optimizeOverdraw(const std::vector<Vec3ui>& triangles, const std::vector<Vec3f>& positions, unsigned int cacheSize = VERTEX_CACHE_SIZE, float threshold = 1.05f);
+
+// Renumbers the vertices in the order the triangles use them first, unused ones at the end. Returns the new index of
+// every vertex, the per vertex data has to be moved accordingly.
+std::vector<unsigned int> optimizeVertexFetch(std::vector<Vec3ui>& triangles, unsigned int vertexCount);
+
+#endif //UEBUNG_04_VERTEXCACHE_H